@@ -27,7 +27,10 @@ struct sysfs_cxt {
 			scsi_target,
 			scsi_lun;
 
-	unsigned int	has_hctl : 1;
+	unsigned int	has_hctl : 1,
+			use_cache : 1;	/* see sysfs_enable_cache() */
+
+	struct sysfs_attr *attrs;	/* cached attributes */
 };
 
 #define UL_SYSFSCXT_EMPTY { 0, -1, NULL, NULL, 0, 0, 0, 0, 0 }
@@ -42,6 +45,7 @@ extern dev_t sysfs_devname_to_devno(const char *name, const char *parent);
 extern int sysfs_init(struct sysfs_cxt *cxt, dev_t devno, struct sysfs_cxt *parent)
 					__attribute__ ((warn_unused_result));
 extern void sysfs_deinit(struct sysfs_cxt *cxt);
+extern void sysfs_enable_cache(struct sysfs_cxt *cxt);
 
 extern DIR *sysfs_opendir(struct sysfs_cxt *cxt, const char *attr);
 
@@ -11,9 +11,13 @@
 #include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <sys/time.h>
 
 #include <sys/syscall.h>
+#ifdef HAVE_SYS_RANDOM_H
+# include <sys/random.h>
+#endif
 
 #include "c.h"
 #include "randutils.h"
@@ -30,6 +34,23 @@
 THREAD_LOCAL unsigned short ul_jrand_seed[3];
 #endif
 
+#if !defined(HAVE_GETRANDOM) && defined(SYS_getrandom)
+/* libc without the function, but we have the syscall */
+# ifndef GRND_NONBLOCK
+#  define GRND_NONBLOCK	0x01
+# endif
+static int getrandom(void *buf, size_t buflen, unsigned int flags)
+{
+	return syscall(SYS_getrandom, buf, buflen, flags);
+}
+# define HAVE_GETRANDOM
+#endif
+
+#ifdef HAVE_GETRANDOM
+/* the last random_get_bytes() call got all bytes from getrandom() */
+THREAD_LOCAL int ul_getrandom_used;
+#endif
+
 int random_get_fd(void)
 {
 	int i, fd;
@@ -61,16 +82,36 @@ int random_get_fd(void)
 
 /*
  * Generate a stream of random nbytes into buf.
- * Use /dev/urandom if possible, and if not,
+ * Use getrandom() or /dev/urandom if possible, and if not,
  * use glibc pseudo-random functions.
  */
 void random_get_bytes(void *buf, size_t nbytes)
 {
 	size_t i, n = nbytes;
-	int fd = random_get_fd();
+	int fd;
 	int lose_counter = 0;
 	unsigned char *cp = (unsigned char *) buf;
 
+#ifdef HAVE_GETRANDOM
+	while (n > 0) {
+		int x = getrandom(cp, n, GRND_NONBLOCK);
+		if (x <= 0) {
+			if (x < 0 && errno == EINTR)
+				continue;
+			break;	/* old kernel, or the pool is not ready yet */
+		}
+		n -= x;
+		cp += x;
+	}
+	/*
+	 * The kernel does not need any help, don't mix its output
+	 * with the pseudo-random functions below.
+	 */
+	ul_getrandom_used = (n == 0);
+	if (n == 0)
+		return;
+#endif
+	fd = random_get_fd();
 	if (fd >= 0) {
 		while (n > 0) {
 			ssize_t x = read(fd, cp, n);
@@ -112,7 +153,7 @@ void random_get_bytes(void *buf, size_t nbytes)
 
 
 /*
- * Tell source of randomness.
+ * Tell source of randomness used by the last random_get_bytes() call.
  */
 const char *random_tell_source(void)
 {
@@ -122,6 +163,10 @@ const char *random_tell_source(void)
 		"/dev/random"
 	};
 
+#ifdef HAVE_GETRANDOM
+	if (ul_getrandom_used)
+		return _("getrandom() function");
+#endif
 	for (i = 0; i < ARRAY_SIZE(random_sources); i++) {
 		if (!access(random_sources[i], R_OK))
 			return random_sources[i];
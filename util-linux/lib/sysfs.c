@@ -186,6 +186,55 @@ err:
 	return rc;
 }
 
+/*
+ * Cached attribute, @len is -1 if the attribute cannot be read.
+ */
+struct sysfs_attr {
+	struct sysfs_attr *next;
+	ssize_t	len;
+	char	*name;
+	char	data[];
+};
+
+static void sysfs_free_cache(struct sysfs_cxt *cxt)
+{
+	while (cxt->attrs) {
+		struct sysfs_attr *a = cxt->attrs;
+
+		cxt->attrs = a->next;
+		free(a->name);
+		free(a);
+	}
+}
+
+/* forget the attribute, called when the attribute is modified */
+static void sysfs_drop_cached(struct sysfs_cxt *cxt, const char *attr)
+{
+	struct sysfs_attr **pa, *a;
+
+	for (pa = &cxt->attrs; (a = *pa); pa = &a->next) {
+		if (strcmp(a->name, attr) == 0) {
+			*pa = a->next;
+			free(a->name);
+			free(a);
+			return;
+		}
+	}
+}
+
+/*
+ * Enables the attributes cache. Every attribute is read from sysfs only
+ * once, the next sysfs_scanf(), sysfs_strdup() and sysfs_read_*() calls
+ * use the cached content until sysfs_deinit().
+ *
+ * This is useful for tools like lsblk(8) where many columns are generated
+ * from the same attributes of many devices.
+ */
+void sysfs_enable_cache(struct sysfs_cxt *cxt)
+{
+	cxt->use_cache = 1;
+}
+
 void sysfs_deinit(struct sysfs_cxt *cxt)
 {
 	if (!cxt)
@@ -194,6 +243,7 @@ void sysfs_deinit(struct sysfs_cxt *cxt)
 	if (cxt->dir_fd >= 0)
 	       close(cxt->dir_fd);
 	free(cxt->dir_path);
+	sysfs_free_cache(cxt);
 
 	memset(cxt, 0, sizeof(*cxt));
 
@@ -280,11 +330,60 @@ DIR *sysfs_opendir(struct sysfs_cxt *cxt, const char *attr)
 }
 
 
-static FILE *sysfs_fopen(struct sysfs_cxt *cxt, const char *attr)
+/*
+ * Reads the attribute to @buf and terminates it by zero. Returns the size of
+ * the content or -1 on error.
+ *
+ * The sysfs attributes are smaller than a page and the kernel returns the
+ * whole content by the first read(), so there is no reason for stdio.
+ */
+static ssize_t sysfs_read_attr(struct sysfs_cxt *cxt, const char *attr,
+			       char *buf, size_t bufsz)
 {
-	int fd = sysfs_open(cxt, attr, O_RDONLY|O_CLOEXEC);
+	struct sysfs_attr *a;
+	ssize_t len;
+	int fd;
+
+	if (cxt->use_cache) {
+		for (a = cxt->attrs; a; a = a->next) {
+			if (strcmp(a->name, attr) != 0)
+				continue;
+			if (a->len < 0)
+				return -1;
+			len = min((size_t) a->len, bufsz - 1);
+			memcpy(buf, a->data, len);
+			buf[len] = '\0';
+			return len;
+		}
+	}
 
-	return fd < 0 ? NULL : fdopen(fd, "r" UL_CLOEXECSTR);
+	fd = sysfs_open(cxt, attr, O_RDONLY|O_CLOEXEC);
+	if (fd < 0)
+		len = -1;
+	else {
+		do {
+			len = read(fd, buf, bufsz - 1);
+		} while (len < 0 && errno == EINTR);
+		close(fd);
+	}
+	if (len >= 0)
+		buf[len] = '\0';
+
+	if (cxt->use_cache) {
+		a = malloc(sizeof(*a) + (len > 0 ? len : 0));
+		if (a && !(a->name = strdup(attr))) {
+			free(a);
+			a = NULL;
+		}
+		if (a) {
+			a->len = len;
+			if (len > 0)
+				memcpy(a->data, buf, len);
+			a->next = cxt->attrs;
+			cxt->attrs = a;
+		}
+	}
+	return len;
 }
 
 
@@ -386,26 +485,44 @@ dev_t sysfs_partno_to_devno(struct sysfs_cxt *cxt, int partno)
 
 int sysfs_scanf(struct sysfs_cxt *cxt,  const char *attr, const char *fmt, ...)
 {
-	FILE *f = sysfs_fopen(cxt, attr);
+	char buf[BUFSIZ];
 	va_list ap;
 	int rc;
 
-	if (!f)
+	if (sysfs_read_attr(cxt, attr, buf, sizeof(buf)) < 0)
 		return -EINVAL;
+
 	va_start(ap, fmt);
-	rc = vfscanf(f, fmt, ap);
+	rc = vsscanf(buf, fmt, ap);
 	va_end(ap);
 
-	fclose(f);
 	return rc;
 }
 
+/*
+ * The same as sscanf("%"SCNd64) or "%"SCNu64, but without scanf() overhead.
+ */
+static int sysfs_read_number(struct sysfs_cxt *cxt, const char *attr,
+			     int is_signed, void *res)
+{
+	char buf[BUFSIZ], *end = NULL;
+
+	if (sysfs_read_attr(cxt, attr, buf, sizeof(buf)) < 0)
+		return -1;
+
+	if (is_signed)
+		*((int64_t *) res) = strtoll(buf, &end, 10);
+	else
+		*((uint64_t *) res) = strtoull(buf, &end, 10);
+
+	return end == buf ? -1 : 0;
+}
 
 int sysfs_read_s64(struct sysfs_cxt *cxt, const char *attr, int64_t *res)
 {
 	int64_t x = 0;
 
-	if (sysfs_scanf(cxt, attr, "%"SCNd64, &x) == 1) {
+	if (sysfs_read_number(cxt, attr, 1, &x) == 0) {
 		if (res)
 			*res = x;
 		return 0;
@@ -417,7 +534,7 @@ int sysfs_read_u64(struct sysfs_cxt *cxt, const char *attr, uint64_t *res)
 {
 	uint64_t x = 0;
 
-	if (sysfs_scanf(cxt, attr, "%"SCNu64, &x) == 1) {
+	if (sysfs_read_number(cxt, attr, 0, &x) == 0) {
 		if (res)
 			*res = x;
 		return 0;
@@ -427,11 +544,11 @@ int sysfs_read_u64(struct sysfs_cxt *cxt, const char *attr, uint64_t *res)
 
 int sysfs_read_int(struct sysfs_cxt *cxt, const char *attr, int *res)
 {
-	int x = 0;
+	int64_t x = 0;
 
-	if (sysfs_scanf(cxt, attr, "%d", &x) == 1) {
+	if (sysfs_read_number(cxt, attr, 1, &x) == 0) {
 		if (res)
-			*res = x;
+			*res = (int) x;
 		return 0;
 	}
 	return -1;
@@ -442,6 +559,7 @@ int sysfs_write_string(struct sysfs_cxt *cxt, const char *attr, const char *str)
 	int fd = sysfs_open(cxt, attr, O_WRONLY|O_CLOEXEC);
 	int rc, errsv;
 
+	sysfs_drop_cached(cxt, attr);
 	if (fd < 0)
 		return -errno;
 	rc = write_all(fd, str, strlen(str));
@@ -457,6 +575,7 @@ int sysfs_write_u64(struct sysfs_cxt *cxt, const char *attr, uint64_t num)
 	char buf[sizeof(stringify_value(ULLONG_MAX))];
 	int fd, rc = 0, len, errsv;
 
+	sysfs_drop_cached(cxt, attr);
 	fd = sysfs_open(cxt, attr, O_WRONLY|O_CLOEXEC);
 	if (fd < 0)
 		return -errno;
@@ -473,11 +592,17 @@ int sysfs_write_u64(struct sysfs_cxt *cxt, const char *attr, uint64_t num)
 	return rc;
 }
 
+/* returns the first line of the attribute (max 1023 bytes) */
 char *sysfs_strdup(struct sysfs_cxt *cxt, const char *attr)
 {
 	char buf[BUFSIZ];
-	return sysfs_scanf(cxt, attr, "%1023[^\n]", buf) == 1 ?
-						strdup(buf) : NULL;
+	size_t len;
+
+	if (sysfs_read_attr(cxt, attr, buf, sizeof(buf)) <= 0)
+		return NULL;
+
+	len = strcspn(buf, "\n");
+	return len ? strndup(buf, min(len, (size_t) 1023)) : NULL;
 }
 
 
@@ -0,0 +1,323 @@
+/*
+ * batch.c - prefetch probing data for more devices in parallel
+ *
+ * This file may be redistributed under the terms of the
+ * GNU Lesser General Public License.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
+
+#include "blkidP.h"
+
+/*
+ * The number of threads used by default, the prefetching is I/O bound.
+ */
+#define BLKID_BATCH_NTHREADS	8
+
+struct blkid_struct_probe_batch {
+	blkid_probe	*probes;	/* added probes */
+	size_t		nprobes;	/* number of probes */
+	size_t		next;		/* next probe to prefetch (see batch_worker()) */
+	unsigned int	nthreads;	/* max number of threads */
+};
+
+/**
+ * blkid_new_probe_batch:
+ *
+ * The batch allows to read the areas where the most of the superblocks and
+ * partition tables are stored (begin and end of the device) for more devices
+ * at once. The usual blkid_do_probe(), blkid_do_safeprobe() or
+ * blkid_do_fullprobe() then reuse the prefetched data. It's useful when
+ * probing many devices (e.g. many disks attached to the system) where the
+ * per-device I/O latency is more important than throughput.
+ *
+ * <informalexample>
+ *   <programlisting>
+ *     batch = blkid_new_probe_batch();
+ *
+ *     for (i = 0; i < ndevs; i++) {
+ *         prs[i] = blkid_new_probe_from_filename(devs[i]);
+ *         blkid_probe_batch_add(batch, prs[i]);
+ *     }
+ *     blkid_probe_batch_prefetch(batch);
+ *
+ *     for (i = 0; i < ndevs; i++)
+ *         blkid_do_safeprobe(prs[i]);
+ *   </programlisting>
+ * </informalexample>
+ *
+ * The batch does not own the probes, the probes have to be deallocated by
+ * blkid_free_probe() and they must not be used by another thread during
+ * blkid_probe_batch_prefetch().
+ *
+ * Returns: a pointer to the newly allocated batch or NULL in case of error.
+ */
+blkid_probe_batch blkid_new_probe_batch(void)
+{
+	blkid_probe_batch batch;
+
+	batch = calloc(1, sizeof(*batch));
+	if (!batch)
+		return NULL;
+
+	batch->nthreads = BLKID_BATCH_NTHREADS;
+	DBG(LOWPROBE, ul_debug("allocate a new probe batch %p", batch));
+	return batch;
+}
+
+/**
+ * blkid_free_probe_batch:
+ * @batch: batch
+ *
+ * Deallocates the batch. The probes added to the batch are not deallocated.
+ */
+void blkid_free_probe_batch(blkid_probe_batch batch)
+{
+	if (!batch)
+		return;
+
+	DBG(LOWPROBE, ul_debug("free probe batch %p", batch));
+	free(batch->probes);
+	free(batch);
+}
+
+/**
+ * blkid_probe_batch_add:
+ * @batch: batch
+ * @pr: probe with assigned device
+ *
+ * Adds the probe to the batch. The cloned probes (e.g. partitions probing
+ * on the whole-disk) share buffers with the parent and cannot be added.
+ *
+ * Returns: 0 on success, or -1 in case of error.
+ */
+int blkid_probe_batch_add(blkid_probe_batch batch, blkid_probe pr)
+{
+	blkid_probe *tmp;
+
+	if (!batch || !pr || pr->parent)
+		return -1;
+
+	tmp = realloc(batch->probes, (batch->nprobes + 1) * sizeof(blkid_probe));
+	if (!tmp)
+		return -1;
+
+	batch->probes = tmp;
+	batch->probes[batch->nprobes++] = pr;
+	return 0;
+}
+
+/**
+ * blkid_probe_batch_set_nthreads:
+ * @batch: batch
+ * @nthreads: max number of threads
+ *
+ * Sets the max number of threads used by blkid_probe_batch_prefetch(). The
+ * default is 8, 0 or 1 means that data are read by the current thread only.
+ *
+ * Returns: 0 on success, or -1 in case of error.
+ */
+int blkid_probe_batch_set_nthreads(blkid_probe_batch batch, unsigned int nthreads)
+{
+	if (!batch)
+		return -1;
+
+	batch->nthreads = nthreads;
+	return 0;
+}
+
+static void *batch_worker(void *data)
+{
+	blkid_probe_batch batch = (blkid_probe_batch) data;
+
+	for (;;) {
+		size_t i = __sync_fetch_and_add(&batch->next, 1);
+		int rc;
+
+		if (i >= batch->nprobes)
+			break;
+		rc = blkid_probe_read_hot(batch->probes[i]);
+		if (rc)
+			DBG(LOWPROBE, ul_debug("batch: prefetch failed for probe %p [rc=%d]",
+						batch->probes[i], rc));
+	}
+	return NULL;
+}
+
+/**
+ * blkid_probe_batch_prefetch:
+ * @batch: batch
+ *
+ * Reads the begin and end of all devices from the batch. The read-ahead is
+ * requested for all devices first and then the data are read to the probing
+ * buffers by more threads.
+ *
+ * The I/O errors are ignored here, they are reported by the probing
+ * functions later.
+ *
+ * Returns: 0 on success, or -1 in case of error.
+ */
+int blkid_probe_batch_prefetch(blkid_probe_batch batch)
+{
+	size_t i;
+#ifdef HAVE_LIBPTHREAD
+	pthread_t *threads = NULL;
+	unsigned int nthreads, n = 0;
+#endif
+	if (!batch)
+		return -1;
+
+	/* submit I/O for all devices */
+	for (i = 0; i < batch->nprobes; i++)
+		blkid_probe_advise_hot(batch->probes[i]);
+
+	batch->next = 0;
+
+#ifdef HAVE_LIBPTHREAD
+	nthreads = batch->nthreads;
+	if (nthreads > batch->nprobes)
+		nthreads = batch->nprobes;
+
+	DBG(LOWPROBE, ul_debug("batch: prefetching %zu devices by %u threads",
+				batch->nprobes, nthreads));
+
+	/* the current thread is the first worker */
+	if (nthreads > 1)
+		threads = calloc(nthreads - 1, sizeof(pthread_t));
+	if (threads) {
+		for (n = 0; n < nthreads - 1; n++) {
+			if (pthread_create(&threads[n], NULL, batch_worker, batch))
+				break;
+		}
+	}
+#endif
+	batch_worker(batch);
+
+#ifdef HAVE_LIBPTHREAD
+	for (i = 0; i < n; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+#endif
+	return 0;
+}
+
+#ifdef TEST_PROGRAM
+#include <fcntl.h>
+#include <sys/time.h>
+
+static double time_diff(struct timeval *a, struct timeval *b)
+{
+	return (b->tv_sec - a->tv_sec) + (b->tv_usec - a->tv_usec) / 1000000.0;
+}
+
+/* drop the devices from page cache to emulate cold boot */
+static void drop_caches(char **devs, int ndevs)
+{
+	int i;
+
+	sync();
+	for (i = 0; i < ndevs; i++) {
+		int fd = open(devs[i], O_RDONLY|O_CLOEXEC);
+
+		if (fd < 0)
+			continue;
+		posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+		close(fd);
+	}
+}
+
+static blkid_probe new_probe(const char *devname)
+{
+	blkid_probe pr = blkid_new_probe_from_filename(devname);
+
+	if (!pr)
+		err(EXIT_FAILURE, "%s: failed to create prober", devname);
+
+	blkid_probe_enable_superblocks(pr, 1);
+	blkid_probe_enable_partitions(pr, 1);
+	blkid_probe_set_partitions_flags(pr, BLKID_PARTS_MAGIC);
+	return pr;
+}
+
+static int count_results(blkid_probe pr)
+{
+	return blkid_do_safeprobe(pr) == 0 ? 1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct timeval start, end;
+	blkid_probe_batch batch;
+	blkid_probe *prs;
+	unsigned int nthreads;
+	char **devs;
+	int ndevs, i, found = 0, bfound = 0;
+	double serial, batched;
+
+	if (argc < 3) {
+		fprintf(stderr, "usage: %s <nthreads> <device|file> [...]\n"
+				"Compare serial and batch probing (run as root "
+				"to drop page cache)\n", program_invocation_short_name);
+		return EXIT_FAILURE;
+	}
+
+	nthreads = atoi(argv[1]);
+	devs = &argv[2];
+	ndevs = argc - 2;
+
+	prs = calloc(ndevs, sizeof(blkid_probe));
+	if (!prs)
+		err(EXIT_FAILURE, "cannot allocate probes");
+
+	/* serial */
+	drop_caches(devs, ndevs);
+	gettimeofday(&start, NULL);
+	for (i = 0; i < ndevs; i++) {
+		blkid_probe pr = new_probe(devs[i]);
+
+		found += count_results(pr);
+		blkid_free_probe(pr);
+	}
+	gettimeofday(&end, NULL);
+	serial = time_diff(&start, &end);
+
+	/* batch */
+	drop_caches(devs, ndevs);
+	gettimeofday(&start, NULL);
+
+	batch = blkid_new_probe_batch();
+	if (!batch)
+		err(EXIT_FAILURE, "cannot allocate batch");
+	blkid_probe_batch_set_nthreads(batch, nthreads);
+
+	for (i = 0; i < ndevs; i++) {
+		prs[i] = new_probe(devs[i]);
+		if (blkid_probe_batch_add(batch, prs[i]))
+			err(EXIT_FAILURE, "cannot add probe to batch");
+	}
+	blkid_probe_batch_prefetch(batch);
+
+	for (i = 0; i < ndevs; i++) {
+		bfound += count_results(prs[i]);
+		blkid_free_probe(prs[i]);
+	}
+	blkid_free_probe_batch(batch);
+
+	gettimeofday(&end, NULL);
+	batched = time_diff(&start, &end);
+
+	printf("devices:  %d (detected %d, batch %d)\n", ndevs, found, bfound);
+	printf("serial:   %.3f ms\n", serial * 1000.0);
+	printf("batch:    %.3f ms (%u threads)\n", batched * 1000.0, nthreads);
+
+	free(prs);
+	return found == bfound ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+#endif
@@ -0,0 +1,676 @@
+/*
+ * bincache.c - binary (mmap-able) cache file
+ *
+ * This file may be redistributed under the terms of the
+ * GNU Lesser General Public License.
+ *
+ * The text blkid.tab has to be parsed completely before the first lookup.
+ * The binary format is mapped to memory and the devices are added to the
+ * cache on demand (by name, by NAME=value or all devices if the caller needs
+ * to iterate over the cache).
+ *
+ * File format (native byte order, all offsets are from the begin of the file):
+ *
+ *	struct bincache_hdr
+ *	struct bincache_dev	devs[ndevs]
+ *	struct bincache_tag	tags[ntags]	(ordered by device)
+ *	uint32_t		names[ndevs]	(devs indexes sorted by name)
+ *	uint32_t		vals[ntags]	(tags indexes sorted by NAME, value)
+ *	char			strs[]		(zero terminated strings)
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+
+#include "blkidP.h"
+
+#define BINCACHE_MAGIC		"BLKIDBIN"
+#define BINCACHE_MAGIC_LEN	(sizeof(BINCACHE_MAGIC) - 1)
+#define BINCACHE_VERSION	1
+
+struct bincache_hdr {
+	char		magic[BINCACHE_MAGIC_LEN];
+	uint32_t	version;	/* BINCACHE_VERSION */
+	uint32_t	size;		/* size of the file */
+	uint32_t	ndevs;		/* number of devices */
+	uint32_t	ntags;		/* number of tags */
+	uint32_t	devs_off;	/* offset of devices array */
+	uint32_t	tags_off;	/* offset of tags array */
+	uint32_t	names_off;	/* offset of name index */
+	uint32_t	vals_off;	/* offset of NAME=value index */
+	uint32_t	strs_off;	/* offset of string table */
+	uint32_t	strs_size;	/* size of string table */
+};
+
+struct bincache_dev {
+	uint64_t	devno;		/* bid_devno */
+	int64_t		time;		/* bid_time */
+	int64_t		utime;		/* bid_utime */
+	int32_t		pri;		/* bid_pri */
+	uint32_t	name;		/* bid_name string offset */
+	uint32_t	tags;		/* index of the first tag */
+	uint32_t	ntags;		/* number of tags */
+};
+
+struct bincache_tag {
+	uint32_t	name;		/* NAME string offset */
+	uint32_t	val;		/* value string offset */
+	uint32_t	dev;		/* device index */
+};
+
+/* mapped cache file */
+struct blkid_bincache {
+	void				*map;
+	size_t				mapsz;
+
+	const struct bincache_hdr	*hdr;
+	const struct bincache_dev	*devs;
+	const struct bincache_tag	*tags;
+	const uint32_t			*names;
+	const uint32_t			*vals;
+	const char			*strs;
+
+	unsigned char			*loaded;	/* devices already in cache */
+	size_t				nloaded;
+};
+
+static const char *bin_str(struct blkid_bincache *bc, uint32_t off)
+{
+	/* the string table is terminated by zero (see bincache_open()) */
+	return off < bc->hdr->strs_size ? bc->strs + off : NULL;
+}
+
+static int section_ok(const struct bincache_hdr *hdr, uint32_t off,
+		      uint32_t nmemb, size_t sz)
+{
+	return off <= hdr->size && nmemb <= (hdr->size - off) / sz;
+}
+
+/* all the indexes have to point to the arrays, checked on open */
+static int indexes_ok(const struct bincache_hdr *hdr, const char *map)
+{
+	const struct bincache_tag *tags;
+	const uint32_t *names, *vals;
+	uint32_t i;
+
+	tags = (const struct bincache_tag *) (map + hdr->tags_off);
+	names = (const uint32_t *) (map + hdr->names_off);
+	vals = (const uint32_t *) (map + hdr->vals_off);
+
+	for (i = 0; i < hdr->ndevs; i++) {
+		if (names[i] >= hdr->ndevs)
+			return 0;
+	}
+	for (i = 0; i < hdr->ntags; i++) {
+		if (vals[i] >= hdr->ntags || tags[i].dev >= hdr->ndevs)
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ * Maps the cache file @fd if it's in the binary format.
+ *
+ * Returns: 0 on success, 1 if it's not binary cache, <0 on error.
+ */
+int blkid_bincache_open(blkid_cache cache, int fd, struct stat *st)
+{
+	struct blkid_bincache *bc;
+	const struct bincache_hdr *hdr;
+	char magic[BINCACHE_MAGIC_LEN];
+	void *map;
+
+	if (pread(fd, magic, sizeof(magic), 0) != (ssize_t) sizeof(magic) ||
+	    memcmp(magic, BINCACHE_MAGIC, BINCACHE_MAGIC_LEN) != 0)
+		return 1;
+
+	blkid_bincache_close(cache);
+
+	if (!S_ISREG(st->st_mode) || (size_t) st->st_size < sizeof(*hdr) ||
+	    st->st_size > UINT32_MAX)
+		return -BLKID_ERR_CACHE;
+
+	map = mmap(NULL, st->st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED)
+		return -BLKID_ERR_CACHE;
+
+	hdr = (const struct bincache_hdr *) map;
+	if (hdr->version != BINCACHE_VERSION
+	    || hdr->size != (uint32_t) st->st_size
+	    || hdr->devs_off % sizeof(uint64_t)
+	    || hdr->tags_off % sizeof(uint32_t)
+	    || hdr->names_off % sizeof(uint32_t)
+	    || hdr->vals_off % sizeof(uint32_t)
+	    || !section_ok(hdr, hdr->devs_off, hdr->ndevs, sizeof(struct bincache_dev))
+	    || !section_ok(hdr, hdr->tags_off, hdr->ntags, sizeof(struct bincache_tag))
+	    || !section_ok(hdr, hdr->names_off, hdr->ndevs, sizeof(uint32_t))
+	    || !section_ok(hdr, hdr->vals_off, hdr->ntags, sizeof(uint32_t))
+	    || !section_ok(hdr, hdr->strs_off, hdr->strs_size, 1)
+	    || hdr->strs_size == 0
+	    || ((const char *) map)[hdr->strs_off + hdr->strs_size - 1] != '\0'
+	    || !indexes_ok(hdr, map)) {
+		DBG(READ, ul_debug("binary cache: unsupported or corrupted file"));
+		munmap(map, st->st_size);
+		return -BLKID_ERR_CACHE;
+	}
+
+	bc = calloc(1, sizeof(*bc));
+	if (bc)
+		bc->loaded = calloc((hdr->ndevs / CHAR_BIT) + 1, 1);
+	if (!bc || !bc->loaded) {
+		free(bc);
+		munmap(map, st->st_size);
+		return -BLKID_ERR_MEM;
+	}
+
+	bc->map = map;
+	bc->mapsz = st->st_size;
+	bc->hdr = hdr;
+	bc->devs = (const struct bincache_dev *) ((char *) map + hdr->devs_off);
+	bc->tags = (const struct bincache_tag *) ((char *) map + hdr->tags_off);
+	bc->names = (const uint32_t *) ((char *) map + hdr->names_off);
+	bc->vals = (const uint32_t *) ((char *) map + hdr->vals_off);
+	bc->strs = (const char *) map + hdr->strs_off;
+
+	DBG(READ, ul_debug("binary cache: mapped %u devices, %u tags",
+				hdr->ndevs, hdr->ntags));
+	cache->bic_bin = bc;
+	cache->bic_flags |= BLKID_BIC_FL_BINARY;
+	return 0;
+}
+
+void blkid_bincache_close(blkid_cache cache)
+{
+	struct blkid_bincache *bc = cache->bic_bin;
+
+	if (!bc)
+		return;
+
+	DBG(READ, ul_debug("binary cache: unmap (%zu devices loaded)", bc->nloaded));
+	munmap(bc->map, bc->mapsz);
+	free(bc->loaded);
+	free(bc);
+	cache->bic_bin = NULL;
+}
+
+/*
+ * Adds device @idx from the file to the cache. It's the same as
+ * blkid_parse_line() for the text cache.
+ */
+static void load_dev(blkid_cache cache, uint32_t idx)
+{
+	struct blkid_bincache *bc = cache->bic_bin;
+	const struct bincache_dev *bd;
+	unsigned int changed = cache->bic_flags & BLKID_BIC_FL_CHANGED;
+	const char *name;
+	blkid_dev dev;
+	uint32_t i;
+
+	if (idx >= bc->hdr->ndevs || isset(bc->loaded, idx))
+		return;
+	setbit(bc->loaded, idx);	/* before blkid_get_dev() */
+	bc->nloaded++;
+
+	bd = &bc->devs[idx];
+	name = bin_str(bc, bd->name);
+	if (!name || bd->tags > bc->hdr->ntags ||
+	    bd->ntags > bc->hdr->ntags - bd->tags)
+		return;
+
+	DBG(READ, ul_debug("binary cache: loading %s", name));
+
+	dev = blkid_get_dev(cache, name, BLKID_DEV_CREATE);
+	if (!dev)
+		return;
+
+	blkid_dev_set_devno(dev, (dev_t) bd->devno);
+	dev->bid_pri = bd->pri;
+	dev->bid_time = (time_t) bd->time;
+	dev->bid_utime = (suseconds_t) bd->utime;
+
+	for (i = bd->tags; i < bd->tags + bd->ntags; i++) {
+		const char *tn = bin_str(bc, bc->tags[i].name);
+		const char *tv = bin_str(bc, bc->tags[i].val);
+
+		if (tn && tv)
+			blkid_set_tag(dev, tn, tv, strlen(tv));
+	}
+
+	if (dev->bid_type == NULL) {
+		DBG(READ, ul_debug("blkid: device %s has no TYPE", dev->bid_name));
+		blkid_free_dev(dev);
+	}
+
+	/* the cache is the same as the file */
+	if (!changed)
+		cache->bic_flags &= ~BLKID_BIC_FL_CHANGED;
+}
+
+void blkid_bincache_load_all(blkid_cache cache)
+{
+	struct blkid_bincache *bc = cache->bic_bin;
+	uint32_t i;
+
+	if (!bc || bc->nloaded == bc->hdr->ndevs)
+		return;
+
+	DBG(READ, ul_debug("binary cache: loading all devices"));
+	for (i = 0; i < bc->hdr->ndevs; i++)
+		load_dev(cache, i);
+}
+
+void blkid_bincache_load_name(blkid_cache cache, const char *devname)
+{
+	struct blkid_bincache *bc = cache->bic_bin;
+	uint32_t lo = 0, hi;
+
+	if (!bc || !devname)
+		return;
+
+	hi = bc->hdr->ndevs;
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2, idx = bc->names[mid];
+		const char *name;
+		int rc;
+
+		if (idx >= bc->hdr->ndevs || !(name = bin_str(bc, bc->devs[idx].name)))
+			return;
+		rc = strcmp(devname, name);
+		if (rc == 0) {
+			load_dev(cache, idx);
+			return;
+		}
+		if (rc < 0)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+}
+
+static int cmp_tag(struct blkid_bincache *bc, uint32_t idx,
+		   const char *type, const char *value)
+{
+	const char *tn, *tv;
+	int rc;
+
+	if (idx >= bc->hdr->ntags ||
+	    !(tn = bin_str(bc, bc->tags[idx].name)) ||
+	    !(tv = bin_str(bc, bc->tags[idx].val)))
+		return 1;	/* corrupted, never equal */
+
+	rc = strcmp(type, tn);
+	return rc ? rc : strcmp(value, tv);
+}
+
+/*
+ * Adds all devices with the tag @type=@value to the cache.
+ */
+void blkid_bincache_load_tag(blkid_cache cache, const char *type,
+			     const char *value)
+{
+	struct blkid_bincache *bc = cache->bic_bin;
+	uint32_t lo = 0, hi, i;
+
+	if (!bc || !type || !value)
+		return;
+
+	/* lower bound */
+	hi = bc->hdr->ntags;
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+
+		if (cmp_tag(bc, bc->vals[mid], type, value) > 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (i = lo; i < bc->hdr->ntags; i++) {
+		uint32_t idx = bc->vals[i];
+
+		if (idx >= bc->hdr->ntags || cmp_tag(bc, idx, type, value) != 0)
+			break;
+		load_dev(cache, bc->tags[idx].dev);
+	}
+}
+
+/*
+ * Writer
+ */
+struct strtab {
+	char		*data;
+	size_t		size;
+	size_t		alloc;
+};
+
+static int strtab_add(struct strtab *st, const char *str, uint32_t *off)
+{
+	size_t len = strlen(str) + 1;
+
+	if (st->size + len > st->alloc) {
+		size_t sz = st->alloc ? st->alloc * 2 : 4096;
+		char *tmp;
+
+		while (sz < st->size + len)
+			sz *= 2;
+		tmp = realloc(st->data, sz);
+		if (!tmp)
+			return -BLKID_ERR_MEM;
+		st->data = tmp;
+		st->alloc = sz;
+	}
+	memcpy(st->data + st->size, str, len);
+	*off = st->size;
+	st->size += len;
+	return 0;
+}
+
+struct sortent {
+	const char	*name;
+	const char	*val;
+	uint32_t	idx;
+};
+
+static int cmp_sortent(const void *a, const void *b)
+{
+	const struct sortent *x = (const struct sortent *) a,
+			     *y = (const struct sortent *) b;
+	int rc = strcmp(x->name, y->name);
+
+	if (rc == 0 && x->val)
+		rc = strcmp(x->val, y->val);
+	if (rc == 0)
+		rc = x->idx < y->idx ? -1 : x->idx > y->idx;	/* stable */
+	return rc;
+}
+
+/* the same devices as saved to the text cache */
+static int is_saved_dev(blkid_dev dev)
+{
+	return dev->bid_type && !(dev->bid_flags & BLKID_BID_FL_REMOVABLE) &&
+	       dev->bid_name[0] == '/';
+}
+
+static int write_section(FILE *f, const void *data, size_t sz, uint32_t *off)
+{
+	long pos = ftell(f);
+
+	if (pos < 0)
+		return -BLKID_ERR_IO;
+	if (off)
+		*off = (uint32_t) pos;
+	if (sz && fwrite(data, 1, sz, f) != sz)
+		return -BLKID_ERR_IO;
+	return 0;
+}
+
+/*
+ * Writes all cached devices to @f in the binary format.
+ */
+int blkid_bincache_write(blkid_cache cache, FILE *f)
+{
+	struct bincache_hdr hdr;
+	struct bincache_dev *devs = NULL;
+	struct bincache_tag *tags = NULL;
+	struct sortent *names = NULL, *vals = NULL;
+	uint32_t *idxs = NULL;
+	struct strtab strs = { .data = NULL };
+	struct list_head *p, *t;
+	size_t ndevs = 0, ntags = 0, i;
+	int rc = -BLKID_ERR_MEM;
+
+	list_for_each(p, &cache->bic_devs) {
+		blkid_dev dev = list_entry(p, struct blkid_struct_dev, bid_devs);
+
+		if (!is_saved_dev(dev))
+			continue;
+		ndevs++;
+		list_for_each(t, &dev->bid_tags)
+			ntags++;
+	}
+
+	devs = calloc(ndevs + 1, sizeof(*devs));
+	tags = calloc(ntags + 1, sizeof(*tags));
+	names = calloc(ndevs + 1, sizeof(*names));
+	vals = calloc(ntags + 1, sizeof(*vals));
+	idxs = calloc((ndevs > ntags ? ndevs : ntags) + 1, sizeof(uint32_t));
+	if (!devs || !tags || !names || !vals || !idxs)
+		goto done;
+
+	ndevs = ntags = 0;
+	list_for_each(p, &cache->bic_devs) {
+		blkid_dev dev = list_entry(p, struct blkid_struct_dev, bid_devs);
+		struct bincache_dev *bd;
+
+		if (!is_saved_dev(dev))
+			continue;
+
+		DBG(SAVE, ul_debug("device %s, type %s", dev->bid_name,
+					dev->bid_type));
+		bd = &devs[ndevs];
+		bd->devno = dev->bid_devno;
+		bd->time = dev->bid_time;
+		bd->utime = dev->bid_utime;
+		bd->pri = dev->bid_pri;
+		bd->tags = ntags;
+		if (strtab_add(&strs, dev->bid_name, &bd->name))
+			goto done;
+		names[ndevs].name = dev->bid_name;
+		names[ndevs].idx = ndevs;
+
+		list_for_each(t, &dev->bid_tags) {
+			blkid_tag tag = list_entry(t, struct blkid_struct_tag, bit_tags);
+			struct bincache_tag *bt = &tags[ntags];
+
+			if (strtab_add(&strs, tag->bit_name, &bt->name) ||
+			    strtab_add(&strs, tag->bit_val, &bt->val))
+				goto done;
+			bt->dev = ndevs;
+			vals[ntags].name = tag->bit_name;
+			vals[ntags].val = tag->bit_val;
+			vals[ntags].idx = ntags;
+			ntags++;
+		}
+		bd->ntags = ntags - bd->tags;
+		ndevs++;
+	}
+	if (!strs.size && strtab_add(&strs, "", &hdr.strs_off))
+		goto done;	/* empty cache, the table must not be empty */
+
+	qsort(names, ndevs, sizeof(*names), cmp_sortent);
+	qsort(vals, ntags, sizeof(*vals), cmp_sortent);
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, BINCACHE_MAGIC, BINCACHE_MAGIC_LEN);
+	hdr.version = BINCACHE_VERSION;
+	hdr.ndevs = ndevs;
+	hdr.ntags = ntags;
+	hdr.strs_size = strs.size;
+
+	/* header is written twice, the final version with offsets at the end */
+	rc = write_section(f, &hdr, sizeof(hdr), NULL);
+	if (!rc)
+		rc = write_section(f, devs, ndevs * sizeof(*devs), &hdr.devs_off);
+	if (!rc)
+		rc = write_section(f, tags, ntags * sizeof(*tags), &hdr.tags_off);
+	if (!rc) {
+		for (i = 0; i < ndevs; i++)
+			idxs[i] = names[i].idx;
+		rc = write_section(f, idxs, ndevs * sizeof(uint32_t), &hdr.names_off);
+	}
+	if (!rc) {
+		for (i = 0; i < ntags; i++)
+			idxs[i] = vals[i].idx;
+		rc = write_section(f, idxs, ntags * sizeof(uint32_t), &hdr.vals_off);
+	}
+	if (!rc)
+		rc = write_section(f, strs.data, strs.size, &hdr.strs_off);
+	if (!rc) {
+		long sz = ftell(f);
+
+		if (sz < 0 || sz > UINT32_MAX)
+			rc = -BLKID_ERR_BIG;
+		else {
+			hdr.size = (uint32_t) sz;
+			if (fseek(f, 0, SEEK_SET) != 0 ||
+			    fwrite(&hdr, 1, sizeof(hdr), f) != sizeof(hdr))
+				rc = -BLKID_ERR_IO;
+		}
+	}
+
+	DBG(SAVE, ul_debug("binary cache: %zu devices, %zu tags written [rc=%d]",
+				ndevs, ntags, rc));
+done:
+	free(devs);
+	free(tags);
+	free(names);
+	free(vals);
+	free(idxs);
+	free(strs.data);
+	return rc;
+}
+
+#ifdef TEST_PROGRAM
+#include <sys/time.h>
+#include <fcntl.h>
+
+static double time_diff(struct timeval *a, struct timeval *b)
+{
+	return (b->tv_sec - a->tv_sec) + (b->tv_usec - a->tv_usec) / 1000000.0;
+}
+
+/*
+ * Creates cache with @ndevs fake devices (empty files in @dir) and saves it
+ * in the text and in the binary format.
+ */
+static int create_caches(const char *dir, int ndevs,
+			 const char *txtfile, const char *binfile)
+{
+	blkid_cache cache;
+	char path[PATH_MAX], val[64];
+	int i;
+
+	if (blkid_get_cache(&cache, "/dev/null") != 0)
+		return -1;
+
+	for (i = 0; i < ndevs; i++) {
+		blkid_dev dev;
+		int fd;
+
+		snprintf(path, sizeof(path), "%s/dev%d", dir, i);
+		fd = open(path, O_CREAT|O_WRONLY|O_CLOEXEC, 0644);
+		if (fd < 0)
+			goto err;
+		close(fd);
+
+		dev = blkid_get_dev(cache, path, BLKID_DEV_CREATE);
+		if (!dev)
+			goto err;
+		blkid_dev_set_devno(dev, makedev(8, i));
+		dev->bid_time = time(0);
+
+		blkid_set_tag(dev, "TYPE", "ext4", 4);
+		snprintf(val, sizeof(val), "label%d", i);
+		blkid_set_tag(dev, "LABEL", val, strlen(val));
+		snprintf(val, sizeof(val), "%08x-1111-2222-3333-%012x", i, i);
+		blkid_set_tag(dev, "UUID", val, strlen(val));
+	}
+
+	free(cache->bic_filename);
+	cache->bic_filename = strdup(txtfile);
+	cache->bic_flags |= BLKID_BIC_FL_CHANGED;
+	if (blkid_flush_cache(cache) < 0)
+		goto err;
+
+	free(cache->bic_filename);
+	cache->bic_filename = strdup(binfile);
+	cache->bic_flags |= BLKID_BIC_FL_CHANGED | BLKID_BIC_FL_BINARY;
+	if (blkid_flush_cache(cache) < 0)
+		goto err;
+
+	blkid_put_cache(cache);
+	return 0;
+err:
+	blkid_put_cache(cache);
+	return -1;
+}
+
+/* open cache and lookup one device by name and one device by tag */
+static double bench(const char *filename, const char *dir, int ndevs, int loops)
+{
+	struct timeval start, end;
+	char path[PATH_MAX], label[64];
+	int i, found = 0;
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < loops; i++) {
+		blkid_cache cache;
+		int n = (i * 7919) % ndevs;
+
+		if (blkid_get_cache(&cache, filename) != 0)
+			return -1;
+
+		snprintf(path, sizeof(path), "%s/dev%d", dir, n);
+		snprintf(label, sizeof(label), "label%d", n);
+
+		if (blkid_get_dev(cache, path, BLKID_DEV_FIND))
+			found++;
+		blkid_bincache_load_tag(cache, "LABEL", label);
+		if (blkid_get_dev(cache, path, BLKID_DEV_FIND))
+			found++;
+
+		blkid_put_cache(cache);
+	}
+	gettimeofday(&end, NULL);
+
+	if (found != 2 * loops)
+		fprintf(stderr, "%s: found %d devices, expected %d\n",
+				filename, found, 2 * loops);
+	return time_diff(&start, &end) / loops;
+}
+
+int main(int argc, char **argv)
+{
+	char txtfile[PATH_MAX], binfile[PATH_MAX];
+	int ndevs = 10000, loops = 20;
+	double txt, bin;
+
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s <directory> [<ndevs> [<loops>]]\n"
+			"Compare text and binary cache startup time\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+	if (argc > 2)
+		ndevs = atoi(argv[2]);
+	if (argc > 3)
+		loops = atoi(argv[3]);
+	if (ndevs <= 0 || loops <= 0)
+		errx(EXIT_FAILURE, "invalid arguments");
+
+	snprintf(txtfile, sizeof(txtfile), "%s/blkid.tab", argv[1]);
+	snprintf(binfile, sizeof(binfile), "%s/blkid.bin", argv[1]);
+
+	if (create_caches(argv[1], ndevs, txtfile, binfile) != 0)
+		err(EXIT_FAILURE, "failed to create cache files");
+
+	txt = bench(txtfile, argv[1], ndevs, loops);
+	bin = bench(binfile, argv[1], ndevs, loops);
+
+	printf("devices:      %d\n", ndevs);
+	printf("text cache:   %.3f ms per startup\n", txt * 1000.0);
+	printf("binary cache: %.3f ms per startup\n", bin * 1000.0);
+	if (bin > 0)
+		printf("speedup:      %.1fx\n", txt / bin);
+	return EXIT_SUCCESS;
+}
+#endif
@@ -31,6 +31,26 @@
 #include "blkid.h"
 #include "list.h"
 
+/*
+ * Hash index node, embedded in the indexed struct (see blkid_hash_*() in
+ * cache.c). The node is not hashed if the hlist is empty.
+ */
+struct blkid_hnode
+{
+	struct list_head	hlist;		/* hash bucket list */
+	unsigned int		hval;		/* hash value */
+};
+
+/*
+ * Hash index, all buckets are lists of struct blkid_hnode
+ */
+struct blkid_hash
+{
+	struct list_head	*buckets;	/* array of bucket heads */
+	size_t			nbuckets;	/* number of buckets (power of 2) */
+	size_t			nents;		/* number of hashed nodes */
+};
+
 /*
  * This describes the attributes of a specific device.
  * We can traverse all of the tags by bid_tags (linking to the tag bit_names).
@@ -51,6 +71,8 @@ struct blkid_struct_dev
 	unsigned int		bid_flags;	/* Device status bitflags */
 	char			*bid_label;	/* Shortcut to device LABEL */
 	char			*bid_uuid;	/* Shortcut to binary UUID */
+	struct blkid_hnode	bid_hname;	/* Cache index by bid_name */
+	struct blkid_hnode	bid_hdevno;	/* Cache index by bid_devno */
 };
 
 #define BLKID_BID_FL_VERIFIED	0x0001	/* Device data validated from disk */
@@ -71,6 +93,7 @@ struct blkid_struct_tag
 	char			*bit_name;	/* NAME of tag (shared) */
 	char			*bit_val;	/* value of tag */
 	blkid_dev		bit_dev;	/* pointer to device */
+	struct blkid_hnode	bit_hval;	/* Cache index by NAME=value */
 };
 typedef struct blkid_struct_tag *blkid_tag;
 
@@ -170,6 +193,19 @@ struct blkid_bufinfo {
 	blkid_loff_t		off;
 	blkid_loff_t		len;
 	struct list_head	bufs;	/* list of buffers */
+
+	struct blkid_bufinfo	*left;	/* buffers interval tree */
+	struct blkid_bufinfo	*right;
+	blkid_loff_t		maxend;	/* max. off + len in the subtree */
+};
+
+/*
+ * Probing I/O counters (see LIBBLKID_DEBUG=buffer), reset for every device
+ */
+struct blkid_iostat {
+	uint64_t		reads;	/* number of read() and mmap() calls */
+	uint64_t		bytes;	/* number of read or mapped bytes */
+	uint64_t		hits;	/* requests satisfied by existing buffers */
 };
 
 /*
@@ -195,6 +231,8 @@ struct blkid_struct_probe
 	struct blkid_chain	*wipe_chain;	/* superblock, partition, ... */
 
 	struct list_head	buffers;	/* list of buffers */
+	struct blkid_bufinfo	*buftree;	/* buffers interval tree (by offset) */
+	struct blkid_iostat	iostat;		/* I/O counters */
 
 	struct blkid_chain	chains[BLKID_NCHAINS];	/* array of chains */
 	struct blkid_chain	*cur_chain;		/* current chain */
@@ -235,6 +273,13 @@ struct blkid_config {
 	int nevals;			/* number of elems in eval array */
 	int uevent;			/* SEND_UEVENT=<yes|not> option */
 	char *cachefile;		/* CACHE_FILE=<path> option */
+	int cacheformat;		/* CACHE_FORMAT=<text|binary> option */
+};
+
+enum {
+	BLKID_CACHEFMT_DEFAULT = 0,	/* keep format of the current file */
+	BLKID_CACHEFMT_TEXT,
+	BLKID_CACHEFMT_BINARY
 };
 
 extern struct blkid_config *blkid_read_config(const char *filename)
@@ -255,25 +300,46 @@ extern void blkid_free_config(struct blkid_config *conf);
  */
 #define BLKID_PROBE_INTERVAL	200
 
+/*
+ * Result of the device probing done in parallel by probe_all() workers. The
+ * result is later used by blkid_verify() rather than probe the device again.
+ */
+struct blkid_prefetch
+{
+	blkid_dev		dev;		/* Standalone dev (without cache) */
+	int			rc;		/* blkid_probe_dev_tags() result */
+};
+
 /* This describes an entire blkid cache file and probed devices.
  * We can traverse all of the found devices via bic_list.
  * We can traverse all of the tag types by bic_tags, which hold empty tags
  * for each tag type.  Those tags can be used as list_heads for iterating
  * through all devices with a specific tag type (e.g. LABEL).
+ * The devices and tags are also hashed by name, devno and NAME=value to
+ * avoid list scans on lookups.
  */
+struct blkid_bincache;
+
 struct blkid_struct_cache
 {
 	struct list_head	bic_devs;	/* List head of all devices */
 	struct list_head	bic_tags;	/* List head of all tag types */
+	struct blkid_hash	bic_hnames;	/* Devices hashed by name */
+	struct blkid_hash	bic_hdevnos;	/* Devices hashed by devno */
+	struct blkid_hash	bic_hvals;	/* Tags hashed by NAME=value */
+	unsigned int		bic_nthreads;	/* Number of probe_all() threads */
+	struct blkid_prefetch	*bic_prefetch;	/* Result for blkid_verify() */
 	time_t			bic_time;	/* Last probe time */
 	time_t			bic_ftime;	/* Mod time of the cachefile */
 	unsigned int		bic_flags;	/* Status flags of the cache */
 	char			*bic_filename;	/* filename of cache */
+	struct blkid_bincache	*bic_bin;	/* mapped binary cache file */
 	blkid_probe		probe;		/* low-level probing stuff */
 };
 
 #define BLKID_BIC_FL_PROBED	0x0002	/* We probed /proc/partition devices */
 #define BLKID_BIC_FL_CHANGED	0x0004	/* Cache has changed from disk */
+#define BLKID_BIC_FL_BINARY	0x0008	/* Cache file is in binary format */
 
 /* config file */
 #define BLKID_CONFIG_FILE	"/etc/blkid.conf"
@@ -343,6 +409,11 @@ extern int blkid_driver_has_major(const char *drvname, int major)
 /* lseek.c */
 extern blkid_loff_t blkid_llseek(int fd, blkid_loff_t offset, int whence);
 
+/* verify.c */
+extern int blkid_probe_dev_tags(blkid_probe pr, blkid_dev dev)
+			__attribute__((nonnull));
+extern int blkid_verify_needs_probe(blkid_dev dev);
+
 /* read.c */
 extern void blkid_read_cache(blkid_cache cache)
 			__attribute__((nonnull));
@@ -351,6 +422,21 @@ extern void blkid_read_cache(blkid_cache cache)
 extern int blkid_flush_cache(blkid_cache cache)
 			__attribute__((nonnull));
 
+/* bincache.c */
+extern int blkid_bincache_open(blkid_cache cache, int fd, struct stat *st)
+			__attribute__((nonnull));
+extern void blkid_bincache_close(blkid_cache cache)
+			__attribute__((nonnull));
+extern void blkid_bincache_load_all(blkid_cache cache)
+			__attribute__((nonnull));
+extern void blkid_bincache_load_name(blkid_cache cache, const char *devname)
+			__attribute__((nonnull(1)));
+extern void blkid_bincache_load_tag(blkid_cache cache, const char *type,
+			const char *value)
+			__attribute__((nonnull(1)));
+extern int blkid_bincache_write(blkid_cache cache, FILE *f)
+			__attribute__((nonnull));
+
 /* cache */
 extern char *blkid_safe_getenv(const char *arg)
 			__attribute__((nonnull))
@@ -358,6 +444,25 @@ extern char *blkid_safe_getenv(const char *arg)
 
 extern char *blkid_get_cache_filename(struct blkid_config *conf)
 			__attribute__((warn_unused_result));
+
+extern int blkid_init_hash(struct blkid_hash *hash, size_t nbuckets)
+			__attribute__((nonnull));
+extern void blkid_free_hash(struct blkid_hash *hash);
+extern void blkid_hash_add(struct blkid_hash *hash, struct blkid_hnode *node,
+			   unsigned int hval)
+			__attribute__((nonnull));
+extern void blkid_hash_del(struct blkid_hash *hash, struct blkid_hnode *node)
+			__attribute__((nonnull));
+extern struct list_head *blkid_hash_bucket(struct blkid_hash *hash,
+			   unsigned int hval)
+			__attribute__((nonnull));
+extern unsigned int blkid_hash_string(unsigned int hval, const char *str)
+			__attribute__((nonnull));
+extern unsigned int blkid_hash_devno(dev_t devno);
+
+#define blkid_hash_entry(ptr, type, member) \
+	list_entry(ptr, type, member.hlist)
+
 /*
  * Functions to create and find a specific tag type: tag.c
  */
@@ -376,6 +481,7 @@ extern int blkid_set_tag(blkid_dev dev, const char *name,
 extern blkid_dev blkid_new_dev(void)
 			__attribute__((warn_unused_result));
 extern void blkid_free_dev(blkid_dev dev);
+extern void blkid_dev_set_devno(blkid_dev dev, dev_t devno);
 
 /* probe.c */
 extern int blkid_probe_is_tiny(blkid_probe pr)
@@ -406,6 +512,11 @@ extern int blkid_probe_get_idmag(blkid_probe pr, const struct blkid_idinfo *id,
 			blkid_loff_t *offset, const struct blkid_idmag **res)
 			__attribute__((nonnull(1)));
 
+extern void blkid_probe_advise_hot(blkid_probe pr)
+			__attribute__((nonnull));
+extern int blkid_probe_read_hot(blkid_probe pr)
+			__attribute__((nonnull));
+
 /* returns superblok according to 'struct blkid_idmag' */
 #define blkid_probe_get_sb(_pr, _mag, type) \
 			((type *) blkid_probe_get_buffer((_pr),\
@@ -81,6 +81,120 @@ char *blkid_get_cache_filename(struct blkid_config *conf)
 	return filename;
 }
 
+/*
+ * Hash index for the cache devices and tags. The buckets are lists of
+ * struct blkid_hnode (embedded in blkid_dev and blkid_tag). The table grows
+ * when the average bucket length exceeds BLKID_HASH_MAXLOAD; a failed resize
+ * is not fatal, the lookups are only slower.
+ */
+#define BLKID_HASH_INITSZ	64
+#define BLKID_HASH_MAXLOAD	2
+
+int blkid_init_hash(struct blkid_hash *hash, size_t nbuckets)
+{
+	size_t i;
+
+	hash->buckets = malloc(nbuckets * sizeof(struct list_head));
+	if (!hash->buckets)
+		return -BLKID_ERR_MEM;
+	for (i = 0; i < nbuckets; i++)
+		INIT_LIST_HEAD(&hash->buckets[i]);
+
+	hash->nbuckets = nbuckets;
+	hash->nents = 0;
+	return 0;
+}
+
+void blkid_free_hash(struct blkid_hash *hash)
+{
+	if (!hash)
+		return;
+	free(hash->buckets);
+	hash->buckets = NULL;
+	hash->nbuckets = 0;
+	hash->nents = 0;
+}
+
+static void resize_hash(struct blkid_hash *hash)
+{
+	struct blkid_hash new;
+	size_t i;
+
+	if (blkid_init_hash(&new, hash->nbuckets * 2) != 0)
+		return;
+
+	DBG(CACHE, ul_debug("resizing hash %p to %zu buckets",
+				hash, new.nbuckets));
+
+	/* keep order of the nodes within the buckets */
+	for (i = 0; i < hash->nbuckets; i++) {
+		struct list_head *p, *pnext;
+
+		list_for_each_safe(p, pnext, &hash->buckets[i]) {
+			struct blkid_hnode *node = list_entry(p,
+					struct blkid_hnode, hlist);
+
+			list_del(&node->hlist);
+			list_add_tail(&node->hlist,
+				&new.buckets[node->hval & (new.nbuckets - 1)]);
+		}
+	}
+	new.nents = hash->nents;
+	free(hash->buckets);
+	*hash = new;
+}
+
+void blkid_hash_add(struct blkid_hash *hash, struct blkid_hnode *node,
+		    unsigned int hval)
+{
+	if (!list_empty(&node->hlist))
+		blkid_hash_del(hash, node);
+	if (!hash->buckets)
+		return;
+	if (hash->nents >= hash->nbuckets * BLKID_HASH_MAXLOAD)
+		resize_hash(hash);
+
+	node->hval = hval;
+	list_add_tail(&node->hlist, &hash->buckets[hval & (hash->nbuckets - 1)]);
+	hash->nents++;
+}
+
+void blkid_hash_del(struct blkid_hash *hash, struct blkid_hnode *node)
+{
+	if (list_empty(&node->hlist))
+		return;
+	list_del_init(&node->hlist);
+	hash->nents--;
+}
+
+/* returns bucket list head for the hash value */
+struct list_head *blkid_hash_bucket(struct blkid_hash *hash, unsigned int hval)
+{
+	return &hash->buckets[hval & (hash->nbuckets - 1)];
+}
+
+/* FNV-1a, @hval is 0 or result from previous call */
+unsigned int blkid_hash_string(unsigned int hval, const char *str)
+{
+	if (!hval)
+		hval = 2166136261U;
+	while (*str) {
+		hval ^= (unsigned char) *str++;
+		hval *= 16777619U;
+	}
+	return hval;
+}
+
+unsigned int blkid_hash_devno(dev_t devno)
+{
+	uint64_t x = (uint64_t) devno;
+
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	return (unsigned int) x;
+}
+
 /**
  * blkid_get_cache:
  * @cache: pointer to return cache handler
@@ -108,6 +222,16 @@ int blkid_get_cache(blkid_cache *ret_cache, const char *filename)
 	INIT_LIST_HEAD(&cache->bic_devs);
 	INIT_LIST_HEAD(&cache->bic_tags);
 
+	if (blkid_init_hash(&cache->bic_hnames, BLKID_HASH_INITSZ) ||
+	    blkid_init_hash(&cache->bic_hdevnos, BLKID_HASH_INITSZ) ||
+	    blkid_init_hash(&cache->bic_hvals, BLKID_HASH_INITSZ)) {
+		blkid_free_hash(&cache->bic_hnames);
+		blkid_free_hash(&cache->bic_hdevnos);
+		blkid_free_hash(&cache->bic_hvals);
+		free(cache);
+		return -BLKID_ERR_MEM;
+	}
+
 	if (filename && !*filename)
 		filename = NULL;
 	if (filename)
@@ -162,11 +286,43 @@ void blkid_put_cache(blkid_cache cache)
 	}
 
 	blkid_free_probe(cache->probe);
+	blkid_bincache_close(cache);
+
+	blkid_free_hash(&cache->bic_hnames);
+	blkid_free_hash(&cache->bic_hdevnos);
+	blkid_free_hash(&cache->bic_hvals);
 
 	free(cache->bic_filename);
 	free(cache);
 }
 
+/**
+ * blkid_cache_set_nthreads:
+ * @cache: cache handler
+ * @nthreads: number of threads
+ *
+ * Enables parallel probing for blkid_probe_all() and blkid_probe_all_new().
+ * The devices from /proc/partitions are probed by @nthreads threads and the
+ * results are added to the cache in the same order as in the serial mode.
+ * The value 0 or 1 means serial probing (default).
+ *
+ * Note that the cache itself is not thread-safe, the threads are used
+ * internally by the library only.
+ *
+ * Returns: 0 on success, or number less than zero in case of error.
+ */
+int blkid_cache_set_nthreads(blkid_cache cache, unsigned int nthreads)
+{
+	if (!cache)
+		return -BLKID_ERR_PARAM;
+#ifndef HAVE_LIBPTHREAD
+	if (nthreads > 1)
+		DBG(CACHE, ul_debug("threads not supported, ignore"));
+#endif
+	cache->bic_nthreads = nthreads;
+	return 0;
+}
+
 /**
  * blkid_gc_cache:
  * @cache: cache handler
@@ -181,6 +337,8 @@ void blkid_gc_cache(blkid_cache cache)
 	if (!cache)
 		return;
 
+	blkid_bincache_load_all(cache);
+
 	list_for_each_safe(p, pnext, &cache->bic_devs) {
 		blkid_dev dev = list_entry(p, struct blkid_struct_dev, bid_devs);
 		if (stat(dev->bid_name, &st) < 0) {
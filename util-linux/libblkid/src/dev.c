@@ -39,6 +39,8 @@ blkid_dev blkid_new_dev(void)
 
 	INIT_LIST_HEAD(&dev->bid_devs);
 	INIT_LIST_HEAD(&dev->bid_tags);
+	INIT_LIST_HEAD(&dev->bid_hname.hlist);
+	INIT_LIST_HEAD(&dev->bid_hdevno.hlist);
 
 	return dev;
 }
@@ -54,6 +56,10 @@ void blkid_free_dev(blkid_dev dev)
 	DBG(DEV, blkid_debug_dump_dev(dev));
 
 	list_del(&dev->bid_devs);
+	if (dev->bid_cache) {
+		blkid_hash_del(&dev->bid_cache->bic_hnames, &dev->bid_hname);
+		blkid_hash_del(&dev->bid_cache->bic_hdevnos, &dev->bid_hdevno);
+	}
 	while (!list_empty(&dev->bid_tags)) {
 		blkid_tag tag = list_entry(dev->bid_tags.next,
 					   struct blkid_struct_tag,
@@ -64,6 +70,22 @@ void blkid_free_dev(blkid_dev dev)
 	free(dev);
 }
 
+/*
+ * Set device number and update the cache index
+ */
+void blkid_dev_set_devno(blkid_dev dev, dev_t devno)
+{
+	if (!dev)
+		return;
+	if (dev->bid_devno == devno && !list_empty(&dev->bid_hdevno.hlist))
+		return;
+
+	dev->bid_devno = devno;
+	if (dev->bid_cache)
+		blkid_hash_add(&dev->bid_cache->bic_hdevnos, &dev->bid_hdevno,
+			       blkid_hash_devno(devno));
+}
+
 /*
  * Given a blkid device, return its name
  */
@@ -131,6 +153,8 @@ blkid_dev_iterate blkid_dev_iterate_begin(blkid_cache cache)
 		return NULL;
 	}
 
+	blkid_bincache_load_all(cache);
+
 	iter = malloc(sizeof(struct blkid_struct_dev_iterate));
 	if (iter) {
 		iter->magic = DEV_ITERATE_MAGIC;
@@ -40,6 +40,11 @@
 #include "pathnames.h"
 #include "sysfs.h"
 #include "at.h"
+#include "strutils.h"
+
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
 
 /*
  * Find a dev struct in the cache by device name, if available.
@@ -50,14 +55,21 @@
 blkid_dev blkid_get_dev(blkid_cache cache, const char *devname, int flags)
 {
 	blkid_dev dev = NULL, tmp;
-	struct list_head *p, *pnext;
+	struct list_head *p, *pnext, *bucket;
+	unsigned int hval;
 
 	if (!cache || !devname)
 		return NULL;
 
-	list_for_each(p, &cache->bic_devs) {
-		tmp = list_entry(p, struct blkid_struct_dev, bid_devs);
-		if (strcmp(tmp->bid_name, devname))
+	if (cache->bic_bin)
+		blkid_bincache_load_name(cache, devname);
+
+	hval = blkid_hash_string(0, devname);
+	bucket = blkid_hash_bucket(&cache->bic_hnames, hval);
+
+	list_for_each(p, bucket) {
+		tmp = blkid_hash_entry(p, struct blkid_struct_dev, bid_hname);
+		if (tmp->bid_hname.hval != hval || strcmp(tmp->bid_name, devname))
 			continue;
 
 		DBG(DEVNAME, ul_debug("found devname %s in cache", tmp->bid_name));
@@ -73,8 +85,14 @@ blkid_dev blkid_get_dev(blkid_cache cache, const char *devname, int flags)
 			return NULL;
 		dev->bid_time = INT_MIN;
 		dev->bid_name = strdup(devname);
+		if (!dev->bid_name) {
+			blkid_free_dev(dev);
+			return NULL;
+		}
 		dev->bid_cache = cache;
 		list_add_tail(&dev->bid_devs, &cache->bic_devs);
+		blkid_hash_add(&cache->bic_hnames, &dev->bid_hname, hval);
+		blkid_dev_set_devno(dev, 0);
 		cache->bic_flags |= BLKID_BIC_FL_CHANGED;
 	}
 
@@ -89,6 +107,14 @@ blkid_dev blkid_get_dev(blkid_cache cache, const char *devname, int flags)
 		 * not be verified, then it's stale and so we remove
 		 * it.
 		 */
+		if (cache->bic_bin) {
+			if (dev->bid_uuid)
+				blkid_bincache_load_tag(cache, "UUID", dev->bid_uuid);
+			else if (dev->bid_label)
+				blkid_bincache_load_tag(cache, "LABEL", dev->bid_label);
+			else
+				blkid_bincache_load_tag(cache, "TYPE", dev->bid_type);
+		}
 		list_for_each_safe(p, pnext, &cache->bic_devs) {
 			blkid_dev dev2 = list_entry(p, struct blkid_struct_dev, bid_devs);
 			if (dev2->bid_flags & BLKID_BID_FL_VERIFIED)
@@ -151,31 +177,18 @@ static int is_dm_leaf(const char *devname)
 }
 
 /*
- * Probe a single block device to add to the device cache.
+ * Returns allocated device name for @ptname (e.g. from /proc/partitions) or
+ * NULL. If the device is already in the cache, then returns NULL and the
+ * device in @cached. The cache is not modified by this function.
  */
-static void probe_one(blkid_cache cache, const char *ptname,
-		      dev_t devno, int pri, int only_if_new, int removable)
+static char *ptname_to_devname(blkid_cache cache, const char *ptname,
+			       dev_t devno, blkid_dev *cached)
 {
-	blkid_dev dev = NULL;
-	struct list_head *p, *pnext;
 	const char **dir;
 	char *devname = NULL;
+	blkid_dev dev;
 
-	/* See if we already have this device number in the cache. */
-	list_for_each_safe(p, pnext, &cache->bic_devs) {
-		blkid_dev tmp = list_entry(p, struct blkid_struct_dev,
-					   bid_devs);
-		if (tmp->bid_devno == devno) {
-			if (only_if_new && !access(tmp->bid_name, F_OK))
-				return;
-			dev = blkid_verify(cache, tmp);
-			if (dev && (dev->bid_flags & BLKID_BID_FL_VERIFIED))
-				break;
-			dev = 0;
-		}
-	}
-	if (dev && dev->bid_devno == devno)
-		goto set_pri;
+	*cached = NULL;
 
 	/* Try to translate private device-mapper dm-<N> names
 	 * to standard /dev/mapper/<name>.
@@ -185,7 +198,7 @@ static void probe_one(blkid_cache cache, const char *ptname,
 		if (!devname)
 			blkid__scan_dir("/dev/mapper", devno, 0, &devname);
 		if (devname)
-			goto get_dev;
+			return devname;
 	}
 
 	/*
@@ -200,27 +213,58 @@ static void probe_one(blkid_cache cache, const char *ptname,
 
 		snprintf(device, sizeof(device), "%s/%s", *dir, ptname);
 		if ((dev = blkid_get_dev(cache, device, BLKID_DEV_FIND)) &&
-		    dev->bid_devno == devno)
-			goto set_pri;
+		    dev->bid_devno == devno) {
+			*cached = dev;
+			return NULL;
+		}
 
 		if (stat(device, &st) == 0 &&
 		    (S_ISBLK(st.st_mode) ||
 		     (S_ISCHR(st.st_mode) && !strncmp(ptname, "ubi", 3))) &&
-		    st.st_rdev == devno) {
-			devname = strdup(device);
-			goto get_dev;
-		}
+		    st.st_rdev == devno)
+			return strdup(device);
 	}
 	/* Do a short-cut scan of /dev/mapper first */
+	blkid__scan_dir("/dev/mapper", devno, 0, &devname);
 	if (!devname)
-		blkid__scan_dir("/dev/mapper", devno, 0, &devname);
-	if (!devname) {
 		devname = blkid_devno_to_devname(devno);
-		if (!devname)
-			return;
+	return devname;
+}
+
+/*
+ * Probe a single block device to add to the device cache.
+ */
+static void probe_one(blkid_cache cache, const char *ptname,
+		      dev_t devno, int pri, int only_if_new, int removable)
+{
+	blkid_dev dev = NULL;
+	struct list_head *p, *pnext, *bucket;
+	char *devname;
+
+	/* See if we already have this device number in the cache. */
+	bucket = blkid_hash_bucket(&cache->bic_hdevnos, blkid_hash_devno(devno));
+
+	list_for_each_safe(p, pnext, bucket) {
+		blkid_dev tmp = blkid_hash_entry(p, struct blkid_struct_dev,
+						 bid_hdevno);
+		if (tmp->bid_devno == devno) {
+			if (only_if_new && !access(tmp->bid_name, F_OK))
+				return;
+			dev = blkid_verify(cache, tmp);
+			if (dev && (dev->bid_flags & BLKID_BID_FL_VERIFIED))
+				break;
+			dev = 0;
+		}
 	}
+	if (dev && dev->bid_devno == devno)
+		goto set_pri;
+
+	devname = ptname_to_devname(cache, ptname, devno, &dev);
+	if (dev)
+		goto set_pri;
+	if (!devname)
+		return;
 
-get_dev:
 	dev = blkid_get_dev(cache, devname, BLKID_DEV_NORMAL);
 	free(devname);
 
@@ -412,6 +456,180 @@ ubi_probe_all(blkid_cache cache, int only_if_new)
 	}
 }
 
+/*
+ * Parallel probe_all() -- the devices from /proc/partitions are collected
+ * to the jobs array, probed by worker threads to standalone devices
+ * (struct blkid_prefetch) and then added to the cache by probe_one() in the
+ * original order. The workers don't modify the cache, so no locking is
+ * necessary; blkid_verify() uses the prefetched result instead of probing
+ * the device again.
+ */
+struct probe_job {
+	char			ptname[128 + 1];
+	dev_t			devno;
+	struct blkid_prefetch	pf;
+};
+
+struct probe_jobs {
+	blkid_cache		cache;
+	struct probe_job	*jobs;
+	size_t			njobs;
+	size_t			next;		/* next job for workers */
+	int			only_if_new;
+};
+
+static int add_probe_job(struct probe_jobs *pj, const char *ptname, dev_t devno)
+{
+	struct probe_job *job;
+
+	if (pj->njobs % 64 == 0) {
+		void *tmp = realloc(pj->jobs, (pj->njobs + 64) * sizeof(*job));
+		if (!tmp)
+			return -BLKID_ERR_MEM;
+		pj->jobs = tmp;
+	}
+	job = &pj->jobs[pj->njobs++];
+	memset(job, 0, sizeof(*job));
+	xstrncpy(job->ptname, ptname, sizeof(job->ptname));
+	job->devno = devno;
+	return 0;
+}
+
+/* returns the first device with @devno from the cache */
+static blkid_dev find_devno(blkid_cache cache, dev_t devno)
+{
+	struct list_head *p, *bucket;
+
+	bucket = blkid_hash_bucket(&cache->bic_hdevnos, blkid_hash_devno(devno));
+	list_for_each(p, bucket) {
+		blkid_dev dev = blkid_hash_entry(p, struct blkid_struct_dev,
+						 bid_hdevno);
+		if (dev->bid_devno == devno)
+			return dev;
+	}
+	return NULL;
+}
+
+/*
+ * Probes the device which is going to be verified by probe_one() for the
+ * job. It follows probe_one() logic, but read-only.
+ */
+static void prefetch_job(struct probe_jobs *pj, blkid_probe pr,
+			 struct probe_job *job)
+{
+	blkid_dev dev, old;
+	char *devname;
+
+	old = find_devno(pj->cache, job->devno);
+	if (old) {
+		if (pj->only_if_new && !access(old->bid_name, F_OK))
+			return;
+		devname = strdup(old->bid_name);
+	} else {
+		devname = ptname_to_devname(pj->cache, job->ptname,
+					    job->devno, &old);
+		if (old)
+			return;
+		if (devname)
+			old = blkid_get_dev(pj->cache, devname, BLKID_DEV_FIND);
+	}
+	if (!devname)
+		return;
+
+	dev = blkid_new_dev();
+	if (!dev) {
+		free(devname);
+		return;
+	}
+	dev->bid_name = devname;
+	dev->bid_time = INT_MIN;
+
+	if (!blkid_verify_needs_probe(old ? old : dev)) {
+		blkid_free_dev(dev);
+		return;
+	}
+
+	DBG(DEVNAME, ul_debug("prefetching %s", devname));
+	job->pf.rc = blkid_probe_dev_tags(pr, dev);
+	job->pf.dev = dev;
+}
+
+static void *probe_worker(void *data)
+{
+	struct probe_jobs *pj = (struct probe_jobs *) data;
+	blkid_probe pr;
+
+	pr = blkid_new_probe();
+	if (!pr)
+		return NULL;
+
+	for (;;) {
+		size_t i = __sync_fetch_and_add(&pj->next, 1);
+
+		if (i >= pj->njobs)
+			break;
+		prefetch_job(pj, pr, &pj->jobs[i]);
+	}
+
+	blkid_free_probe(pr);
+	return NULL;
+}
+
+static void run_probe_jobs(blkid_cache cache, struct probe_jobs *pj)
+{
+	size_t i;
+#ifdef HAVE_LIBPTHREAD
+	pthread_t *threads = NULL;
+	unsigned int nthreads = cache->bic_nthreads, n = 0;
+
+	if (nthreads > pj->njobs)
+		nthreads = pj->njobs;
+
+	DBG(DEVNAME, ul_debug("probing %zu devices by %u threads",
+				pj->njobs, nthreads));
+
+	/* the current thread is the first worker */
+	if (nthreads > 1)
+		threads = calloc(nthreads - 1, sizeof(pthread_t));
+	if (threads) {
+		for (n = 0; n < nthreads - 1; n++) {
+			if (pthread_create(&threads[n], NULL, probe_worker, pj))
+				break;
+		}
+	}
+#endif
+	probe_worker(pj);
+
+#ifdef HAVE_LIBPTHREAD
+	for (i = 0; i < n; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+#endif
+	/* add to cache in /proc/partitions order */
+	for (i = 0; i < pj->njobs; i++) {
+		struct probe_job *job = &pj->jobs[i];
+
+		cache->bic_prefetch = &job->pf;
+		probe_one(cache, job->ptname, job->devno, 0, pj->only_if_new, 0);
+		cache->bic_prefetch = NULL;
+
+		blkid_free_dev(job->pf.dev);
+	}
+}
+
+/*
+ * Probes the device now, or adds it to @pj if parallel probing is enabled.
+ */
+static int probe_or_add_job(blkid_cache cache, struct probe_jobs *pj,
+			    const char *ptname, dev_t devno, int only_if_new)
+{
+	if (pj)
+		return add_probe_job(pj, ptname, devno);
+
+	probe_one(cache, ptname, devno, 0, only_if_new, 0);
+	return 0;
+}
+
 /*
  * Read the device data for all available block devices in the system.
  */
@@ -427,6 +645,8 @@ static int probe_all(blkid_cache cache, int only_if_new)
 	int lens[2] = { 0, 0 };
 	int which = 0, last = 0;
 	struct list_head *p, *pnext;
+	struct probe_jobs jobs = { .cache = cache, .only_if_new = only_if_new };
+	struct probe_jobs *pj = NULL;
 
 	ptnames[0] = ptname0;
 	ptnames[1] = ptname1;
@@ -439,6 +659,7 @@ static int probe_all(blkid_cache cache, int only_if_new)
 		return 0;
 
 	blkid_read_cache(cache);
+	blkid_bincache_load_all(cache);		/* devno lookups */
 	evms_probe_all(cache, only_if_new);
 #ifdef VG_DIR
 	lvm_probe_all(cache, only_if_new);
@@ -449,6 +670,11 @@ static int probe_all(blkid_cache cache, int only_if_new)
 	if (!proc)
 		return -BLKID_ERR_PROC;
 
+#ifdef HAVE_LIBPTHREAD
+	if (cache->bic_nthreads > 1)
+		pj = &jobs;
+#endif
+
 	while (fgets(line, sizeof(line), proc)) {
 		last = which;
 		which ^= 1;
@@ -480,9 +706,10 @@ static int probe_all(blkid_cache cache, int only_if_new)
 			DBG(DEVNAME, ul_debug("partition dev %s, devno 0x%04X",
 				   ptname, (unsigned int) devs[which]));
 
-			if (sz > 1)
-				probe_one(cache, ptname, devs[which], 0,
-					  only_if_new, 0);
+			if (sz > 1 &&
+			    probe_or_add_job(cache, pj, ptname, devs[which],
+					     only_if_new))
+				goto err;
 			lens[which] = 0;	/* mark as checked */
 		}
 
@@ -492,12 +719,16 @@ static int probe_all(blkid_cache cache, int only_if_new)
 		 * it exists.
 		 */
 		if (lens[last] && !strncmp(ptnames[last], ptname, lens[last])) {
-			list_for_each_safe(p, pnext, &cache->bic_devs) {
+			struct list_head *bucket = blkid_hash_bucket(
+					&cache->bic_hdevnos,
+					blkid_hash_devno(devs[last]));
+
+			list_for_each_safe(p, pnext, bucket) {
 				blkid_dev tmp;
 
 				/* find blkid dev for the whole-disk devno */
-				tmp = list_entry(p, struct blkid_struct_dev,
-						 bid_devs);
+				tmp = blkid_hash_entry(p, struct blkid_struct_dev,
+						       bid_hdevno);
 				if (tmp->bid_devno == devs[last]) {
 					DBG(DEVNAME, ul_debug("freeing %s",
 						       tmp->bid_name));
@@ -516,19 +747,30 @@ static int probe_all(blkid_cache cache, int only_if_new)
 		if (lens[last] && strncmp(ptnames[last], ptname, lens[last])) {
 			DBG(DEVNAME, ul_debug("whole dev %s, devno 0x%04X",
 				   ptnames[last], (unsigned int) devs[last]));
-			probe_one(cache, ptnames[last], devs[last], 0,
-				  only_if_new, 0);
+			if (probe_or_add_job(cache, pj, ptnames[last],
+					     devs[last], only_if_new))
+				goto err;
 			lens[last] = 0;
 		}
 	}
 
 	/* Handle the last device if it wasn't partitioned */
-	if (lens[which])
-		probe_one(cache, ptname, devs[which], 0, only_if_new, 0);
+	if (lens[which] &&
+	    probe_or_add_job(cache, pj, ptname, devs[which], only_if_new))
+		goto err;
 
 	fclose(proc);
+
+	if (pj)
+		run_probe_jobs(cache, pj);
+	free(jobs.jobs);
+
 	blkid_flush_cache(cache);
 	return 0;
+err:
+	fclose(proc);
+	free(jobs.jobs);
+	return -BLKID_ERR_MEM;
 }
 
 /* Don't use it by default -- it's pretty slow (because cdroms, floppy, ...)
@@ -541,6 +783,8 @@ static int probe_all_removable(blkid_cache cache)
 	if (!cache)
 		return -BLKID_ERR_PARAM;
 
+	blkid_bincache_load_all(cache);
+
 	dir = opendir(_PATH_SYS_BLOCK);
 	if (!dir)
 		return -BLKID_ERR_PROC;
@@ -590,6 +590,13 @@ int __blkid_probe_filter_types(blkid_probe pr, int chain, int flag, char *names[
 
 #define probe_is_mmap_wanted(p)		(!S_ISCHR((p)->mode))
 
+/* read() requests are extended to aligned chunks to merge nearby requests */
+#define PROBE_READ_CHUNKSIZ	(64ULL * 1024ULL)
+
+/* hot areas, read-ahead is requested when the first buffer is created */
+#define PROBE_HOT_BEGINSIZ	(64ULL * 1024ULL)		/* begin of the device */
+#define PROBE_HOT_ENDSIZ	(1024ULL * 1024ULL)		/* end of the device */
+
 static struct blkid_bufinfo *mmap_buffer(blkid_probe pr,
 					 blkid_loff_t real_off,
 					 blkid_loff_t len)
@@ -659,24 +666,22 @@ static struct blkid_bufinfo *mmap_buffer(blkid_probe pr,
 	bf->len = map_len;
 	INIT_LIST_HEAD(&bf->bufs);
 
+	pr->iostat.reads++;
+	pr->iostat.bytes += map_len;
+
 	DBG(BUFFER, ul_debug("\tmmap  %p: off=%ju, len=%ju (%ju pages)",
 				bf->data, (uintmax_t) map_off, (uintmax_t) map_len,
 				(uintmax_t) map_len / pr->mmap_granularity));
 	return bf;
 }
 
-static struct blkid_bufinfo *read_buffer(blkid_probe pr,
-					 blkid_loff_t real_off,
-					 blkid_loff_t len)
+static struct blkid_bufinfo *pread_buffer(blkid_probe pr,
+					  blkid_loff_t real_off,
+					  blkid_loff_t len)
 {
 	ssize_t ret;
 	struct blkid_bufinfo *bf = NULL;
 
-	if (blkid_llseek(pr->fd, real_off, SEEK_SET) < 0) {
-		errno = 0;
-		return NULL;
-	}
-
 	/* someone trying to overflow some buffers? */
 	if (len > ULONG_MAX - sizeof(struct blkid_bufinfo)) {
 		errno = ENOMEM;
@@ -697,18 +702,121 @@ static struct blkid_bufinfo *read_buffer(blkid_probe pr,
 
 	DBG(LOWPROBE, ul_debug("\tread %p: off=%jd len=%jd", bf->data, real_off, len));
 
-	ret = read(pr->fd, bf->data, len);
+	ret = pread(pr->fd, bf->data, len, real_off);
+	pr->iostat.reads++;
+
 	if (ret != (ssize_t) len) {
 		DBG(LOWPROBE, ul_debug("\tread failed: %m"));
 		free(bf);
-		if (ret >= 0)
+		/* unseekable or unsupported offset, see lseek(2) */
+		if (ret >= 0 || errno == ESPIPE || errno == EINVAL || errno == EOVERFLOW)
 			errno = 0;
 		return NULL;
 	}
 
+	pr->iostat.bytes += len;
+	return bf;
+}
+
+/*
+ * The request is extended to PROBE_READ_CHUNKSIZ aligned area (within the
+ * probing area), so the next requests for nearby offsets are satisfied from
+ * the same buffer. The exact request is used if the extended read fails.
+ */
+static struct blkid_bufinfo *read_buffer(blkid_probe pr,
+					 blkid_loff_t real_off,
+					 blkid_loff_t len)
+{
+	struct blkid_bufinfo *bf;
+	blkid_loff_t start = real_off & ~(PROBE_READ_CHUNKSIZ - 1),
+		     end = real_off + len;
+
+	if (end % PROBE_READ_CHUNKSIZ)
+		end += PROBE_READ_CHUNKSIZ - (end % PROBE_READ_CHUNKSIZ);
+	if (start < pr->off)
+		start = pr->off;
+	if (end > pr->off + pr->size)
+		end = pr->off + pr->size;
+
+	if (start == real_off && end == real_off + len)
+		return pread_buffer(pr, real_off, len);
+
+	bf = pread_buffer(pr, start, end - start);
+	if (!bf && errno != ENOMEM)
+		bf = pread_buffer(pr, real_off, len);
 	return bf;
 }
 
+/*
+ * Requests read-ahead for the areas where the most of the superblocks and
+ * partition tables are stored. The device is opened with POSIX_FADV_RANDOM, so
+ * without this the kernel reads only the requested pages.
+ */
+void blkid_probe_advise_hot(blkid_probe pr)
+{
+#if defined(POSIX_FADV_WILLNEED) && defined(HAVE_POSIX_FADVISE)
+	blkid_loff_t len;
+
+	/* CD/DVDs are slow to read the end of the disc */
+	if (pr->flags & (BLKID_FL_CDROM_DEV | BLKID_FL_TINY_DEV))
+		return;
+
+	len = pr->size < (blkid_loff_t) PROBE_HOT_BEGINSIZ ?
+			pr->size : (blkid_loff_t) PROBE_HOT_BEGINSIZ;
+	posix_fadvise(pr->fd, pr->off, len, POSIX_FADV_WILLNEED);
+
+	if (pr->size > (blkid_loff_t) (PROBE_HOT_BEGINSIZ + PROBE_HOT_ENDSIZ))
+		posix_fadvise(pr->fd, pr->off + pr->size - PROBE_HOT_ENDSIZ,
+				PROBE_HOT_ENDSIZ, POSIX_FADV_WILLNEED);
+
+	DBG(BUFFER, ul_debug("\tread-ahead requested for hot areas"));
+#endif
+}
+
+/*
+ * Buffers interval tree -- the buffers are sorted by offset, every node keeps
+ * the maximal end of the buffers in the subtree. The tree is not balanced, but
+ * the probing requests are not sequential and the number of buffers is small.
+ */
+static void buftree_insert(blkid_probe pr, struct blkid_bufinfo *bf)
+{
+	struct blkid_bufinfo **node = &pr->buftree;
+	blkid_loff_t end = bf->off + bf->len;
+
+	bf->left = bf->right = NULL;
+	bf->maxend = end;
+
+	while (*node) {
+		if ((*node)->maxend < end)
+			(*node)->maxend = end;
+		node = bf->off < (*node)->off ? &(*node)->left : &(*node)->right;
+	}
+	*node = bf;
+}
+
+/* returns a buffer which contains the whole <off, off + len) area */
+static struct blkid_bufinfo *buftree_lookup(struct blkid_bufinfo *node,
+					    blkid_loff_t off, blkid_loff_t len)
+{
+	blkid_loff_t end = off + len;
+
+	while (node && node->maxend >= end) {
+		if (node->off <= off && node->off + node->len >= end)
+			return node;
+
+		if (node->left && node->left->maxend >= end) {
+			struct blkid_bufinfo *x = buftree_lookup(node->left, off, len);
+			if (x)
+				return x;
+		}
+		/* all buffers in the right subtree start after @off */
+		if (node->off > off)
+			break;
+		node = node->right;
+	}
+	return NULL;
+}
+
 /*
  * Note that @off is offset within probing area, the probing area is defined by
  * pr->off and pr->size.
@@ -716,7 +824,6 @@ static struct blkid_bufinfo *read_buffer(blkid_probe pr,
 unsigned char *blkid_probe_get_buffer(blkid_probe pr,
 				blkid_loff_t off, blkid_loff_t len)
 {
-	struct list_head *p;
 	struct blkid_bufinfo *bf = NULL;
 	blkid_loff_t real_off = pr->off + off;
 
@@ -752,21 +859,18 @@ unsigned char *blkid_probe_get_buffer(blkid_probe pr,
 	}
 
 	/* try buffers we already have in memmory */
-	list_for_each(p, &pr->buffers) {
-		struct blkid_bufinfo *x =
-				list_entry(p, struct blkid_bufinfo, bufs);
-
-		if (real_off >= x->off && real_off + len <= x->off + x->len) {
-			DBG(BUFFER, ul_debug("\treuse %p: off=%jd len=%jd (for off=%jd len=%jd)",
-						x->data, x->off, x->len,
-						real_off, len));
-			bf = x;
-			break;
-		}
+	bf = buftree_lookup(pr->buftree, real_off, len);
+	if (bf) {
+		DBG(BUFFER, ul_debug("\treuse %p: off=%jd len=%jd (for off=%jd len=%jd)",
+					bf->data, bf->off, bf->len,
+					real_off, len));
+		pr->iostat.hits++;
 	}
 
 	/* not found; read from disk */
 	if (!bf) {
+		if (list_empty(&pr->buffers))
+			blkid_probe_advise_hot(pr);
 		if (probe_is_mmap_wanted(pr))
 			bf = mmap_buffer(pr, real_off, len);
 		else
@@ -775,6 +879,7 @@ unsigned char *blkid_probe_get_buffer(blkid_probe pr,
 			return NULL;
 
 		list_add_tail(&bf->bufs, &pr->buffers);
+		buftree_insert(pr, bf);
 	}
 
 	assert(bf->off <= real_off);
@@ -784,6 +889,52 @@ unsigned char *blkid_probe_get_buffer(blkid_probe pr,
 	return real_off ? bf->data + (real_off - bf->off) : bf->data;
 }
 
+/* wait for the mapped data; the buffer is mapped, but not read yet */
+static void touch_buffer(blkid_probe pr, unsigned char *buf, blkid_loff_t len)
+{
+	volatile unsigned char x = 0;
+	blkid_loff_t i;
+
+	for (i = 0; i < len; i += pr->mmap_granularity)
+		x ^= buf[i];
+	(void) x;
+}
+
+/*
+ * Reads the hot areas (see blkid_probe_advise_hot()) to the probing buffers.
+ * This is used by blkid_probe_batch_prefetch() to read more devices in
+ * parallel; the probing functions then use the buffers.
+ *
+ * Returns: 0 on success, or -errno in case of error.
+ */
+int blkid_probe_read_hot(blkid_probe pr)
+{
+	unsigned char *buf;
+	blkid_loff_t len;
+
+	if (pr->size <= 0 || (pr->flags & (BLKID_FL_CDROM_DEV | BLKID_FL_NOSCAN_DEV)))
+		return 0;
+
+	len = pr->size < (blkid_loff_t) PROBE_HOT_BEGINSIZ ?
+			pr->size : (blkid_loff_t) PROBE_HOT_BEGINSIZ;
+	buf = blkid_probe_get_buffer(pr, 0, len);
+	if (!buf && errno)
+		return -errno;
+	if (buf && probe_is_mmap_wanted(pr))
+		touch_buffer(pr, buf, len);
+
+	if (blkid_probe_is_tiny(pr) ||
+	    pr->size <= (blkid_loff_t) (PROBE_HOT_BEGINSIZ + PROBE_HOT_ENDSIZ))
+		return 0;
+
+	buf = blkid_probe_get_buffer(pr, pr->size - PROBE_HOT_ENDSIZ, PROBE_HOT_ENDSIZ);
+	if (!buf && errno)
+		return -errno;
+	if (buf && probe_is_mmap_wanted(pr))
+		touch_buffer(pr, buf, PROBE_HOT_ENDSIZ);
+	return 0;
+}
+
 static void blkid_probe_reset_buffer(blkid_probe pr)
 {
 	uint64_t ct = 0, len = 0;
@@ -809,8 +960,11 @@ static void blkid_probe_reset_buffer(blkid_probe pr)
 
 	DBG(LOWPROBE, ul_debug(" buffers summary: %ju bytes by %ju read/mmap() calls",
 			len, ct));
+	DBG(BUFFER, ul_debug(" I/O summary: %ju bytes by %ju read/mmap() calls, %ju hits",
+			pr->iostat.bytes, pr->iostat.reads, pr->iostat.hits));
 
 	INIT_LIST_HEAD(&pr->buffers);
+	pr->buftree = NULL;
 }
 
 static void blkid_probe_reset_values(blkid_probe pr)
@@ -869,6 +1023,9 @@ int blkid_probe_set_device(blkid_probe pr, int fd,
 	blkid_reset_probe(pr);
 	blkid_probe_reset_buffer(pr);
 
+	/* the counters are per device */
+	memset(&pr->iostat, 0, sizeof(pr->iostat));
+
 	if ((pr->flags & BLKID_FL_PRIVATE_FD) && pr->fd >= 0)
 		close(pr->fd);
 
@@ -323,7 +323,7 @@ static int parse_tag(blkid_cache cache, blkid_dev dev, char **cp)
 
 	/* Some tags are stored directly in the device struct */
 	if (!strcmp(name, "DEVNO"))
-		dev->bid_devno = strtoull(value, 0, 0);
+		blkid_dev_set_devno(dev, strtoull(value, 0, 0));
 	else if (!strcmp(name, "PRI"))
 		dev->bid_pri = strtol(value, 0, 0);
 	else if (!strcmp(name, "TIME")) {
@@ -416,6 +416,21 @@ void blkid_read_cache(blkid_cache cache)
 	DBG(CACHE, ul_debug("reading cache file %s",
 				cache->bic_filename));
 
+	/*
+	 * The binary cache is only mapped, devices are added to the cache
+	 * on demand by blkid_bincache_load_*().
+	 */
+	switch (blkid_bincache_open(cache, fd, &st)) {
+	case 0:
+		goto done;
+	case 1:
+		blkid_bincache_close(cache);
+		cache->bic_flags &= ~BLKID_BIC_FL_BINARY;
+		break;
+	default:
+		goto errout;
+	}
+
 	file = fdopen(fd, "r" UL_CLOEXECSTR);
 	if (!file)
 		goto errout;
@@ -441,17 +456,16 @@ void blkid_read_cache(blkid_cache cache)
 		}
 	}
 	fclose(file);
-
+	fd = -1;
+done:
 	/*
 	 * Initially we do not need to write out the cache file.
 	 */
 	cache->bic_flags &= ~BLKID_BIC_FL_CHANGED;
 	cache->bic_ftime = st.st_mtime;
-
-	return;
 errout:
-	close(fd);
-	return;
+	if (fd >= 0)
+		close(fd);
 }
 
 #ifdef TEST_PROGRAM
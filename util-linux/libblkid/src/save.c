@@ -72,6 +72,23 @@ static int save_dev(blkid_dev dev, FILE *file)
 	return 0;
 }
 
+/*
+ * Returns 1 if the cache should be written in the binary format. The format is
+ * specified by CACHE_FORMAT= in blkid.conf, default is to keep format of the
+ * current cache file.
+ */
+static int is_binary_format(blkid_cache cache)
+{
+	struct blkid_config *conf = blkid_read_config(NULL);
+	int fmt = conf ? conf->cacheformat : BLKID_CACHEFMT_DEFAULT;
+
+	blkid_free_config(conf);
+
+	if (fmt == BLKID_CACHEFMT_DEFAULT)
+		return cache->bic_flags & BLKID_BIC_FL_BINARY ? 1 : 0;
+	return fmt == BLKID_CACHEFMT_BINARY;
+}
+
 /*
  * Write out the cache struct to the cache file on disk.
  */
@@ -82,12 +99,18 @@ int blkid_flush_cache(blkid_cache cache)
 	char *opened = NULL;
 	char *filename;
 	FILE *file = NULL;
-	int fd, ret = 0;
+	int fd, ret = 0, binary;
 	struct stat st;
 
 	if (!cache)
 		return -BLKID_ERR_PARAM;
 
+	/* all devices from the mapped file have to be in the cache now */
+	if (cache->bic_bin && (cache->bic_flags & BLKID_BIC_FL_CHANGED)) {
+		blkid_bincache_load_all(cache);
+		blkid_bincache_close(cache);
+	}
+
 	if (list_empty(&cache->bic_devs) ||
 	    !(cache->bic_flags & BLKID_BIC_FL_CHANGED)) {
 		DBG(SAVE, ul_debug("skipping cache file write"));
@@ -158,16 +181,25 @@ int blkid_flush_cache(blkid_cache cache)
 		goto errout;
 	}
 
-	list_for_each(p, &cache->bic_devs) {
-		blkid_dev dev = list_entry(p, struct blkid_struct_dev, bid_devs);
-		if (!dev->bid_type || (dev->bid_flags & BLKID_BID_FL_REMOVABLE))
-			continue;
-		if ((ret = save_dev(dev, file)) < 0)
-			break;
+	binary = is_binary_format(cache);
+	if (binary)
+		ret = blkid_bincache_write(cache, file);
+	else {
+		list_for_each(p, &cache->bic_devs) {
+			blkid_dev dev = list_entry(p, struct blkid_struct_dev, bid_devs);
+			if (!dev->bid_type || (dev->bid_flags & BLKID_BID_FL_REMOVABLE))
+				continue;
+			if ((ret = save_dev(dev, file)) < 0)
+				break;
+		}
 	}
 
 	if (ret >= 0) {
 		cache->bic_flags &= ~BLKID_BIC_FL_CHANGED;
+		if (binary)
+			cache->bic_flags |= BLKID_BIC_FL_BINARY;
+		else
+			cache->bic_flags &= ~BLKID_BIC_FL_BINARY;
 		ret = 1;
 	}
 
@@ -19,6 +19,10 @@
 #include <stdint.h>
 #include <stdarg.h>
 
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
+
 #include "superblocks.h"
 
 /**
@@ -78,6 +82,7 @@
 
 static int superblocks_probe(blkid_probe pr, struct blkid_chain *chn);
 static int superblocks_safeprobe(blkid_probe pr, struct blkid_chain *chn);
+static void superblocks_free_data(blkid_probe pr, void *data);
 
 static int blkid_probe_set_usage(blkid_probe pr, int usage);
 
@@ -172,8 +177,219 @@ const struct blkid_chaindrv superblocks_drv = {
 	.has_fltr     = TRUE,
 	.probe        = superblocks_probe,
 	.safeprobe    = superblocks_safeprobe,
+	.free_data    = superblocks_free_data
+};
+
+/*
+ * Magic strings dispatch table
+ *
+ * All magic strings from idinfos[] are grouped by the 1KiB area (region) where
+ * they are stored on the device. The region is read and compared with all the
+ * magic strings from the region by one pass when a prober needs it for the
+ * first time. The probers without matching magic are skipped without any
+ * buffer lookup.
+ *
+ * The table is built on the first use and it's shared by all probers.
+ */
+struct sb_region {
+	blkid_loff_t		off;		/* offset of the 1KiB area */
+	size_t			first;		/* first magic in sb_magics.order[] */
+	size_t			nmags;		/* number of magics in the region */
+};
+
+static struct sb_magics {
+	size_t			first[ARRAY_SIZE(idinfos)];	/* first magic of idinfos[] */
+	const struct blkid_idmag **mags;	/* all magics in idinfos[] order */
+	size_t			*region;	/* region of the magic */
+	size_t			*order;		/* magics ordered by region */
+	struct sb_region	*regions;
+	size_t			nmags;
+	size_t			nregions;
+	int			ready;
+} sb_magics;
+
+/* per-probe state, reset by superblocks_probe() */
+struct sb_magics_state {
+	int			*rstat;		/* 0 = not read, 1 = scanned, <0 = -errno */
+	unsigned char		*matched;	/* bitmap with matching magics */
 };
 
+static inline blkid_loff_t magic_area_offset(const struct blkid_idmag *mag)
+{
+	return (mag->kboff + (mag->sboff >> 10)) << 10;
+}
+
+static void init_magics(void)
+{
+	struct sb_magics *sm = &sb_magics;
+	size_t i, n = 0, *count = NULL;
+
+	for (i = 0; i < ARRAY_SIZE(idinfos); i++) {
+		const struct blkid_idmag *mag;
+
+		sm->first[i] = n;
+		for (mag = &idinfos[i]->magics[0]; mag->magic; mag++)
+			n++;
+	}
+
+	sm->mags = calloc(n, sizeof(*sm->mags));
+	sm->region = calloc(n, sizeof(*sm->region));
+	sm->order = calloc(n, sizeof(*sm->order));
+	sm->regions = calloc(n, sizeof(*sm->regions));
+	count = calloc(n, sizeof(*count));
+	if (!sm->mags || !sm->region || !sm->order || !sm->regions || !count)
+		goto err;
+
+	for (i = 0; i < ARRAY_SIZE(idinfos); i++) {
+		const struct blkid_idmag *mag;
+		size_t g = sm->first[i];
+
+		for (mag = &idinfos[i]->magics[0]; mag->magic; mag++, g++) {
+			blkid_loff_t off = magic_area_offset(mag);
+			size_t r;
+
+			for (r = 0; r < sm->nregions; r++) {
+				if (sm->regions[r].off == off)
+					break;
+			}
+			if (r == sm->nregions)
+				sm->regions[sm->nregions++].off = off;
+
+			sm->mags[g] = mag;
+			sm->region[g] = r;
+			sm->regions[r].nmags++;
+		}
+	}
+	sm->nmags = n;
+
+	/* group magics by region */
+	for (i = 1; i < sm->nregions; i++)
+		sm->regions[i].first = sm->regions[i - 1].first +
+				       sm->regions[i - 1].nmags;
+	for (i = 0; i < n; i++) {
+		size_t r = sm->region[i];
+
+		sm->order[sm->regions[r].first + count[r]++] = i;
+	}
+
+	free(count);
+	sm->ready = 1;
+	return;
+err:
+	free(sm->mags);
+	free(sm->region);
+	free(sm->order);
+	free(sm->regions);
+	free(count);
+	memset(sm, 0, sizeof(*sm));
+}
+
+static struct sb_magics *get_magics(void)
+{
+#ifdef HAVE_LIBPTHREAD
+	static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+	pthread_once(&once, init_magics);
+#else
+	if (!sb_magics.ready && !sb_magics.mags)
+		init_magics();
+#endif
+	return sb_magics.ready ? &sb_magics : NULL;
+}
+
+static struct sb_magics_state *get_magics_state(struct blkid_chain *chn)
+{
+	struct sb_magics *sm = get_magics();
+	struct sb_magics_state *st = (struct sb_magics_state *) chn->data;
+	size_t sz;
+
+	if (!sm)
+		return NULL;
+
+	sz = sizeof(*st) + sm->nregions * sizeof(int) + sm->nmags / NBBY + 1;
+	if (!st) {
+		st = malloc(sz);
+		if (!st)
+			return NULL;
+		chn->data = st;
+	}
+	memset(st, 0, sz);
+	st->rstat = (int *) (st + 1);
+	st->matched = (unsigned char *) (st->rstat + sm->nregions);
+	return st;
+}
+
+static void superblocks_free_data(blkid_probe pr __attribute__((__unused__)),
+				  void *data)
+{
+	free(data);
+}
+
+/* reads the region @r and compares all magic strings from the region */
+static int scan_region(blkid_probe pr, struct sb_magics *sm,
+		       struct sb_magics_state *st, size_t r)
+{
+	const struct sb_region *rg = &sm->regions[r];
+	unsigned char *buf;
+	size_t i;
+
+	buf = blkid_probe_get_buffer(pr, rg->off, 1024);
+	if (!buf && errno)
+		return -errno;
+	if (!buf)
+		return 1;
+
+	for (i = rg->first; i < rg->first + rg->nmags; i++) {
+		size_t g = sm->order[i];
+		const struct blkid_idmag *mag = sm->mags[g];
+
+		if (!memcmp(mag->magic, buf + (mag->sboff & 0x3ff), mag->len))
+			setbit(st->matched, g);
+	}
+	return 1;
+}
+
+/*
+ * The same as blkid_probe_get_idmag() for idinfos[@i], but uses the dispatch
+ * table.
+ */
+static int superblocks_get_idmag(blkid_probe pr, struct sb_magics_state *st,
+			size_t i, blkid_loff_t *offset,
+			const struct blkid_idmag **res)
+{
+	struct sb_magics *sm = &sb_magics;
+	const struct blkid_idinfo *id = idinfos[i];
+	const struct blkid_idmag *mag;
+	size_t g = sm->first[i];
+
+	if (!st)
+		return blkid_probe_get_idmag(pr, id, offset, res);
+
+	*res = NULL;
+
+	for (mag = &id->magics[0]; mag->magic; mag++, g++) {
+		size_t r = sm->region[g];
+
+		if (!st->rstat[r])
+			st->rstat[r] = scan_region(pr, sm, st, r);
+		if (st->rstat[r] < 0)
+			return st->rstat[r];
+		if (isset(st->matched, g)) {
+			DBG(LOWPROBE, ul_debug("\tmagic sboff=%u, kboff=%ld",
+				mag->sboff, mag->kboff));
+			*offset = magic_area_offset(mag) + (mag->sboff & 0x3ff);
+			*res = mag;
+			return BLKID_PROBE_OK;
+		}
+	}
+
+	if (id->magics[0].magic)
+		/* magic string(s) defined, but not found */
+		return BLKID_PROBE_NONE;
+
+	return BLKID_PROBE_OK;
+}
+
 /**
  * blkid_probe_enable_superblocks:
  * @pr: probe
@@ -336,6 +552,7 @@ int blkid_superblocks_get_name(size_t idx, const char **name, int *usage)
  */
 static int superblocks_probe(blkid_probe pr, struct blkid_chain *chn)
 {
+	struct sb_magics_state *st;
 	size_t i;
 	int rc = BLKID_PROBE_NONE;
 
@@ -356,6 +573,9 @@ static int superblocks_probe(blkid_probe pr, struct blkid_chain *chn)
 	DBG(LOWPROBE, ul_debug("--> starting probing loop [SUBLKS idx=%d]",
 		chn->idx));
 
+	/* buffers may be modified (wiped) between calls, always scan again */
+	st = get_magics_state(chn);
+
 	i = chn->idx < 0 ? 0 : chn->idx + 1U;
 
 	for ( ; i < ARRAY_SIZE(idinfos); i++) {
@@ -392,7 +612,7 @@ static int superblocks_probe(blkid_probe pr, struct blkid_chain *chn)
 
 		DBG(LOWPROBE, ul_debug("[%zd] %s:", i, id->name));
 
-		rc = blkid_probe_get_idmag(pr, id, &off, &mag);
+		rc = superblocks_get_idmag(pr, st, i, &off, &mag);
 		if (rc < 0)
 			break;
 		if (rc != BLKID_PROBE_OK)
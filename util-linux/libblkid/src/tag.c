@@ -26,10 +26,26 @@ static blkid_tag blkid_new_tag(void)
 
 	INIT_LIST_HEAD(&tag->bit_tags);
 	INIT_LIST_HEAD(&tag->bit_names);
+	INIT_LIST_HEAD(&tag->bit_hval.hlist);
 
 	return tag;
 }
 
+static unsigned int tag_hash(const char *name, const char *value)
+{
+	return blkid_hash_string(blkid_hash_string(0, name), value);
+}
+
+/* add (or re-add after value change) tag to the cache NAME=value index */
+static void hash_tag(blkid_tag tag)
+{
+	blkid_cache cache = tag->bit_dev ? tag->bit_dev->bid_cache : NULL;
+
+	if (cache)
+		blkid_hash_add(&cache->bic_hvals, &tag->bit_hval,
+			       tag_hash(tag->bit_name, tag->bit_val));
+}
+
 void blkid_debug_dump_tag(blkid_tag tag)
 {
 	if (!tag) {
@@ -52,6 +68,10 @@ void blkid_free_tag(blkid_tag tag)
 	list_del(&tag->bit_tags);	/* list of tags for this device */
 	list_del(&tag->bit_names);	/* list of tags with this type */
 
+	if (tag->bit_dev && tag->bit_dev->bid_cache)
+		blkid_hash_del(&tag->bit_dev->bid_cache->bic_hvals,
+			       &tag->bit_hval);
+
 	free(tag->bit_name);
 	free(tag->bit_val);
 
@@ -157,6 +177,7 @@ int blkid_set_tag(blkid_dev dev, const char *name,
 		}
 		free(t->bit_val);
 		t->bit_val = val;
+		hash_tag(t);
 	} else {
 		/* Existing tag not present, add to device */
 		if (!(t = blkid_new_tag()))
@@ -164,6 +185,8 @@ int blkid_set_tag(blkid_dev dev, const char *name,
 		t->bit_name = strdup(name);
 		t->bit_val = val;
 		t->bit_dev = dev;
+		if (!t->bit_name)
+			goto errout;
 
 		list_add_tail(&t->bit_tags, &dev->bid_tags);
 
@@ -183,6 +206,7 @@ int blkid_set_tag(blkid_dev dev, const char *name,
 					      &dev->bid_cache->bic_tags);
 			}
 			list_add_tail(&t->bit_names, &head->bit_names);
+			hash_tag(t);
 		}
 	}
 
@@ -337,35 +361,37 @@ blkid_dev blkid_find_dev_with_tag(blkid_cache cache,
 					 const char *type,
 					 const char *value)
 {
-	blkid_tag	head;
 	blkid_dev	dev;
 	int		pri;
-	struct list_head *p;
+	struct list_head *p, *bucket;
+	unsigned int	hval;
 	int		probe_new = 0;
 
 	if (!cache || !type || !value)
 		return NULL;
 
 	blkid_read_cache(cache);
+	blkid_bincache_load_tag(cache, type, value);
 
 	DBG(TAG, ul_debug("looking for %s=%s in cache", type, value));
 
+	hval = tag_hash(type, value);
 try_again:
 	pri = -1;
 	dev = 0;
-	head = blkid_find_head_cache(cache, type);
-
-	if (head) {
-		list_for_each(p, &head->bit_names) {
-			blkid_tag tmp = list_entry(p, struct blkid_struct_tag,
-						   bit_names);
-
-			if (!strcmp(tmp->bit_val, value) &&
-			    (tmp->bit_dev->bid_pri > pri) &&
-			    !access(tmp->bit_dev->bid_name, F_OK)) {
-				dev = tmp->bit_dev;
-				pri = dev->bid_pri;
-			}
+	bucket = blkid_hash_bucket(&cache->bic_hvals, hval);
+
+	list_for_each(p, bucket) {
+		blkid_tag tmp = blkid_hash_entry(p, struct blkid_struct_tag,
+						 bit_hval);
+
+		if (tmp->bit_hval.hval == hval &&
+		    !strcmp(tmp->bit_val, value) &&
+		    !strcmp(tmp->bit_name, type) &&
+		    (tmp->bit_dev->bid_pri > pri) &&
+		    !access(tmp->bit_dev->bid_name, F_OK)) {
+			dev = tmp->bit_dev;
+			pri = dev->bid_pri;
 		}
 	}
 	if (dev && !(dev->bid_flags & BLKID_BID_FL_VERIFIED)) {
@@ -49,6 +49,130 @@ static void blkid_probe_to_tags(blkid_probe pr, blkid_dev dev)
 	}
 }
 
+static void reset_tags(blkid_dev dev)
+{
+	blkid_tag_iterate iter;
+	const char *type, *value;
+
+	iter = blkid_tag_iterate_begin(dev);
+	while (blkid_tag_next(iter, &type, &value) == 0)
+		blkid_set_tag(dev, type, NULL, 0);
+	blkid_tag_iterate_end(iter);
+}
+
+/*
+ * Probes @dev->bid_name by @pr and replaces @dev tags with the result. This
+ * function does not use the cache, so it's possible to call it for a
+ * standalone device (without bid_cache) from more threads, every thread with
+ * its own probe.
+ *
+ * Returns: 0 on success, 1 if nothing found, or -errno if the device cannot
+ * be opened.
+ */
+int blkid_probe_dev_tags(blkid_probe pr, blkid_dev dev)
+{
+	int fd, rc;
+
+	fd = open(dev->bid_name, O_RDONLY|O_CLOEXEC);
+	if (fd < 0) {
+		rc = -errno;
+		DBG(PROBE, ul_debug("blkid_verify: error %m (%d) while "
+					"opening %s", errno,
+					dev->bid_name));
+		return rc;
+	}
+
+	if (blkid_probe_set_device(pr, fd, 0, 0)) {
+		/* failed to read the device */
+		close(fd);
+		return 1;
+	}
+
+	/* remove old cache info */
+	reset_tags(dev);
+
+	/* enable superblocks probing */
+	blkid_probe_enable_superblocks(pr, TRUE);
+	blkid_probe_set_superblocks_flags(pr,
+		BLKID_SUBLKS_LABEL | BLKID_SUBLKS_UUID |
+		BLKID_SUBLKS_TYPE | BLKID_SUBLKS_SECTYPE);
+
+	/* enable partitions probing */
+	blkid_probe_enable_partitions(pr, TRUE);
+	blkid_probe_set_partitions_flags(pr, BLKID_PARTS_ENTRY_DETAILS);
+
+	/* probe */
+	rc = blkid_do_safeprobe(pr);
+	if (rc == 0)
+		blkid_probe_to_tags(pr, dev);
+	else
+		/* found nothing or error */
+		rc = 1;
+
+	blkid_reset_probe(pr);
+	blkid_probe_reset_superblocks_filter(pr);
+	close(fd);
+	return rc;
+}
+
+/*
+ * Copies result from blkid_probe_dev_tags() (see probe_all() in devname.c)
+ * to @dev. Returns the same as blkid_probe_dev_tags().
+ */
+static int use_prefetch(struct blkid_prefetch *pf, blkid_dev dev)
+{
+	struct list_head *p;
+
+	DBG(PROBE, ul_debug("%s: using prefetched result [rc=%d]",
+				dev->bid_name, pf->rc));
+	if (pf->rc != 0)
+		return pf->rc;
+
+	reset_tags(dev);
+
+	list_for_each(p, &pf->dev->bid_tags) {
+		blkid_tag tag = list_entry(p, struct blkid_struct_tag, bit_tags);
+
+		if (blkid_set_tag(dev, tag->bit_name, tag->bit_val,
+				  strlen(tag->bit_val)) < 0)
+			return 1;
+	}
+	return 0;
+}
+
+static int is_uptodate(blkid_dev dev, struct stat *st, time_t now)
+{
+	time_t diff = now - dev->bid_time;
+
+	return now >= dev->bid_time &&
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+	    (st->st_mtime < dev->bid_time ||
+	        (st->st_mtime == dev->bid_time &&
+		 st->st_mtim.tv_nsec / 1000 <= dev->bid_utime)) &&
+#else
+	    st->st_mtime <= dev->bid_time &&
+#endif
+	    (diff < BLKID_PROBE_MIN ||
+		(dev->bid_flags & BLKID_BID_FL_VERIFIED &&
+		 diff < BLKID_PROBE_INTERVAL));
+}
+
+/*
+ * Returns 1 if blkid_verify() is going to probe the device.
+ */
+int blkid_verify_needs_probe(blkid_dev dev)
+{
+	struct stat st;
+
+	if (!dev || stat(dev->bid_name, &st) < 0)
+		return 0;
+	if (is_uptodate(dev, &st, time(0)))
+		return 0;
+	if (sysfs_devno_is_lvm_private(st.st_rdev))
+		return 0;
+	return 1;
+}
+
 /*
  * Verify that the data in dev is consistent with what is on the actual
  * block device (using the devname field only).  Normally this will be
@@ -60,11 +184,10 @@ static void blkid_probe_to_tags(blkid_probe pr, blkid_dev dev)
  */
 blkid_dev blkid_verify(blkid_cache cache, blkid_dev dev)
 {
-	blkid_tag_iterate iter;
-	const char *type, *value;
+	struct blkid_prefetch *pf;
 	struct stat st;
 	time_t diff, now;
-	int fd;
+	int rc;
 
 	if (!dev || !cache)
 		return NULL;
@@ -87,17 +210,7 @@ blkid_dev blkid_verify(blkid_cache cache, blkid_dev dev)
 		return NULL;
 	}
 
-	if (now >= dev->bid_time &&
-#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
-	    (st.st_mtime < dev->bid_time ||
-	        (st.st_mtime == dev->bid_time &&
-		 st.st_mtim.tv_nsec / 1000 <= dev->bid_utime)) &&
-#else
-	    st.st_mtime <= dev->bid_time &&
-#endif
-	    (diff < BLKID_PROBE_MIN ||
-		(dev->bid_flags & BLKID_BID_FL_VERIFIED &&
-		 diff < BLKID_PROBE_INTERVAL)))
+	if (is_uptodate(dev, &st, now))
 		return dev;
 
 #ifndef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
@@ -126,67 +239,40 @@ blkid_dev blkid_verify(blkid_cache cache, blkid_dev dev)
 		}
 	}
 
-	fd = open(dev->bid_name, O_RDONLY|O_CLOEXEC);
-	if (fd < 0) {
-		DBG(PROBE, ul_debug("blkid_verify: error %m (%d) while "
-					"opening %s", errno,
-					dev->bid_name));
-		goto open_err;
-	}
+	pf = cache->bic_prefetch;
+	if (pf && pf->dev && strcmp(pf->dev->bid_name, dev->bid_name) == 0)
+		rc = use_prefetch(pf, dev);
+	else
+		rc = blkid_probe_dev_tags(cache->probe, dev);
 
-	if (blkid_probe_set_device(cache->probe, fd, 0, 0)) {
-		/* failed to read the device */
-		close(fd);
-		blkid_free_dev(dev);
-		return NULL;
+	if (rc < 0) {
+		errno = -rc;
+		goto open_err;
 	}
-
-	/* remove old cache info */
-	iter = blkid_tag_iterate_begin(dev);
-	while (blkid_tag_next(iter, &type, &value) == 0)
-		blkid_set_tag(dev, type, NULL, 0);
-	blkid_tag_iterate_end(iter);
-
-	/* enable superblocks probing */
-	blkid_probe_enable_superblocks(cache->probe, TRUE);
-	blkid_probe_set_superblocks_flags(cache->probe,
-		BLKID_SUBLKS_LABEL | BLKID_SUBLKS_UUID |
-		BLKID_SUBLKS_TYPE | BLKID_SUBLKS_SECTYPE);
-
-	/* enable partitions probing */
-	blkid_probe_enable_partitions(cache->probe, TRUE);
-	blkid_probe_set_partitions_flags(cache->probe, BLKID_PARTS_ENTRY_DETAILS);
-
-	/* probe */
-	if (blkid_do_safeprobe(cache->probe)) {
+	if (rc) {
 		/* found nothing or error */
 		blkid_free_dev(dev);
-		dev = NULL;
+		return NULL;
 	}
 
-	if (dev) {
 #ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+	{
 		struct timeval tv;
 		if (!gettimeofday(&tv, NULL)) {
 			dev->bid_time = tv.tv_sec;
 			dev->bid_utime = tv.tv_usec;
 		} else
-#endif
 			dev->bid_time = time(0);
-
-		dev->bid_devno = st.st_rdev;
-		dev->bid_flags |= BLKID_BID_FL_VERIFIED;
-		cache->bic_flags |= BLKID_BIC_FL_CHANGED;
-
-		blkid_probe_to_tags(cache->probe, dev);
-
-		DBG(PROBE, ul_debug("%s: devno 0x%04llx, type %s",
-			   dev->bid_name, (long long)st.st_rdev, dev->bid_type));
 	}
+#else
+	dev->bid_time = time(0);
+#endif
+	blkid_dev_set_devno(dev, st.st_rdev);
+	dev->bid_flags |= BLKID_BID_FL_VERIFIED;
+	cache->bic_flags |= BLKID_BIC_FL_CHANGED;
 
-	blkid_reset_probe(cache->probe);
-	blkid_probe_reset_superblocks_filter(cache->probe);
-	close(fd);
+	DBG(PROBE, ul_debug("%s: devno 0x%04llx, type %s",
+		   dev->bid_name, (long long)st.st_rdev, dev->bid_type));
 	return dev;
 }
 
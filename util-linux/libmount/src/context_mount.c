@@ -207,6 +207,13 @@ static int fix_optstr(struct libmnt_context *cxt)
 
 	fs = cxt->fs;
 
+	/* the options are modified in-place below */
+	rc = __mnt_fs_own_str(fs, &fs->vfs_optstr);
+	if (!rc)
+		rc = __mnt_fs_own_str(fs, &fs->fs_optstr);
+	if (rc)
+		goto done;
+
 	/*
 	 * The "user" options is our business (so we can modify the option),
 	 * the exception is command line for /sbin/mount.<type> helpers. Let's
@@ -241,7 +248,7 @@ static int fix_optstr(struct libmnt_context *cxt)
 		goto done;
 
 	if (fs->vfs_optstr && *fs->vfs_optstr == '\0') {
-		free(fs->vfs_optstr);
+		__mnt_fs_free_str(fs, fs->vfs_optstr);
 		fs->vfs_optstr = NULL;
 	}
 	if (fs->user_optstr && *fs->user_optstr == '\0') {
@@ -333,7 +340,7 @@ static int fix_optstr(struct libmnt_context *cxt)
 		rc = mnt_optstr_fix_user(&fs->user_optstr);
 
 	/* refresh merged optstr */
-	free(fs->optstr);
+	__mnt_fs_free_str(fs, fs->optstr);
 	fs->optstr = NULL;
 	fs->optstr = mnt_fs_strdup_options(fs);
 done:
@@ -73,28 +73,90 @@ void mnt_reset_fs(struct libmnt_fs *fs)
 
 	ref = fs->refcount;
 
+	if (fs->tab)
+		mnt_table_drop_index(fs->tab);
 	list_del(&fs->ents);
-	free(fs->source);
+	__mnt_fs_free_str(fs, fs->source);
 	free(fs->bindsrc);
-	free(fs->tagname);
-	free(fs->tagval);
-	free(fs->root);
+	__mnt_fs_free_str(fs, fs->tagname);
+	__mnt_fs_free_str(fs, fs->tagval);
+	__mnt_fs_free_str(fs, fs->root);
 	free(fs->swaptype);
-	free(fs->target);
-	free(fs->fstype);
-	free(fs->optstr);
-	free(fs->vfs_optstr);
-	free(fs->fs_optstr);
+	__mnt_fs_free_str(fs, fs->target);
+	__mnt_fs_free_str(fs, fs->fstype);
+	__mnt_fs_free_str(fs, fs->optstr);
+	__mnt_fs_free_str(fs, fs->vfs_optstr);
+	__mnt_fs_free_str(fs, fs->fs_optstr);
 	free(fs->user_optstr);
 	free(fs->attrs);
-	free(fs->opt_fields);
+	__mnt_fs_free_str(fs, fs->opt_fields);
 	free(fs->comment);
+	mnt_unref_strbuf(fs->strbuf);
 
 	memset(fs, 0, sizeof(*fs));
 	INIT_LIST_HEAD(&fs->ents);
 	fs->refcount = ref;
 }
 
+/*
+ * Allocates a shared strings buffer (see struct libmnt_strbuf), the
+ * reference counter is 1.
+ */
+struct libmnt_strbuf *mnt_new_strbuf(size_t size)
+{
+	struct libmnt_strbuf *sb = malloc(sizeof(*sb) + size);
+
+	if (!sb)
+		return NULL;
+	sb->refcount = 1;
+	sb->size = size;
+	return sb;
+}
+
+void mnt_ref_strbuf(struct libmnt_strbuf *sb)
+{
+	if (sb)
+		sb->refcount++;
+}
+
+void mnt_unref_strbuf(struct libmnt_strbuf *sb)
+{
+	if (sb && --sb->refcount <= 0)
+		free(sb);
+}
+
+static inline int is_strbuf_str(struct libmnt_fs *fs, const char *str)
+{
+	return fs->strbuf && str >= fs->strbuf->data
+			  && str < fs->strbuf->data + fs->strbuf->size;
+}
+
+/*
+ * Deallocates @str unless it's from the shared strings buffer.
+ */
+void __mnt_fs_free_str(struct libmnt_fs *fs, char *str)
+{
+	if (!is_strbuf_str(fs, str))
+		free(str);
+}
+
+/*
+ * Makes a private copy of the string from the shared strings buffer; it's
+ * necessary before any in-place modification of the string.
+ */
+int __mnt_fs_own_str(struct libmnt_fs *fs, char **str)
+{
+	char *p;
+
+	if (!*str || !is_strbuf_str(fs, *str))
+		return 0;
+	p = strdup(*str);
+	if (!p)
+		return -ENOMEM;
+	*str = p;
+	return 0;
+}
+
 /**
  * mnt_ref_fs:
  * @fs: fs pointer
@@ -192,6 +254,11 @@ struct libmnt_fs *mnt_copy_fs(struct libmnt_fs *dest,
 	dest->devno      = src->devno;
 	dest->tid        = src->tid;
 
+	/* the copy is never linked to the table of @src, but @dest may be
+	 * linked to a table indexed by the fields */
+	if (dest->tab)
+		mnt_table_drop_index(dest->tab);
+
 	if (cpy_str_at_offset(dest, src, offsetof(struct libmnt_fs, source)))
 		goto err;
 	if (cpy_str_at_offset(dest, src, offsetof(struct libmnt_fs, tagname)))
@@ -377,10 +444,10 @@ int __mnt_fs_set_source_ptr(struct libmnt_fs *fs, char *source)
 	}
 
 	if (fs->source != source)
-		free(fs->source);
+		__mnt_fs_free_str(fs, fs->source);
 
-	free(fs->tagname);
-	free(fs->tagval);
+	__mnt_fs_free_str(fs, fs->tagname);
+	__mnt_fs_free_str(fs, fs->tagval);
 
 	fs->source = source;
 	fs->tagname = t;
@@ -535,9 +602,11 @@ int mnt_fs_set_target(struct libmnt_fs *fs, const char *target)
 		if (!p)
 			return -ENOMEM;
 	}
-	free(fs->target);
+	__mnt_fs_free_str(fs, fs->target);
 	fs->target = p;
 
+	if (fs->tab)
+		mnt_table_drop_index(fs->tab);	/* indexed by target */
 	return 0;
 }
 
@@ -642,7 +711,7 @@ int __mnt_fs_set_fstype_ptr(struct libmnt_fs *fs, char *fstype)
 	assert(fs);
 
 	if (fstype != fs->fstype)
-		free(fs->fstype);
+		__mnt_fs_free_str(fs, fs->fstype);
 
 	fs->fstype = fstype;
 	fs->flags &= ~MNT_FS_PSEUDO;
@@ -822,10 +891,10 @@ int mnt_fs_set_options(struct libmnt_fs *fs, const char *optstr)
 		}
 	}
 
-	free(fs->fs_optstr);
-	free(fs->vfs_optstr);
+	__mnt_fs_free_str(fs, fs->fs_optstr);
+	__mnt_fs_free_str(fs, fs->vfs_optstr);
 	free(fs->user_optstr);
-	free(fs->optstr);
+	__mnt_fs_free_str(fs, fs->optstr);
 
 	fs->fs_optstr = f;
 	fs->vfs_optstr = v;
@@ -861,6 +930,11 @@ int mnt_fs_append_options(struct libmnt_fs *fs, const char *optstr)
 	if (rc)
 		return rc;
 
+	if ((v && __mnt_fs_own_str(fs, &fs->vfs_optstr))
+	    || (f && __mnt_fs_own_str(fs, &fs->fs_optstr))
+	    || __mnt_fs_own_str(fs, &fs->optstr))
+		rc = -ENOMEM;
+
 	if (!rc && v)
 		rc = mnt_optstr_append_option(&fs->vfs_optstr, v, NULL);
 	if (!rc && f)
@@ -903,6 +977,11 @@ int mnt_fs_prepend_options(struct libmnt_fs *fs, const char *optstr)
 	if (rc)
 		return rc;
 
+	if ((v && __mnt_fs_own_str(fs, &fs->vfs_optstr))
+	    || (f && __mnt_fs_own_str(fs, &fs->fs_optstr))
+	    || __mnt_fs_own_str(fs, &fs->optstr))
+		rc = -ENOMEM;
+
 	if (!rc && v)
 		rc = mnt_optstr_prepend_option(&fs->vfs_optstr, v, NULL);
 	if (!rc && f)
@@ -1113,7 +1192,7 @@ int mnt_fs_set_root(struct libmnt_fs *fs, const char *root)
 		if (!p)
 			return -ENOMEM;
 	}
-	free(fs->root);
+	__mnt_fs_free_str(fs, fs->root);
 	fs->root = p;
 	return 0;
 }
@@ -143,6 +143,17 @@ struct libmnt_iter {
 	} while(0)
 
 
+/*
+ * Shared buffer for strings of more filesystems, the mountinfo parser slices
+ * the file content to the fields (see mnt_table_parse_file()). The strings
+ * from the buffer must not be modified or deallocated.
+ */
+struct libmnt_strbuf {
+	int		refcount;	/* number of filesystems using the buffer */
+	size_t		size;		/* size of data[] */
+	char		data[];
+};
+
 /*
  * This struct represents one entry in a mtab/fstab/mountinfo file.
  * (note that fstab[1] means the first column from fstab, and so on...)
@@ -187,6 +198,9 @@ struct libmnt_fs {
 
 	char		*comment;	/* fstab comment */
 
+	struct libmnt_table *tab;	/* table the fs is linked to or NULL */
+	struct libmnt_strbuf *strbuf;	/* shared strings or NULL */
+
 	void		*userdata;	/* library independent data */
 };
 
@@ -203,6 +217,32 @@ struct libmnt_fs {
 				   || mnt_fs_is_netfs(_f) \
 				   || mnt_fs_is_swaparea(_f)))
 
+/*
+ * Mountinfo entry position in the tree (see struct libmnt_tabidx)
+ */
+struct libmnt_tabidx_child {
+	int		parent;		/* parent ID */
+	int		id;		/* mount ID */
+	size_t		pos;		/* index to libmnt_tabidx->ents[] */
+};
+
+/*
+ * Lookup index for the table entries. The index is built on demand by the
+ * lookup functions and dropped when the table or an indexed field of any
+ * entry is modified (see tab.c).
+ */
+struct libmnt_tabidx {
+	struct libmnt_fs	**ents;		/* entries in the table order */
+	size_t			nents;		/* number of entries */
+
+	struct libmnt_tabidx_child *children; /* sorted by parent ID, ID and pos */
+	struct libmnt_fs	*root;		/* the root mountinfo entry or NULL */
+
+	size_t			*targets;	/* hash of targets, ents[] index + 1 or 0 */
+	size_t			*devnos;	/* hash of devnos, ents[] index + 1 or 0 */
+	size_t			nbuckets;	/* size of the hashes (power of 2) */
+};
+
 /*
  * mtab/fstab/mountinfo file
  */
@@ -224,10 +264,19 @@ struct libmnt_table {
 
 
 	struct list_head	ents;	/* list of entries (libmnt_fs) */
+	struct libmnt_tabidx	*idx;	/* lookup index or NULL */
 	void		*userdata;
 };
 
 extern struct libmnt_table *__mnt_new_table_from_file(const char *filename, int fmt);
+extern void mnt_table_drop_index(struct libmnt_table *tb);
+extern size_t mnt_hash_target(const char *path);
+extern struct libmnt_strbuf *mnt_read_strbuf(const char *filename, size_t *len);
+extern int mnt_table_parse_mountinfo_line(struct libmnt_table *tb,
+					struct libmnt_fs *fs,
+					const char *line, size_t len,
+					const char *filename, size_t lineno,
+					pid_t *tid);
 
 /*
  * Tab file format
@@ -364,6 +413,13 @@ extern int __mnt_fs_set_source_ptr(struct libmnt_fs *fs, char *source)
 			__attribute__((nonnull(1)));
 extern int __mnt_fs_set_fstype_ptr(struct libmnt_fs *fs, char *fstype)
 			__attribute__((nonnull(1)));
+extern struct libmnt_strbuf *mnt_new_strbuf(size_t size);
+extern void mnt_ref_strbuf(struct libmnt_strbuf *sb);
+extern void mnt_unref_strbuf(struct libmnt_strbuf *sb);
+extern void __mnt_fs_free_str(struct libmnt_fs *fs, char *str)
+			__attribute__((nonnull(1)));
+extern int __mnt_fs_own_str(struct libmnt_fs *fs, char **str)
+			__attribute__((nonnull));
 
 /* context.c */
 extern int mnt_context_mtab_writable(struct libmnt_context *cxt);
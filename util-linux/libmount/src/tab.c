@@ -161,6 +161,7 @@ void mnt_free_table(struct libmnt_table *tb)
 		return;
 
 	mnt_reset_table(tb);
+	mnt_table_drop_index(tb);
 	DBG(TAB, ul_debugobj(tb, "free [refcount=%d]", tb->refcount));
 
 	mnt_unref_cache(tb->cache);
@@ -429,7 +430,9 @@ int mnt_table_add_fs(struct libmnt_table *tb, struct libmnt_fs *fs)
 
 	mnt_ref_fs(fs);
 	list_add_tail(&fs->ents, &tb->ents);
+	fs->tab = tb;
 	tb->nents++;
+	mnt_table_drop_index(tb);
 
 	DBG(TAB, ul_debugobj(tb, "add entry: %s %s",
 			mnt_fs_get_source(fs), mnt_fs_get_target(fs)));
@@ -454,12 +457,205 @@ int mnt_table_remove_fs(struct libmnt_table *tb, struct libmnt_fs *fs)
 
 	list_del(&fs->ents);
 	INIT_LIST_HEAD(&fs->ents);	/* otherwise FS still points to the list */
+	fs->tab = NULL;
+	mnt_table_drop_index(tb);
 
 	mnt_unref_fs(fs);
 	tb->nents--;
 	return 0;
 }
 
+/*
+ * Lookup index
+ *
+ * The lookup functions below walk the list of the entries. It's quadratic for
+ * tree walks (e.g. findmnt) on systems with many mountpoints. The index is
+ * built by the first lookup and kept until the table is modified.
+ */
+#define MNT_TABIDX_MINENTS	16	/* don't index small tables */
+
+void mnt_table_drop_index(struct libmnt_table *tb)
+{
+	struct libmnt_tabidx *idx = tb ? tb->idx : NULL;
+
+	if (!idx)
+		return;
+
+	free(idx->ents);
+	free(idx->children);
+	free(idx->targets);
+	free(idx->devnos);
+	free(idx);
+	tb->idx = NULL;
+}
+
+/* ignores the trailing slash like mnt_fs_streq_target() */
+size_t mnt_hash_target(const char *path)
+{
+	size_t len = strlen(path), hv = 5381, i;
+
+	if (len && path[len - 1] == '/')
+		len--;
+	for (i = 0; i < len; i++)
+		hv = hv * 33 + (unsigned char) path[i];
+	return hv;
+}
+
+static size_t tabidx_hash_devno(dev_t devno)
+{
+	uint64_t hv = (uint64_t) devno * 0x9E3779B97F4A7C15ULL;
+
+	return (size_t) (hv ^ (hv >> 32));
+}
+
+static void tabidx_hash_add(struct libmnt_tabidx *idx, size_t *hash,
+			    size_t hv, size_t pos)
+{
+	size_t mask = idx->nbuckets - 1;
+
+	for (hv &= mask; hash[hv]; hv = (hv + 1) & mask)
+		;
+	hash[hv] = pos + 1;
+}
+
+static int tabidx_cmp_children(const void *a, const void *b)
+{
+	const struct libmnt_tabidx_child *x = a, *y = b;
+
+	if (x->parent != y->parent)
+		return x->parent < y->parent ? -1 : 1;
+	if (x->id != y->id)
+		return x->id < y->id ? -1 : 1;
+	return x->pos < y->pos ? -1 : x->pos > y->pos;
+}
+
+/*
+ * Returns the index or NULL if the table is too small or on ENOMEM; the
+ * callers fallback to the list walk in this case.
+ */
+static struct libmnt_tabidx *get_index(struct libmnt_table *tb)
+{
+	struct libmnt_tabidx *idx;
+	struct list_head *p;
+	size_t n = 0, i;
+	int mountinfo;
+
+	if (tb->idx)
+		return tb->idx;
+
+	list_for_each(p, &tb->ents)
+		n++;
+	if (n < MNT_TABIDX_MINENTS)
+		return NULL;
+
+	idx = calloc(1, sizeof(*idx));
+	if (!idx)
+		return NULL;
+
+	mountinfo = is_mountinfo(tb);
+	idx->nents = n;
+	for (idx->nbuckets = 1; idx->nbuckets < n * 2; idx->nbuckets <<= 1)
+		;
+
+	idx->ents = malloc(n * sizeof(struct libmnt_fs *));
+	idx->targets = calloc(idx->nbuckets, sizeof(size_t));
+	idx->devnos = calloc(idx->nbuckets, sizeof(size_t));
+	if (mountinfo)
+		idx->children = malloc(n * sizeof(struct libmnt_tabidx_child));
+	if (!idx->ents || !idx->targets || !idx->devnos
+	    || (mountinfo && !idx->children))
+		goto err;
+
+	i = 0;
+	list_for_each(p, &tb->ents) {
+		struct libmnt_fs *fs = list_entry(p, struct libmnt_fs, ents);
+
+		idx->ents[i] = fs;
+		if (fs->target)
+			tabidx_hash_add(idx, idx->targets,
+					mnt_hash_target(fs->target), i);
+		tabidx_hash_add(idx, idx->devnos,
+					tabidx_hash_devno(fs->devno), i);
+		if (mountinfo) {
+			idx->children[i].parent = fs->parent;
+			idx->children[i].id = fs->id;
+			idx->children[i].pos = i;
+
+			/* see mnt_table_get_root_fs() */
+			if (!idx->root || fs->parent < idx->root->parent)
+				idx->root = fs;
+		}
+		i++;
+	}
+
+	if (mountinfo)
+		qsort(idx->children, n, sizeof(struct libmnt_tabidx_child),
+				tabidx_cmp_children);
+
+	DBG(TAB, ul_debugobj(tb, "index: %zu entries, %zu buckets",
+				n, idx->nbuckets));
+	tb->idx = idx;
+	return idx;
+err:
+	tb->idx = idx;
+	mnt_table_drop_index(tb);
+	return NULL;
+}
+
+/* returns the first entry from the hash chain in the @direction order */
+static struct libmnt_fs *tabidx_find(struct libmnt_tabidx *idx, size_t *hash,
+			size_t hv, int direction,
+			int (*match)(struct libmnt_fs *, const void *),
+			const void *data)
+{
+	size_t mask = idx->nbuckets - 1, res = 0;
+
+	for (hv &= mask; hash[hv]; hv = (hv + 1) & mask) {
+		size_t pos = hash[hv];
+
+		if (!match(idx->ents[pos - 1], data))
+			continue;
+		if (!res || (direction == MNT_ITER_FORWARD ? pos < res : pos > res))
+			res = pos;
+	}
+	return res ? idx->ents[res - 1] : NULL;
+}
+
+static int tabidx_match_target(struct libmnt_fs *fs, const void *data)
+{
+	return mnt_fs_streq_target(fs, (const char *) data);
+}
+
+static int tabidx_match_devno(struct libmnt_fs *fs, const void *data)
+{
+	return fs->devno == *((const dev_t *) data);
+}
+
+/* returns the first child of @parent_id with ID greater than @last_id */
+static struct libmnt_fs *tabidx_next_child(struct libmnt_tabidx *idx,
+			int parent_id, int last_id)
+{
+	size_t lo = 0, hi = idx->nents;
+
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+		struct libmnt_tabidx_child *c = &idx->children[mid];
+
+		if (c->parent < parent_id
+		    || (c->parent == parent_id && last_id && c->id <= last_id))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for ( ; lo < idx->nents && idx->children[lo].parent == parent_id; lo++) {
+		/* rootfs could be its own parent, see mnt_table_next_child_fs() */
+		if (idx->children[lo].id != parent_id)
+			return idx->ents[idx->children[lo].pos];
+	}
+	return NULL;
+}
+
 /**
  * mnt_table_get_root_fs:
  * @tb: mountinfo file (/proc/self/mountinfo)
@@ -481,6 +677,7 @@ int mnt_table_remove_fs(struct libmnt_table *tb, struct libmnt_fs *fs)
 int mnt_table_get_root_fs(struct libmnt_table *tb, struct libmnt_fs **root)
 {
 	struct libmnt_iter itr;
+	struct libmnt_tabidx *idx;
 	struct libmnt_fs *fs;
 	int root_id = 0;
 
@@ -491,6 +688,12 @@ int mnt_table_get_root_fs(struct libmnt_table *tb, struct libmnt_fs **root)
 
 	*root = NULL;
 
+	idx = get_index(tb);
+	if (idx) {
+		*root = idx->root;
+		return *root ? 0 : -EINVAL;
+	}
+
 	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
 	while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
 		int id = mnt_fs_get_parent_id(fs);
@@ -519,6 +722,7 @@ int mnt_table_get_root_fs(struct libmnt_table *tb, struct libmnt_fs **root)
 int mnt_table_next_child_fs(struct libmnt_table *tb, struct libmnt_iter *itr,
 			struct libmnt_fs *parent, struct libmnt_fs **chld)
 {
+	struct libmnt_tabidx *idx;
 	struct libmnt_fs *fs;
 	int parent_id, lastchld_id = 0, chld_id = 0;
 
@@ -538,6 +742,12 @@ int mnt_table_next_child_fs(struct libmnt_table *tb, struct libmnt_iter *itr,
 
 	*chld = NULL;
 
+	idx = get_index(tb);
+	if (idx) {
+		*chld = tabidx_next_child(idx, parent_id, lastchld_id);
+		goto done;
+	}
+
 	mnt_reset_iter(itr, MNT_ITER_FORWARD);
 	while(mnt_table_next_fs(tb, itr, &fs) == 0) {
 		int id;
@@ -558,7 +768,7 @@ int mnt_table_next_child_fs(struct libmnt_table *tb, struct libmnt_iter *itr,
 			chld_id = id;
 		}
 	}
-
+done:
 	if (!*chld)
 		return 1;	/* end of iterator */
 
@@ -689,6 +899,7 @@ static int mnt_table_move_parent(struct libmnt_table *tb, int oldid, int newid)
 		return 0;
 
 	DBG(TAB, ul_debugobj(tb, "moving parent ID from %d -> %d", oldid, newid));
+	mnt_table_drop_index(tb);
 	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
 
 	while (mnt_table_next_fs(tb, &itr, &fs) == 0) {
@@ -851,6 +1062,7 @@ struct libmnt_fs *mnt_table_find_mountpoint(struct libmnt_table *tb,
 struct libmnt_fs *mnt_table_find_target(struct libmnt_table *tb, const char *path, int direction)
 {
 	struct libmnt_iter itr;
+	struct libmnt_tabidx *idx;
 	struct libmnt_fs *fs = NULL;
 	char *cn;
 
@@ -861,11 +1073,20 @@ struct libmnt_fs *mnt_table_find_target(struct libmnt_table *tb, const char *pat
 
 	DBG(TAB, ul_debugobj(tb, "lookup TARGET: '%s'", path));
 
+	idx = get_index(tb);
+
 	/* native @target */
-	mnt_reset_iter(&itr, direction);
-	while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
-		if (mnt_fs_streq_target(fs, path))
+	if (idx) {
+		fs = tabidx_find(idx, idx->targets, mnt_hash_target(path),
+				direction, tabidx_match_target, path);
+		if (fs)
 			return fs;
+	} else {
+		mnt_reset_iter(&itr, direction);
+		while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
+			if (mnt_fs_streq_target(fs, path))
+				return fs;
+		}
 	}
 	if (!tb->cache || !(cn = mnt_resolve_path(path, tb->cache)))
 		return NULL;
@@ -873,10 +1094,17 @@ struct libmnt_fs *mnt_table_find_target(struct libmnt_table *tb, const char *pat
 	DBG(TAB, ul_debugobj(tb, "lookup canonical TARGET: '%s'", cn));
 
 	/* canonicalized paths in struct libmnt_table */
-	mnt_reset_iter(&itr, direction);
-	while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
-		if (mnt_fs_streq_target(fs, cn))
+	if (idx) {
+		fs = tabidx_find(idx, idx->targets, mnt_hash_target(cn),
+				direction, tabidx_match_target, cn);
+		if (fs)
 			return fs;
+	} else {
+		mnt_reset_iter(&itr, direction);
+		while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
+			if (mnt_fs_streq_target(fs, cn))
+				return fs;
+		}
 	}
 
 	/* non-canonicaled path in struct libmnt_table
@@ -1146,6 +1374,7 @@ struct libmnt_fs *mnt_table_find_devno(struct libmnt_table *tb,
 				       dev_t devno, int direction)
 {
 	struct libmnt_fs *fs = NULL;
+	struct libmnt_tabidx *idx;
 	struct libmnt_iter itr;
 
 	if (!tb)
@@ -1155,6 +1384,11 @@ struct libmnt_fs *mnt_table_find_devno(struct libmnt_table *tb,
 
 	DBG(TAB, ul_debugobj(tb, "lookup DEVNO: %d", (int) devno));
 
+	idx = get_index(tb);
+	if (idx)
+		return tabidx_find(idx, idx->devnos, tabidx_hash_devno(devno),
+				direction, tabidx_match_devno, &devno);
+
 	mnt_reset_iter(&itr, direction);
 
 	while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
@@ -1451,6 +1685,7 @@ done:
 }
 
 #ifdef TEST_PROGRAM
+#include <sys/time.h>
 #include "pathnames.h"
 
 static int parser_errcb(struct libmnt_table *tb, const char *filename, int line)
@@ -1741,6 +1976,121 @@ done:
 	return rc;
 }
 
+static double bench_time(struct timeval *a)
+{
+	struct timeval b;
+
+	gettimeofday(&b, NULL);
+	return (b.tv_sec - a->tv_sec) * 1000.0 + (b.tv_usec - a->tv_usec) / 1000.0;
+}
+
+static size_t bench_walk(struct libmnt_table *tb, struct libmnt_fs *fs)
+{
+	struct libmnt_iter *itr = mnt_new_iter(MNT_ITER_FORWARD);
+	struct libmnt_fs *chld;
+	size_t n = 1;
+
+	if (!itr)
+		return 0;
+	while (mnt_table_next_child_fs(tb, itr, fs, &chld) == 0)
+		n += bench_walk(tb, chld);
+	mnt_free_iter(itr);
+	return n;
+}
+
+/* synthetic mountinfo, every mountpoint has up to 8 submounts */
+static int test_bench_tree(struct libmnt_test *ts, int argc, char *argv[])
+{
+	struct libmnt_table *tb = NULL;
+	struct libmnt_fs *fs;
+	struct timeval start;
+	int i, n, fd, rc = -1;
+	size_t found = 0;
+	FILE *f = NULL;
+	char **targets;
+	char path[] = "/tmp/libmount-bench-XXXXXX.mountinfo";
+
+	n = argc == 2 ? atoi(argv[1]) : 50000;
+	if (n < 1)
+		return -EINVAL;
+
+	targets = calloc(n, sizeof(char *));
+	fd = mkstemps(path, sizeof(".mountinfo") - 1);
+	if (fd >= 0)
+		f = fdopen(fd, "w+" UL_CLOEXECSTR);
+	if (!targets || !f)
+		goto done;
+
+	for (i = 0; i < n; i++) {
+		if (i == 0)
+			targets[i] = strdup("/");
+		else if (asprintf(&targets[i], "%s/d%d",
+				  i <= 8 ? "" : targets[(i - 1) / 8], i) < 0)
+			targets[i] = NULL;
+		if (!targets[i])
+			goto done;
+		fprintf(f, "%d %d 0:%d / %s rw,relatime shared:%d - tmpfs tmpfs rw\n",
+			i + 20, i ? (i - 1) / 8 + 20 : 1, i + 20, targets[i], i + 1);
+	}
+	rewind(f);
+
+	tb = mnt_new_table();
+	if (!tb)
+		goto done;
+
+	gettimeofday(&start, NULL);
+	if (mnt_table_parse_stream(tb, f, "synthetic") != 0)
+		goto done;
+	printf("parse:       %10.3f ms (%d entries)\n", bench_time(&start),
+			mnt_table_get_nents(tb));
+
+	/* mountinfo is parsed in one buffer by mnt_table_parse_file() */
+	mnt_unref_table(tb);
+	tb = mnt_new_table();
+	if (!tb)
+		goto done;
+	fflush(f);
+
+	gettimeofday(&start, NULL);
+	if (mnt_table_parse_file(tb, path) != 0)
+		goto done;
+	printf("parse file:  %10.3f ms (%d entries)\n", bench_time(&start),
+			mnt_table_get_nents(tb));
+
+	gettimeofday(&start, NULL);
+	if (mnt_table_get_root_fs(tb, &fs) != 0)
+		goto done;
+	found = bench_walk(tb, fs);
+	printf("tree walk:   %10.3f ms (%zu entries)\n", bench_time(&start), found);
+
+	gettimeofday(&start, NULL);
+	for (found = 0, i = 0; i < n; i++) {
+		if (mnt_table_find_target(tb, targets[i], MNT_ITER_BACKWARD))
+			found++;
+	}
+	printf("find target: %10.3f ms (%zu found)\n", bench_time(&start), found);
+
+	gettimeofday(&start, NULL);
+	for (found = 0, i = 0; i < n; i++) {
+		if (mnt_table_find_devno(tb, makedev(0, i + 20), MNT_ITER_BACKWARD))
+			found++;
+	}
+	printf("find devno:  %10.3f ms (%zu found)\n", bench_time(&start), found);
+
+	rc = found == (size_t) n ? 0 : -1;
+done:
+	if (targets) {
+		for (i = 0; i < n; i++)
+			free(targets[i]);
+		free(targets);
+	}
+	if (f)
+		fclose(f);
+	if (fd >= 0)
+		unlink(path);
+	mnt_unref_table(tb);
+	return rc;
+}
 
 int main(int argc, char *argv[])
 {
@@ -1753,6 +2103,7 @@ int main(int argc, char *argv[])
 	{ "--find-mountpoint", test_find_mountpoint, "<path>" },
 	{ "--copy-fs",       test_copy_fs, "<file>  copy root FS from the file" },
 	{ "--is-mounted",    test_is_mounted, "<fstab> check what from <file> are already mounted" },
+	{ "--bench-tree",    test_bench_tree, "[<nents>] walk and search in synthetic mountinfo" },
 	{ NULL }
 	};
 
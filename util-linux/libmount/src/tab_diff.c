@@ -11,6 +11,7 @@
  * @short_description: compare changes in the list of the mounted filesystems
  */
 #include "mountP.h"
+#include "strutils.h"
 
 struct tabdiff_entry {
 	int	oper;			/* MNT_TABDIFF_* flags; */
@@ -21,11 +22,51 @@ struct tabdiff_entry {
 	struct list_head changes;
 };
 
+/*
+ * Open-addressing hash used by mnt_diff_tables(), the slots are reused
+ * for all diffs.
+ */
+struct tabdiff_hash {
+	void		**data;		/* struct libmnt_fs or struct tabdiff_entry */
+	size_t		*hvals;		/* hash values of the data */
+	size_t		nbuckets;	/* power of 2, zero if unused */
+	size_t		size;		/* allocated slots */
+};
+
+/*
+ * Line of the mountinfo file, see mnt_diff_refresh_table()
+ */
+struct tabdiff_line {
+	int		id;		/* mount ID */
+	const char	*data;		/* the line in libmnt_tabdiff->raw or NULL */
+	size_t		len;		/* length of the line */
+	struct libmnt_fs *fs;		/* referenced entry or NULL */
+	int		state;		/* TABDIFF_LINE_* */
+};
+
+enum {
+	TABDIFF_LINE_GONE = 0,		/* not in the new file */
+	TABDIFF_LINE_KEPT,		/* unchanged, the entry is reused */
+	TABDIFF_LINE_REPLACED,		/* modified, the entry is replaced */
+	TABDIFF_LINE_UMOUNTED		/* modified, reported as umount */
+};
+
 struct libmnt_tabdiff {
 	int nchanges;			/* number of changes */
 
 	struct list_head changes;	/* list with modified entries */
 	struct list_head unused;	/* list with unused entries */
+
+	struct tabdiff_hash old_tgts;	/* old table by target */
+	struct tabdiff_hash new_tgts;	/* new table by target */
+	struct tabdiff_hash mounts;	/* MOUNT changes by ID and source */
+
+	/* mnt_diff_refresh_table() */
+	struct libmnt_table *tab;	/* table described by the lines */
+	struct libmnt_strbuf *raw;	/* the last content of the file */
+	struct tabdiff_line *lines;	/* lines from the last content */
+	size_t nlines;
+	struct tabdiff_hash ids;	/* lines by mount ID */
 };
 
 /**
@@ -49,6 +90,26 @@ struct libmnt_tabdiff *mnt_new_tabdiff(void)
 	return df;
 }
 
+static void tabdiff_free_lines(struct tabdiff_line *lines, size_t nlines)
+{
+	size_t i;
+
+	for (i = 0; i < nlines; i++)
+		mnt_unref_fs(lines[i].fs);
+	free(lines);
+}
+
+static void tabdiff_drop_lines(struct libmnt_tabdiff *df)
+{
+	tabdiff_free_lines(df->lines, df->nlines);
+	mnt_unref_strbuf(df->raw);
+
+	df->lines = NULL;
+	df->nlines = 0;
+	df->raw = NULL;
+	df->tab = NULL;
+}
+
 static void free_tabdiff_entry(struct tabdiff_entry *de)
 {
 	if (!de)
@@ -77,7 +138,22 @@ void mnt_free_tabdiff(struct libmnt_tabdiff *df)
 			                  struct tabdiff_entry, changes);
 		free_tabdiff_entry(de);
 	}
+	while (!list_empty(&df->unused)) {
+		struct tabdiff_entry *de = list_entry(df->unused.next,
+			                  struct tabdiff_entry, changes);
+		free_tabdiff_entry(de);
+	}
+
+	free(df->old_tgts.data);
+	free(df->old_tgts.hvals);
+	free(df->new_tgts.data);
+	free(df->new_tgts.hvals);
+	free(df->mounts.data);
+	free(df->mounts.hvals);
 
+	tabdiff_drop_lines(df);
+	free(df->ids.data);
+	free(df->ids.hvals);
 	free(df);
 }
 
@@ -181,6 +257,120 @@ static int tabdiff_add_entry(struct libmnt_tabdiff *df, struct libmnt_fs *old,
 	return 0;
 }
 
+static int tabdiff_is_mount(struct tabdiff_entry *de, const char *src, int id)
+{
+	const char *s;
+
+	if (de->oper != MNT_TABDIFF_MOUNT || !de->new_fs ||
+	    mnt_fs_get_id(de->new_fs) != id)
+		return 0;
+
+	s = mnt_fs_get_source(de->new_fs);
+
+	if (s == NULL && src == NULL)
+		return 1;
+	if (s && src && strcmp(s, src) == 0)
+		return 1;
+	return 0;
+}
+
+static size_t tabdiff_hash_mount(const char *src, int id)
+{
+	size_t hv = (size_t) id * 2654435761U;
+
+	for ( ; src && *src; src++)
+		hv = hv * 33 + (unsigned char) *src;
+	return hv;
+}
+
+/*
+ * Prepares empty hash for @n entries, returns 0 or -ENOMEM.
+ */
+static int tabdiff_hash_init(struct tabdiff_hash *h, size_t n)
+{
+	size_t sz;
+
+	for (sz = 16; sz < n * 2; sz <<= 1)
+		;
+	if (sz > h->size) {
+		void **data = realloc(h->data, sz * sizeof(void *));
+		size_t *hvals;
+
+		if (data)
+			h->data = data;
+		hvals = data ? realloc(h->hvals, sz * sizeof(size_t)) : NULL;
+		if (!hvals) {
+			h->nbuckets = 0;
+			return -ENOMEM;
+		}
+		h->hvals = hvals;
+		h->size = sz;
+	}
+
+	h->nbuckets = sz;
+	memset(h->data, 0, sz * sizeof(void *));
+	return 0;
+}
+
+static void tabdiff_hash_add(struct tabdiff_hash *h, size_t hv, void *data)
+{
+	size_t mask = h->nbuckets - 1, i;
+
+	for (i = hv & mask; h->data[i]; i = (i + 1) & mask)
+		;
+	h->data[i] = data;
+	h->hvals[i] = hv;
+}
+
+static int tabdiff_hash_table(struct tabdiff_hash *h, struct libmnt_table *tb)
+{
+	struct libmnt_iter itr;
+	struct libmnt_fs *fs;
+
+	if (tabdiff_hash_init(h, mnt_table_get_nents(tb)))
+		return -ENOMEM;
+
+	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
+	while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
+		const char *tgt = mnt_fs_get_target(fs);
+
+		if (tgt)
+			tabdiff_hash_add(h, mnt_hash_target(tgt), fs);
+	}
+	return 0;
+}
+
+/*
+ * The same as mnt_table_find_pair(tb, src, tgt, MNT_ITER_FORWARD) for tables
+ * without cache, the entries are in the hash chain in the table order.
+ */
+static struct libmnt_fs *tabdiff_find_pair(struct tabdiff_hash *h,
+					   struct libmnt_table *tb,
+					   const char *src, const char *tgt)
+{
+	size_t mask, hv, i;
+
+	if (!h->nbuckets)
+		return mnt_table_find_pair(tb, src, tgt, MNT_ITER_FORWARD);
+	if (!tgt || !*tgt || !src || !*src)
+		return NULL;
+
+	mask = h->nbuckets - 1;
+	hv = mnt_hash_target(tgt);
+
+	for (i = hv & mask; h->data[i]; i = (i + 1) & mask) {
+		struct libmnt_fs *fs = h->data[i];
+
+		if (h->hvals[i] != hv || !mnt_fs_streq_target(fs, tgt))
+			continue;
+		if (mnt_fs_streq_srcpath(fs, src) == 1)
+			return fs;
+		if (fs->tagname && fs->source && strcmp(src, fs->source) == 0)
+			return fs;
+	}
+	return NULL;
+}
+
 static struct tabdiff_entry *tabdiff_get_mount(struct libmnt_tabdiff *df,
 					       const char *src,
 					       int id)
@@ -189,21 +379,23 @@ static struct tabdiff_entry *tabdiff_get_mount(struct libmnt_tabdiff *df,
 
 	assert(df);
 
+	if (df->mounts.nbuckets) {
+		struct tabdiff_hash *h = &df->mounts;
+		size_t mask = h->nbuckets - 1, hv = tabdiff_hash_mount(src, id), i;
+
+		for (i = hv & mask; h->data[i]; i = (i + 1) & mask) {
+			if (h->hvals[i] == hv && tabdiff_is_mount(h->data[i], src, id))
+				return h->data[i];
+		}
+		return NULL;
+	}
+
 	list_for_each(p, &df->changes) {
 		struct tabdiff_entry *de;
 
 		de = list_entry(p, struct tabdiff_entry, changes);
-
-		if (de->oper == MNT_TABDIFF_MOUNT && de->new_fs &&
-		    mnt_fs_get_id(de->new_fs) == id) {
-
-			const char *s = mnt_fs_get_source(de->new_fs);
-
-			if (s == NULL && src == NULL)
-				return de;
-			if (s && src && strcmp(s, src) == 0)
-				return de;
-		}
+		if (tabdiff_is_mount(de, src, id))
+			return de;
 	}
 	return NULL;
 }
@@ -255,17 +447,31 @@ int mnt_diff_tables(struct libmnt_tabdiff *df, struct libmnt_table *old_tab,
 		goto done;
 	}
 
+	/* mnt_table_find_pair() is quadratic, use hashes if the paths are
+	 * not canonicalized (see mnt_fs_match_{source,target}()) */
+	df->old_tgts.nbuckets = df->new_tgts.nbuckets = df->mounts.nbuckets = 0;
+	if (!old_tab->cache && !new_tab->cache
+	    && (tabdiff_hash_table(&df->old_tgts, old_tab)
+		|| tabdiff_hash_table(&df->new_tgts, new_tab)
+		|| tabdiff_hash_init(&df->mounts, nn)))
+		df->old_tgts.nbuckets = df->new_tgts.nbuckets = df->mounts.nbuckets = 0;
+
 	/* search newly mounted or modified */
 	while(mnt_table_next_fs(new_tab, &itr, &fs) == 0) {
 		struct libmnt_fs *o_fs;
 		const char *src = mnt_fs_get_source(fs),
 			   *tgt = mnt_fs_get_target(fs);
 
-		o_fs = mnt_table_find_pair(old_tab, src, tgt, MNT_ITER_FORWARD);
-		if (!o_fs)
+		o_fs = tabdiff_find_pair(&df->old_tgts, old_tab, src, tgt);
+		if (!o_fs) {
 			/* 'fs' is not in the old table -- so newly mounted */
-			tabdiff_add_entry(df, NULL, fs, MNT_TABDIFF_MOUNT);
-		else {
+			if (tabdiff_add_entry(df, NULL, fs, MNT_TABDIFF_MOUNT) == 0
+			    && df->mounts.nbuckets)
+				tabdiff_hash_add(&df->mounts,
+					tabdiff_hash_mount(src, mnt_fs_get_id(fs)),
+					list_last_entry(&df->changes,
+						struct tabdiff_entry, changes));
+		} else {
 			/* is modified? */
 			const char *v1 = mnt_fs_get_vfs_options(o_fs),
 				   *v2 = mnt_fs_get_vfs_options(fs),
@@ -283,7 +489,7 @@ int mnt_diff_tables(struct libmnt_tabdiff *df, struct libmnt_table *old_tab,
 		const char *src = mnt_fs_get_source(fs),
 			   *tgt = mnt_fs_get_target(fs);
 
-		if (!mnt_table_find_pair(new_tab, src, tgt, MNT_ITER_FORWARD)) {
+		if (!tabdiff_find_pair(&df->new_tgts, new_tab, src, tgt)) {
 			struct tabdiff_entry *de;
 
 			de = tabdiff_get_mount(df, src,	mnt_fs_get_id(fs));
@@ -301,30 +507,372 @@ done:
 	return df->nchanges;
 }
 
-#ifdef TEST_PROGRAM
+/*
+ * Returns 1 if the lines from the last mnt_diff_refresh_table() call still
+ * describe all the entries of @tb.
+ */
+static int tabdiff_lines_in_sync(struct libmnt_tabdiff *df,
+				 struct libmnt_table *tb)
+{
+	size_t i;
+	int n = 0;
 
-int test_diff(struct libmnt_test *ts, int argc, char *argv[])
+	if (df->tab != tb)
+		return 0;
+
+	for (i = 0; i < df->nlines; i++) {
+		struct libmnt_fs *fs = df->lines[i].fs;
+
+		if (!fs)
+			continue;
+		if (fs->tab != tb)
+			return 0;
+		n++;
+	}
+	return n == tb->nents;
+}
+
+/*
+ * Creates lines without content from the entries of @tb, all the lines will
+ * be parsed and compared by the fields.
+ */
+static int tabdiff_lines_from_table(struct libmnt_tabdiff *df,
+				    struct libmnt_table *tb)
 {
-	struct libmnt_table *tb_old = NULL, *tb_new = NULL;
-	struct libmnt_tabdiff *diff = NULL;
-	struct libmnt_iter *itr;
-	struct libmnt_fs *old, *new;
-	int rc = -1, change;
+	struct libmnt_iter itr;
+	struct libmnt_fs *fs;
+	size_t n = 0;
 
-	tb_old = mnt_new_table_from_file(argv[1]);
-	tb_new = mnt_new_table_from_file(argv[2]);
-	diff = mnt_new_tabdiff();
-	itr = mnt_new_iter(MNT_ITER_FORWARD);
+	DBG(DIFF, ul_debugobj(df, "synchronize with table %p", tb));
 
-	if (!tb_old || !tb_new || !diff || !itr) {
-		warnx("failed to allocate resources");
-		goto done;
+	tabdiff_drop_lines(df);
+
+	df->lines = calloc(tb->nents + 1, sizeof(struct tabdiff_line));
+	if (!df->lines)
+		return -ENOMEM;
+
+	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
+	while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
+		df->lines[n].id = mnt_fs_get_id(fs);
+		df->lines[n].fs = fs;
+		mnt_ref_fs(fs);
+		n++;
 	}
 
-	rc = mnt_diff_tables(diff, tb_old, tb_new);
+	df->nlines = n;
+	df->tab = tb;
+	return 0;
+}
+
+/* returns the old line with @id which has not been used yet */
+static struct tabdiff_line *tabdiff_get_line(struct libmnt_tabdiff *df, int id)
+{
+	struct tabdiff_hash *h = &df->ids;
+	size_t mask = h->nbuckets - 1, hv = tabdiff_hash_mount(NULL, id), i;
+
+	for (i = hv & mask; h->data[i]; i = (i + 1) & mask) {
+		struct tabdiff_line *ln = h->data[i];
+
+		if (h->hvals[i] == hv && ln->id == id
+		    && ln->state == TABDIFF_LINE_GONE)
+			return ln;
+	}
+	return NULL;
+}
+
+/*
+ * Adds change for the new entry @fs from the modified or new line, @old is
+ * the previous line with the same mount ID or NULL. The umount of the old
+ * entry is added later, see mnt_diff_refresh_table().
+ */
+static int tabdiff_add_line_change(struct libmnt_tabdiff *df,
+				   struct tabdiff_line *old,
+				   struct libmnt_fs *fs)
+{
+	struct libmnt_fs *o_fs = old ? old->fs : NULL;
+	const char *s1, *s2, *v1, *v2, *f1, *f2;
+
+	if (old)
+		old->state = TABDIFF_LINE_REPLACED;
+	if (!fs) {
+		/* the new line is ignored (e.g. filtered out) */
+		if (old)
+			old->state = TABDIFF_LINE_UMOUNTED;
+		return 0;
+	}
+	if (!o_fs)
+		return tabdiff_add_entry(df, NULL, fs, MNT_TABDIFF_MOUNT);
+
+	s1 = mnt_fs_get_source(o_fs);
+	s2 = mnt_fs_get_source(fs);
+
+	if ((s1 || s2) && (!s1 || !s2 || strcmp(s1, s2) != 0)) {
+		/* another filesystem with recycled ID */
+		old->state = TABDIFF_LINE_UMOUNTED;
+		return tabdiff_add_entry(df, NULL, fs, MNT_TABDIFF_MOUNT);
+	}
+
+	if (!mnt_fs_streq_target(o_fs, mnt_fs_get_target(fs)))
+		return tabdiff_add_entry(df, o_fs, fs, MNT_TABDIFF_MOVE);
+
+	v1 = mnt_fs_get_vfs_options(o_fs);
+	v2 = mnt_fs_get_vfs_options(fs);
+	f1 = mnt_fs_get_fs_options(o_fs);
+	f2 = mnt_fs_get_fs_options(fs);
+
+	if ((v1 && v2 && strcmp(v1, v2)) || (f1 && f2 && strcmp(f1, f2)))
+		return tabdiff_add_entry(df, o_fs, fs, MNT_TABDIFF_REMOUNT);
+
+	return 0;	/* for example propagation flags */
+}
+
+/*
+ * mnt_diff_refresh_table() for files which are not in the mountinfo format
+ * (e.g. /proc/self/mounts or mtab), the whole file is parsed to a new table
+ * and compared with @tb by mnt_diff_tables().
+ */
+static int tabdiff_refresh_parsed(struct libmnt_tabdiff *df,
+				  struct libmnt_table *tb,
+				  const char *filename)
+{
+	struct libmnt_table *new_tab;
+	struct libmnt_fs *fs;
+	int rc;
+
+	DBG(DIFF, ul_debugobj(df, "refresh %s [parse the whole file]", filename));
+
+	tabdiff_drop_lines(df);
+
+	new_tab = mnt_new_table();
+	if (!new_tab)
+		return -ENOMEM;
+
+	new_tab->errcb = tb->errcb;
+	new_tab->fltrcb = tb->fltrcb;
+	new_tab->fltrcb_data = tb->fltrcb_data;
+	mnt_table_set_cache(new_tab, tb->cache);
+
+	rc = mnt_table_parse_file(new_tab, filename);
+	if (rc == 0)
+		rc = mnt_diff_tables(df, tb, new_tab);
 	if (rc < 0)
 		goto done;
 
+	/* the changes keep references to the old entries */
+	while (!list_empty(&tb->ents)) {
+		fs = list_entry(tb->ents.next, struct libmnt_fs, ents);
+		mnt_table_remove_fs(tb, fs);
+	}
+	while (!list_empty(&new_tab->ents)) {
+		fs = list_entry(new_tab->ents.next, struct libmnt_fs, ents);
+		mnt_ref_fs(fs);
+		mnt_table_remove_fs(new_tab, fs);
+		mnt_table_add_fs(tb, fs);
+		mnt_unref_fs(fs);
+	}
+	tb->fmt = new_tab->fmt;		/* guessed by the parser */
+done:
+	mnt_unref_table(new_tab);
+	return rc;
+}
+
+/**
+ * mnt_diff_refresh_table:
+ * @df: diff handler
+ * @tb: table with entries from the mountinfo file
+ * @filename: mountinfo file (e.g. /proc/self/mountinfo)
+ *
+ * Reads the current content of the mountinfo @filename and updates @tb to
+ * follow the file. The changes are stored in @df and accessible by
+ * mnt_tabdiff_next_change() like for mnt_diff_tables().
+ *
+ * The entries are paired by mount IDs. The content of the file is kept in
+ * @df, so for the next calls with the same @tb only the new and modified lines
+ * are parsed. The unchanged entries are kept in @tb. The first call (or the
+ * first call after @tb has been modified) parses the whole file and compares
+ * the entries by the fields. Files in other formats than mountinfo (or with
+ * unknown format) are always parsed and compared like by mnt_diff_tables().
+ *
+ * The old entries are removed from @tb, use mnt_ref_fs() if you want to keep
+ * them. The @tb parser callbacks (see mnt_table_set_parser_errcb()) are used
+ * for the new and modified lines only.
+ *
+ * Returns: number of changes, negative number in case of error.
+ */
+int mnt_diff_refresh_table(struct libmnt_tabdiff *df, struct libmnt_table *tb,
+			   const char *filename)
+{
+	struct libmnt_strbuf *raw;
+	struct tabdiff_line *lines = NULL;
+	struct libmnt_fs *fs = NULL;
+	size_t len, i, n = 0, lineno = 0;
+	pid_t tid = -1;
+	char *p, *end;
+	int rc = 0, modified = 0;
+
+	if (!df || !tb || !filename)
+		return -EINVAL;
+
+	if (tb->fmt != MNT_FMT_MOUNTINFO)
+		return tabdiff_refresh_parsed(df, tb, filename);
+
+	tabdiff_reset(df);
+
+	raw = mnt_read_strbuf(filename, &len);
+	if (!raw)
+		return -errno;
+
+	if (!tabdiff_lines_in_sync(df, tb)) {
+		rc = tabdiff_lines_from_table(df, tb);
+		if (rc)
+			goto err;
+	}
+
+	DBG(DIFF, ul_debugobj(df, "refresh %s [lines=%zu, size=%zu]",
+				filename, df->nlines, len));
+
+	if (tabdiff_hash_init(&df->ids, df->nlines)) {
+		rc = -ENOMEM;
+		goto err;
+	}
+	for (i = 0; i < df->nlines; i++) {
+		df->lines[i].state = TABDIFF_LINE_GONE;
+		tabdiff_hash_add(&df->ids,
+				tabdiff_hash_mount(NULL, df->lines[i].id),
+				&df->lines[i]);
+	}
+
+	end = raw->data + len;
+	for (p = raw->data, i = 1; p < end; p++) {
+		if (*p == '\n')
+			i++;
+	}
+	lines = calloc(i, sizeof(struct tabdiff_line));
+	if (!lines) {
+		rc = -ENOMEM;
+		goto err;
+	}
+
+	/* search newly mounted or modified */
+	for (p = raw->data; p < end; ) {
+		struct tabdiff_line *ln, *old;
+		char *s = p, *nl = memchr(p, '\n', end - p);
+
+		p = nl ? nl + 1 : end;
+		lineno++;
+
+		if (!nl)
+			nl = end;
+		if (nl > s && *(nl - 1) == '\r')
+			nl--;
+		s = (char *) skip_blank(s);
+		if (s >= nl || *s == '#')
+			continue;
+
+		ln = &lines[n++];
+		ln->id = strtol(s, NULL, 10);
+		ln->data = s;
+		ln->len = nl - s;
+
+		old = tabdiff_get_line(df, ln->id);
+		if (old && old->data && old->len == ln->len
+		    && memcmp(old->data, ln->data, ln->len) == 0) {
+			/* unchanged line, move the entry to the new line */
+			old->state = TABDIFF_LINE_KEPT;
+			ln->fs = old->fs;
+			old->fs = NULL;
+			continue;
+		}
+
+		modified = 1;
+		if (!fs) {
+			fs = mnt_new_fs();
+			if (!fs) {
+				rc = -ENOMEM;
+				goto err;
+			}
+		}
+		rc = mnt_table_parse_mountinfo_line(tb, fs, ln->data, ln->len,
+						    filename, lineno, &tid);
+		if (rc < 0)
+			goto err;
+		if (rc == 0) {
+			ln->fs = fs;
+			fs = NULL;
+		} else
+			mnt_reset_fs(fs);	/* recoverable error, reuse fs */
+
+		rc = tabdiff_add_line_change(df, old, ln->fs);
+		if (rc)
+			goto err;
+	}
+
+	/* search umounted */
+	for (i = 0; i < df->nlines; i++) {
+		struct tabdiff_line *old = &df->lines[i];
+
+		if (!old->fs || old->state == TABDIFF_LINE_KEPT)
+			continue;
+		modified = 1;
+		if (old->state == TABDIFF_LINE_GONE
+		    || old->state == TABDIFF_LINE_UMOUNTED) {
+			rc = tabdiff_add_entry(df, old->fs, NULL, MNT_TABDIFF_UMOUNT);
+			if (rc)
+				goto err;
+		}
+	}
+
+	/* update the table, the entries are in the file order */
+	if (modified) {
+		for (i = 0; i < df->nlines; i++) {
+			struct libmnt_fs *x = df->lines[i].fs;
+
+			if (x && x->tab == tb)
+				mnt_table_remove_fs(tb, x);
+		}
+		for (i = 0; i < n; i++) {
+			struct libmnt_fs *x = lines[i].fs;
+
+			if (!x)
+				continue;
+			if (x->tab == tb) {
+				list_del(&x->ents);
+				list_add_tail(&x->ents, &tb->ents);
+			} else
+				mnt_table_add_fs(tb, x);
+		}
+		mnt_table_drop_index(tb);
+	}
+
+	tabdiff_free_lines(df->lines, df->nlines);
+	mnt_unref_strbuf(df->raw);
+
+	df->lines = lines;
+	df->nlines = n;
+	df->raw = raw;
+	df->tab = tb;
+
+	DBG(DIFF, ul_debugobj(df, "%d changes detected", df->nchanges));
+	return df->nchanges;
+err:
+	DBG(DIFF, ul_debugobj(df, "refresh failed [rc=%d]", rc));
+	mnt_unref_fs(fs);
+	tabdiff_free_lines(lines, n);
+	tabdiff_drop_lines(df);
+	tabdiff_reset(df);
+	mnt_unref_strbuf(raw);
+	return rc;
+}
+
+#ifdef TEST_PROGRAM
+
+static void print_changes(struct libmnt_tabdiff *diff, struct libmnt_iter *itr)
+{
+	struct libmnt_fs *old, *new;
+	int change;
+
+	mnt_reset_iter(itr, MNT_ITER_FORWARD);
+
 	while(mnt_tabdiff_next_change(diff, itr, &old, &new, &change) == 0) {
 
 		printf("%s on %s: ", mnt_fs_get_source(new ? new : old),
@@ -349,7 +897,30 @@ int test_diff(struct libmnt_test *ts, int argc, char *argv[])
 			printf("unknown change!\n");
 		}
 	}
+}
+
+int test_diff(struct libmnt_test *ts, int argc, char *argv[])
+{
+	struct libmnt_table *tb_old = NULL, *tb_new = NULL;
+	struct libmnt_tabdiff *diff = NULL;
+	struct libmnt_iter *itr;
+	int rc = -1;
+
+	tb_old = mnt_new_table_from_file(argv[1]);
+	tb_new = mnt_new_table_from_file(argv[2]);
+	diff = mnt_new_tabdiff();
+	itr = mnt_new_iter(MNT_ITER_FORWARD);
+
+	if (!tb_old || !tb_new || !diff || !itr) {
+		warnx("failed to allocate resources");
+		goto done;
+	}
+
+	rc = mnt_diff_tables(diff, tb_old, tb_new);
+	if (rc < 0)
+		goto done;
 
+	print_changes(diff, itr);
 	rc = 0;
 done:
 	mnt_unref_table(tb_old);
@@ -359,10 +930,45 @@ done:
 	return rc;
 }
 
+int test_refresh(struct libmnt_test *ts, int argc, char *argv[])
+{
+	struct libmnt_table *tb;
+	struct libmnt_tabdiff *diff = NULL;
+	struct libmnt_iter *itr;
+	int rc = -1, i;
+
+	tb = mnt_new_table_from_file(argv[1]);
+	diff = mnt_new_tabdiff();
+	itr = mnt_new_iter(MNT_ITER_FORWARD);
+
+	if (!tb || !diff || !itr) {
+		warnx("failed to allocate resources");
+		goto done;
+	}
+
+	for (i = 2; i < argc; i++) {
+		rc = mnt_diff_refresh_table(diff, tb, argv[i]);
+		if (rc < 0)
+			goto done;
+
+		printf("--- %s: %d changes, %d entries\n", argv[i], rc,
+				mnt_table_get_nents(tb));
+		print_changes(diff, itr);
+	}
+
+	rc = 0;
+done:
+	mnt_unref_table(tb);
+	mnt_free_tabdiff(diff);
+	mnt_free_iter(itr);
+	return rc;
+}
+
 int main(int argc, char *argv[])
 {
 	struct libmnt_test tss[] = {
 		{ "--diff", test_diff, "<old> <new> prints change" },
+		{ "--refresh", test_refresh, "<file> <new> [<new> ...] updates <file> table, prints changes" },
 		{ NULL }
 	};
 
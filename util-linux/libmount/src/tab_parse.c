@@ -224,6 +224,138 @@ static int mnt_parse_mountinfo_line(struct libmnt_fs *fs, char *s)
 	return rc;
 }
 
+/* returns the next whitespace separated field, terminated in-place */
+static char *next_field(char **s)
+{
+	char *p = *s, *res;
+
+	while (isspace((unsigned char) *p))
+		p++;
+	if (!*p)
+		return NULL;
+	res = p;
+	while (*p && !isspace((unsigned char) *p))
+		p++;
+	if (*p)
+		*p++ = '\0';
+	*s = p;
+	return res;
+}
+
+static int next_strnum(char **s, unsigned long *num, int sep)
+{
+	char *end = NULL;
+
+	errno = 0;
+	*num = strtoul(*s, &end, 10);
+	if (errno || !end || end == *s || (sep && *end != sep))
+		return -EINVAL;
+	*s = sep ? end + 1 : end;
+	return 0;
+}
+
+/*
+ * Parses one line from a mountinfo file in the shared strings buffer; the
+ * same as mnt_parse_mountinfo_line(), but the fields are sliced in-place.
+ */
+static int mnt_parse_mountinfo_strbuf(struct libmnt_fs *fs, char *s,
+				      struct libmnt_strbuf *sb)
+{
+	unsigned long maj, min;
+	long num;
+	char *end, *p, *fstype, *src;
+	size_t sz;
+
+	if (fs->strbuf != sb) {
+		mnt_ref_strbuf(sb);
+		fs->strbuf = sb;
+	}
+
+	/* (1) id, (2) parent */
+	errno = 0;
+	num = strtol(s, &end, 10);
+	if (errno || end == s)
+		goto err;
+	fs->id = num;
+	s = end;
+	num = strtol(s, &end, 10);
+	if (errno || end == s)
+		goto err;
+	fs->parent = num;
+	s = (char *) skip_blank(end);
+
+	/* (3) maj:min */
+	if (next_strnum(&s, &maj, ':') || next_strnum(&s, &min, 0))
+		goto err;
+
+	/* (4) mountroot, (5) target */
+	fs->root = next_field(&s);
+	fs->target = next_field(&s);
+	if (!fs->root || !fs->target)
+		goto err;
+
+	/* (6) vfs options, the separator has to be found before the field
+	 * is terminated */
+	while (isspace((unsigned char) *s))
+		s++;
+	if (!*s)
+		goto err;
+	fs->vfs_optstr = s;
+	while (*s && !isspace((unsigned char) *s))
+		s++;
+
+	/* (7) optional fields, terminated by " - " */
+	p = strstr(s, " - ");
+	if (!p) {
+		DBG(TAB, ul_debug("mountinfo parse error: separator not found"));
+		return -EINVAL;
+	}
+	if (p > s + 1) {
+		fs->opt_fields = s + 1;
+		*p = '\0';
+	}
+	*s = '\0';
+	s = p + 3;
+
+	/* (8) FS type, (9) source, (10) fs options (fs specific) */
+	fstype = next_field(&s);
+	src = next_field(&s);
+	fs->fs_optstr = next_field(&s);
+	if (!fstype || !src || !fs->fs_optstr)
+		goto err;
+
+	fs->flags |= MNT_FS_KERNEL;
+	fs->devno = makedev(maj, min);
+
+	/* remove "(deleted)" suffix */
+	sz = strlen(fs->target);
+	if (sz > PATH_DELETED_SUFFIX_SZ) {
+		char *ptr = fs->target + (sz - PATH_DELETED_SUFFIX_SZ);
+
+		if (strcmp(ptr, PATH_DELETED_SUFFIX) == 0)
+			*ptr = '\0';
+	}
+
+	unmangle_string(fs->root);
+	unmangle_string(fs->target);
+	unmangle_string(fs->vfs_optstr);
+	unmangle_string(fstype);
+	unmangle_string(src);
+	unmangle_string(fs->fs_optstr);
+
+	__mnt_fs_set_fstype_ptr(fs, fstype);
+	__mnt_fs_set_source_ptr(fs, src);
+
+	/* merge VFS and FS options to one string */
+	fs->optstr = mnt_fs_strdup_options(fs);
+	if (!fs->optstr)
+		return -ENOMEM;
+	return 0;
+err:
+	DBG(TAB, ul_debug("mountinfo parse error"));
+	return -EINVAL;
+}
+
 /*
  * Parses one line from utab file
  */
@@ -676,6 +808,196 @@ err:
 	return rc;
 }
 
+/* reads the whole file to the shared strings buffer */
+struct libmnt_strbuf *mnt_read_strbuf(const char *filename, size_t *len)
+{
+	struct libmnt_strbuf *sb = NULL;
+	size_t sz = 64 * 1024;
+	int fd;
+
+	*len = 0;
+	fd = open(filename, O_RDONLY|O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+
+	do {
+		ssize_t ret;
+
+		if (!sb || *len + 1 >= sb->size) {
+			struct libmnt_strbuf *x;
+
+			if (sb)
+				sz = sb->size * 2;
+			x = realloc(sb, sizeof(*sb) + sz);
+			if (!x)
+				goto err;
+			if (!sb)
+				x->refcount = 1;
+			sb = x;
+			sb->size = sz;
+		}
+		ret = read(fd, sb->data + *len, sb->size - *len - 1);
+		if (ret < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			goto err;
+		}
+		if (ret == 0)
+			break;
+		*len += ret;
+	} while (1);
+
+	close(fd);
+	sb->data[*len] = '\0';
+
+	if (*len + 1 < sb->size) {
+		struct libmnt_strbuf *x = realloc(sb, sizeof(*sb) + *len + 1);
+
+		if (x) {
+			sb = x;
+			sb->size = *len + 1;
+		}
+	}
+	return sb;
+err:
+	{
+		int errsv = errno;
+
+		close(fd);
+		free(sb);
+		errno = errsv;
+	}
+	return NULL;
+}
+
+/*
+ * Parses mountinfo file by one read() to one buffer. The fields are
+ * unmangled in-place and shared by all the new filesystems (see struct
+ * libmnt_strbuf), so the parser does not allocate the strings.
+ *
+ * Returns: 0 on success, 1 if the file is not mountinfo, negative number in
+ * case of error.
+ */
+static int mnt_table_parse_mountinfo_file(struct libmnt_table *tb,
+					  const char *filename)
+{
+	struct libmnt_strbuf *sb;
+	struct libmnt_fs *fs = NULL;
+	pid_t tid = -1;
+	size_t len, line = 0;
+	char *p, *end;
+	int rc = 0;
+
+	sb = mnt_read_strbuf(filename, &len);
+	if (!sb)
+		return -errno;
+
+	DBG(TAB, ul_debugobj(tb, "%s: start parsing buffer [entries=%d, size=%zu]",
+				filename, mnt_table_get_nents(tb), len));
+
+	for (p = sb->data, end = p + len; p < end; ) {
+		char *s, *nl = memchr(p, '\n', end - p);
+
+		if (nl)
+			*nl = '\0';
+		s = p;
+		p = nl ? nl + 1 : end;
+		line++;
+
+		if (nl && nl > s && *(nl - 1) == '\r')
+			*(nl - 1) = '\0';
+		s = (char *) skip_blank(s);
+		if (*s == '\0' || *s == '#')
+			continue;
+
+		if (tb->fmt == MNT_FMT_GUESS) {
+			tb->fmt = guess_table_format(s);
+			if (tb->fmt != MNT_FMT_MOUNTINFO) {
+				rc = 1;		/* use mnt_table_parse_stream() */
+				break;
+			}
+		}
+
+		if (!fs) {
+			fs = mnt_new_fs();
+			if (!fs) {
+				rc = -ENOMEM;
+				break;
+			}
+		}
+
+		rc = mnt_parse_mountinfo_strbuf(fs, s, sb);
+		if (rc) {
+			DBG(TAB, ul_debugobj(tb, "%s:%zu: mountinfo parse error",
+						filename, line));
+			rc = tb->errcb ? tb->errcb(tb, filename, line) : 1;
+		}
+
+		if (!rc && tb->fltrcb && tb->fltrcb(fs, tb->fltrcb_data))
+			rc = 1;	/* filtered out by callback... */
+
+		if (!rc) {
+			rc = mnt_table_add_fs(tb, fs);
+			if (rc == 0)
+				rc = kernel_fs_postparse(tb, fs, &tid, filename);
+		}
+
+		if (rc > 0) {
+			mnt_reset_fs(fs);
+			assert(fs->refcount == 1);
+			rc = 0;
+			continue;	/* recoverable error, reuse fs*/
+		}
+		mnt_unref_fs(fs);
+		fs = NULL;
+		if (rc)
+			break;		/* fatal error */
+	}
+
+	mnt_unref_fs(fs);
+	mnt_unref_strbuf(sb);
+
+	DBG(TAB, ul_debugobj(tb, "%s: stop parsing buffer (%d entries) [rc=%d]",
+				filename, mnt_table_get_nents(tb), rc));
+	return rc;
+}
+
+/*
+ * Parses one mountinfo line of @len bytes for mnt_diff_refresh_table(). The
+ * line is copied to a new shared strings buffer, so the @fs does not keep the
+ * buffer with the whole file. The @tid has to be -1 for the first call.
+ *
+ * Returns: 0 on success, 1 if the line has been ignored (parse error or
+ * filtered out), negative number in case of error.
+ */
+int mnt_table_parse_mountinfo_line(struct libmnt_table *tb, struct libmnt_fs *fs,
+				   const char *line, size_t len,
+				   const char *filename, size_t lineno, pid_t *tid)
+{
+	struct libmnt_strbuf *sb;
+	int rc;
+
+	sb = mnt_new_strbuf(len + 1);
+	if (!sb)
+		return -ENOMEM;
+	memcpy(sb->data, line, len);
+	sb->data[len] = '\0';
+
+	rc = mnt_parse_mountinfo_strbuf(fs, sb->data, sb);
+	mnt_unref_strbuf(sb);		/* referenced by @fs */
+	if (rc) {
+		DBG(TAB, ul_debugobj(tb, "%s:%zu: mountinfo parse error",
+					filename, lineno));
+		rc = tb->errcb ? tb->errcb(tb, filename, lineno) : 1;
+	}
+
+	if (!rc && tb->fltrcb && tb->fltrcb(fs, tb->fltrcb_data))
+		rc = 1;	/* filtered out by callback... */
+	if (!rc)
+		rc = kernel_fs_postparse(tb, fs, tid, filename);
+	return rc;
+}
+
 /**
  * mnt_table_parse_file:
  * @tb: tab pointer
@@ -691,18 +1013,25 @@ err:
 int mnt_table_parse_file(struct libmnt_table *tb, const char *filename)
 {
 	FILE *f;
-	int rc;
+	int rc = 1;
 
 	if (!filename || !tb)
 		return -EINVAL;
 
+	/* mountinfo is read to one buffer, see above */
+	if (tb->fmt == MNT_FMT_MOUNTINFO
+	    || (tb->fmt == MNT_FMT_GUESS && endswith(filename, "mountinfo")))
+		rc = mnt_table_parse_mountinfo_file(tb, filename);
+	if (rc != 1)
+		goto done;
+
 	f = fopen(filename, "r" UL_CLOEXECSTR);
 	if (f) {
 		rc = mnt_table_parse_stream(tb, f, filename);
 		fclose(f);
 	} else
 		rc = -errno;
-
+done:
 	DBG(TAB, ul_debugobj(tb, "parsing done [filename=%s, rc=%d]", filename, rc));
 	return rc;
 }
@@ -56,6 +56,10 @@
 #ifdef HAVE_SYS_FILE_H
 #include <sys/file.h>
 #endif
+#if defined(HAVE_UUIDD) && defined(HAVE_SYS_UN_H)
+#include <sys/mman.h>
+#include <sched.h>
+#endif
 #ifdef HAVE_SYS_IOCTL_H
 #include <sys/ioctl.h>
 #endif
@@ -392,11 +396,181 @@ fail:
 	return -1;
 }
 
+/*
+ * The ring mapped by this process. The mapping is replaced when uuidd is
+ * restarted (the ring file is a new file then), but the other threads may
+ * be claiming a slot at the same time. The threads count themselves in
+ * @users while they touch the ring, and the mapping is replaced under
+ * @lock when there are no users; the threads which find the @lock taken
+ * don't wait and fall back to the socket.
+ */
+static struct uuidd_ring_map {
+	struct uuidd_ring	*ring;		/* mapped ring or NULL */
+	size_t			size;		/* size of the mapping */
+	uint32_t		nslots;		/* checked against @size */
+	dev_t			dev;		/* the ring file */
+	ino_t			ino;
+	time_t			next_check;	/* don't stat the file too often */
+
+	uint32_t		users;		/* threads using @ring */
+	int			lock;		/* @ring is being replaced */
+} ring_map;
+
+static const char *uuidd_ring_path = UUIDD_RING_PATH;
+
+/*
+ * Map the ring of time-based UUIDs published by uuidd --ring to @map.
+ */
+static int map_uuidd_ring(struct uuidd_ring_map *map)
+{
+	struct uuidd_ring *ring;
+	struct stat st;
+	int fd;
+
+	fd = open(uuidd_ring_path, O_RDWR | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, &st) != 0 || (size_t) st.st_size < UUIDD_RING_SIZE(0)) {
+		close(fd);
+		return -1;
+	}
+	ring = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (ring == MAP_FAILED)
+		return -1;
+
+	if (ring->magic != UUIDD_RING_MAGIC || !ring->nslots ||
+	    (size_t) st.st_size < UUIDD_RING_SIZE(ring->nslots)) {
+		munmap(ring, st.st_size);
+		return -1;
+	}
+	map->ring = ring;
+	map->size = st.st_size;
+	map->nslots = ring->nslots;
+	map->dev = st.st_dev;
+	map->ino = st.st_ino;
+	return 0;
+}
+
+/*
+ * Replace the mapping if uuidd has exited or it has been restarted. The
+ * active flag is not enough, it's cleared on clean exit only.
+ */
+static void remap_uuidd_ring(struct uuidd_ring_map *map)
+{
+	struct stat st;
+	int i, rc;
+
+	rc = stat(uuidd_ring_path, &st);
+	if (!map->ring && rc != 0)
+		return;				/* still no uuidd */
+
+	if (__sync_lock_test_and_set(&map->lock, 1))
+		return;				/* another thread remaps */
+
+	/* wait for the threads claiming a slot, give up after fork() */
+	for (i = 0; __sync_fetch_and_add(&map->users, 0); i++) {
+		if (i == 1000)
+			goto done;
+		sched_yield();
+	}
+	if (map->ring && rc == 0 && st.st_dev == map->dev &&
+	    st.st_ino == map->ino && __sync_fetch_and_add(&map->ring->active, 0))
+		goto done;			/* still the same uuidd */
+
+	if (map->ring)
+		munmap(map->ring, map->size);
+	map->ring = NULL;
+	if (rc == 0)
+		map_uuidd_ring(map);
+done:
+	__sync_lock_release(&map->lock);
+}
+
+/*
+ * Claim a range of time-based UUIDs from the mapped @r ring.
+ */
+static int claim_ring_slot(struct uuidd_ring *r, uint32_t nslots,
+			   uuid_t out, int *num, time_t now)
+{
+	struct uuidd_ring_slot *slot;
+	uint32_t pos, seq, stale = 0;
+	int32_t diff;
+	int old;
+
+	if (!__sync_fetch_and_add(&r->active, 0))
+		return -1;		/* uuidd is gone */
+
+	pos = __sync_fetch_and_add(&r->head, 0);
+	while (1) {
+		slot = &r->slots[pos % nslots];
+		seq = __sync_fetch_and_add(&slot->seq, 0);
+		diff = (int32_t) (seq - (pos + 1));
+
+		if (diff < 0)
+			return -1;		/* empty */
+		if (diff > 0 ||			/* claimed by someone else */
+		    !__sync_bool_compare_and_swap(&r->head, pos, pos + 1)) {
+			pos = __sync_fetch_and_add(&r->head, 0);
+			continue;
+		}
+
+		/* the slot is ours, copy it and give it back to uuidd */
+		memcpy(out, slot->uuid, sizeof(uuid_t));
+		*num = slot->num;
+		old = now > slot->time + 1;
+		__sync_val_compare_and_swap(&slot->seq, seq, pos + nslots);
+
+		if (!old)
+			break;
+		/* reserved too long ago, don't use it */
+		if (++stale >= nslots)
+			return -1;
+		pos++;
+	}
+
+	return *num > 0 && *num <= UUIDD_RING_RANGE ? 0 : -1;
+}
+
+/*
+ * Claim a range of time-based UUIDs from the uuidd shared memory ring.
+ *
+ * Returns 0 on success, the first UUID is stored to @out and the size of
+ * the range to @num. Returns -1 if the ring is not available or empty.
+ */
+static int get_uuid_via_ring(uuid_t out, int *num)
+{
+	struct uuidd_ring_map *map = &ring_map;
+	time_t now = time(0);
+	int rc = -1, tries;
+
+	for (tries = 0; tries < 2; tries++) {
+		__sync_fetch_and_add(&map->users, 1);
+		if (!__sync_fetch_and_add(&map->lock, 0) && map->ring)
+			rc = claim_ring_slot(map->ring, map->nslots,
+					     out, num, now);
+		__sync_fetch_and_sub(&map->users, 1);
+
+		/* no ring or empty ring, check for uuidd restart once per second */
+		if (rc == 0 || now < map->next_check)
+			break;
+		map->next_check = now + 1;
+		remap_uuidd_ring(map);
+	}
+
+	return rc;
+}
+
 #else /* !defined(HAVE_UUIDD) && defined(HAVE_SYS_UN_H) */
 static int get_uuid_via_daemon(int op, uuid_t out, int *num)
 {
 	return -1;
 }
+
+static int get_uuid_via_ring(uuid_t out, int *num)
+{
+	return -1;
+}
 #endif
 
 int __uuid_generate_time(uuid_t out, int *num)
@@ -431,51 +605,63 @@ int __uuid_generate_time(uuid_t out, int *num)
 /*
  * Generate time-based UUID and store it to @out
  *
- * Tries to guarantee uniqueness of the generated UUIDs by obtaining them from the uuidd daemon,
- * or, if uuidd is not usable, by using the global clock state counter (see get_clock()).
- * If neither of these is possible (e.g. because of insufficient permissions), it generates
- * the UUID anyway, but returns -1. Otherwise, returns 0.
+ * Tries to guarantee uniqueness of the generated UUIDs by obtaining them from
+ * the uuidd daemon, or, if uuidd is not usable, by using the global clock
+ * state counter (see get_clock()). If neither of these is possible (e.g.
+ * because of insufficient permissions), it generates the UUID anyway, but
+ * returns -1. Otherwise, returns 0.
+ *
+ * The UUIDs are reserved in blocks of UUID_TIME_BLOCK clock ticks, so the
+ * daemon or the clock state file is accessed only once per block. If uuidd
+ * publishes the shared memory ring, the blocks are claimed from the ring
+ * without talking to the daemon at all. The block is thread-local and it is
+ * dropped after fork() and when it is older than one second.
  */
+#define UUID_TIME_BLOCK	1000
+
 static int uuid_generate_time_generic(uuid_t out) {
 #ifdef HAVE_TLS
 	THREAD_LOCAL int		num = 0;
 	THREAD_LOCAL struct uuid	uu;
 	THREAD_LOCAL time_t		last_time = 0;
+	THREAD_LOCAL pid_t		last_pid = 0;
+	THREAD_LOCAL int		ret = 0;
 	time_t				now;
 
 	if (num > 0) {
 		now = time(0);
-		if (now > last_time+1)
+		if (now > last_time+1 || getpid() != last_pid)
 			num = 0;
 	}
 	if (num <= 0) {
-		num = 1000;
-		if (get_uuid_via_daemon(UUIDD_OP_BULK_TIME_UUID,
-					out, &num) == 0) {
-			last_time = time(0);
-			uuid_unpack(out, &uu);
-			num--;
-			return 0;
-		}
-		num = 0;
-	}
-	if (num > 0) {
-		uu.time_low++;
-		if (uu.time_low == 0) {
-			uu.time_mid++;
-			if (uu.time_mid == 0)
-				uu.time_hi_and_version++;
-		}
+		num = UUID_TIME_BLOCK;
+		ret = 0;
+		if (get_uuid_via_ring(out, &num) != 0 &&
+		    get_uuid_via_daemon(UUIDD_OP_BULK_TIME_UUID,
+					out, &num) != 0)
+			ret = __uuid_generate_time(out, &num);
+		last_time = time(0);
+		last_pid = getpid();
+		uuid_unpack(out, &uu);
 		num--;
-		uuid_pack(&uu, out);
-		return 0;
+		return ret;
 	}
+
+	uu.time_low++;
+	if (uu.time_low == 0) {
+		uu.time_mid++;
+		if (uu.time_mid == 0)
+			uu.time_hi_and_version++;
+	}
+	num--;
+	uuid_pack(&uu, out);
+	return ret;
 #else
 	if (get_uuid_via_daemon(UUIDD_OP_TIME_UUID, out, 0) == 0)
 		return 0;
-#endif
 
 	return __uuid_generate_time(out, 0);
+#endif
 }
 
 /*
@@ -495,35 +681,60 @@ int uuid_generate_time_safe(uuid_t out)
 }
 
 
-void __uuid_generate_random(uuid_t out, int *num)
-{
-	uuid_t	buf;
-	struct uuid uu;
-	int i, n;
+/*
+ * Per-thread pool of random bytes, so random_get_bytes() is not called for
+ * every single UUID. The pool is dropped after fork(), the child must not
+ * reuse the parent's bytes.
+ */
+#define UUID_RANDOM_POOL	(64 * sizeof(uuid_t))
 
-	if (!num || !*num)
-		n = 1;
-	else
-		n = *num;
+static void get_random_uuids(unsigned char *out, size_t n)
+{
+	size_t sz = n * sizeof(uuid_t);
+#ifdef HAVE_TLS
+	THREAD_LOCAL unsigned char	pool[UUID_RANDOM_POOL];
+	THREAD_LOCAL size_t		avail = 0;
+	THREAD_LOCAL pid_t		pool_pid = 0;
+
+	if (sz < sizeof(pool)) {
+		if (avail && getpid() != pool_pid)
+			avail = 0;
+		if (avail < sz) {
+			random_get_bytes(pool, sizeof(pool));
+			pool_pid = getpid();
+			avail = sizeof(pool);
+		}
+		memcpy(out, pool + sizeof(pool) - avail, sz);
+		memset(pool + sizeof(pool) - avail, 0, sz);
+		avail -= sz;
+	} else
+#endif
+		random_get_bytes(out, sz);
 
-	for (i = 0; i < n; i++) {
-		random_get_bytes(buf, sizeof(buf));
-		uuid_unpack(buf, &uu);
-
-		uu.clock_seq = (uu.clock_seq & 0x3FFF) | 0x8000;
-		uu.time_hi_and_version = (uu.time_hi_and_version & 0x0FFF)
-			| 0x4000;
-		uuid_pack(&uu, out);
-		out += sizeof(uuid_t);
+	/* set version 4 and the DCE variant directly in the packed UUIDs */
+	for (; n > 0; n--, out += sizeof(uuid_t)) {
+		out[6] = (out[6] & 0x0F) | 0x40;
+		out[8] = (out[8] & 0x3F) | 0x80;
 	}
 }
 
+void __uuid_generate_random(uuid_t out, int *num)
+{
+	get_random_uuids(out, !num || *num <= 0 ? 1 : (size_t) *num);
+}
+
 void uuid_generate_random(uuid_t out)
 {
-	int	num = 1;
 	/* No real reason to use the daemon for random uuid's -- yet */
+	get_random_uuids(out, 1);
+}
 
-	__uuid_generate_random(out, &num);
+/*
+ * Generate @n random-based UUIDs and store them to @out array.
+ */
+void uuid_generate_random_n(uuid_t *out, size_t n)
+{
+	get_random_uuids((unsigned char *) out, n);
 }
 
 /*
@@ -551,3 +762,126 @@ void uuid_generate(uuid_t out)
 	else
 		uuid_generate_time(out);
 }
+
+#ifdef TEST_PROGRAM
+static double bench_elapsed(struct timeval *start)
+{
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+	return (now.tv_sec - start->tv_sec) + (now.tv_usec - start->tv_usec) / 1E6;
+}
+
+static void bench_report(const char *name, size_t n, double sec)
+{
+	printf("%-28s %9.3f s  %12.0f uuids/s\n", name, sec, sec > 0 ? n / sec : 0);
+}
+
+/* random_get_bytes() without getrandom(), open and read /dev/urandom */
+static void bench_urandom(uuid_t out)
+{
+	unsigned char *cp = out;
+	size_t i;
+	int fd = random_get_fd();
+
+	if (fd >= 0) {
+		if (read_all(fd, (char *) out, sizeof(uuid_t)) != sizeof(uuid_t))
+			memset(out, 0, sizeof(uuid_t));
+		close(fd);
+	}
+	for (i = 0; i < sizeof(uuid_t); i++)
+		*cp++ ^= (rand() >> 7) & 0xFF;
+}
+
+#if defined(HAVE_UUIDD) && defined(HAVE_SYS_UN_H)
+/*
+ * Claim ranges from the uuidd --ring=<file> ring, one attempt for every
+ * line on stdin. The old ring may be still full after uuidd restart, so it
+ * claims slots until the current ring file is used.
+ */
+static int test_ring(const char *path)
+{
+	char line[128];
+	struct stat st;
+	uuid_t uu;
+	int i, num, rc, current;
+
+	uuidd_ring_path = path;
+
+	while (fgets(line, sizeof(line), stdin)) {
+		rc = -1, current = 0;
+		for (i = 0; !current && i <= UUIDD_RING_SLOTS; i++) {
+			ring_map.next_check = 0;
+			rc = get_uuid_via_ring(uu, &num);
+			current = rc == 0 && stat(path, &st) == 0 &&
+				  st.st_ino == ring_map.ino;
+		}
+		line[strcspn(line, "\n")] = '\0';
+		printf("%s: %s\n", line, current ? "claimed from the ring" :
+				       rc == 0 ? "claimed from an old ring" :
+						 "no ring");
+		fflush(stdout);
+	}
+	return EXIT_SUCCESS;
+}
+#endif
+
+int main(int argc, char *argv[])
+{
+	size_t i, n = 1000000;
+	uuid_t *uu;
+	struct timeval start;
+
+#if defined(HAVE_UUIDD) && defined(HAVE_SYS_UN_H)
+	if (argc == 3 && strcmp(argv[1], "--ring") == 0)
+		return test_ring(argv[2]);
+#endif
+	if (argc > 1)
+		n = strtoul(argv[1], NULL, 10);
+	if (!n) {
+		fprintf(stderr, "usage: %s [<count> | --ring <file>]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	uu = malloc(n * sizeof(uuid_t));
+	if (!uu)
+		return EXIT_FAILURE;
+
+	/* the old way, /dev/urandom for every UUID */
+	gettimeofday(&start, NULL);
+	for (i = 0; i < n; i++)
+		bench_urandom(uu[i]);
+	bench_report("/dev/urandom loop (old)", n, bench_elapsed(&start));
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < n; i++)
+		random_get_bytes(uu[i], sizeof(uuid_t));
+	bench_report("random_get_bytes() loop", n, bench_elapsed(&start));
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < n; i++)
+		uuid_generate_random(uu[i]);
+	bench_report("uuid_generate_random() loop", n, bench_elapsed(&start));
+
+	gettimeofday(&start, NULL);
+	uuid_generate_random_n(uu, n);
+	bench_report("uuid_generate_random_n()", n, bench_elapsed(&start));
+
+	for (i = 0; i < n; i++) {
+		if (uuid_type(uu[i]) != UUID_TYPE_DCE_RANDOM ||
+		    uuid_variant(uu[i]) != UUID_VARIANT_DCE) {
+			fprintf(stderr, "%zu: invalid UUID\n", i);
+			free(uu);
+			return EXIT_FAILURE;
+		}
+	}
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < n; i++)
+		uuid_generate_time(uu[i]);
+	bench_report("uuid_generate_time() loop", n, bench_elapsed(&start));
+
+	free(uu);
+	return EXIT_SUCCESS;
+}
+#endif /* TEST_PROGRAM */
@@ -35,9 +35,12 @@
 #ifndef _UUID_UUIDD_H
 #define _UUID_UUIDD_H
 
+#include <stdint.h>
+
 #define UUIDD_DIR		_PATH_LOCALSTATEDIR "/uuidd"
 #define UUIDD_SOCKET_PATH	UUIDD_DIR "/request"
 #define UUIDD_PIDFILE_PATH	UUIDD_DIR "/uuidd.pid"
+#define UUIDD_RING_PATH		UUIDD_DIR "/ring"
 #define UUIDD_PATH		"/usr/sbin/uuidd"
 
 #define UUIDD_OP_GETPID			0
@@ -48,6 +51,35 @@
 #define UUIDD_OP_BULK_RANDOM_UUID	5
 #define UUIDD_MAX_OP			UUIDD_OP_BULK_RANDOM_UUID
 
+/*
+ * Shared memory ring of reserved time-based UUID ranges (uuidd --ring).
+ *
+ * uuidd is the only producer, the clients claim the slots by atomic
+ * operations. The slot at position @pos is full if its @seq is pos + 1
+ * and free for the next round if its @seq is pos + nslots.
+ */
+#define UUIDD_RING_MAGIC	0x55524e47	/* "URNG" */
+#define UUIDD_RING_SLOTS	256
+#define UUIDD_RING_RANGE	1000		/* UUIDs in one slot */
+
+struct uuidd_ring_slot {
+	uint32_t	seq;
+	int32_t		num;		/* number of UUIDs */
+	int64_t		time;		/* when reserved, in seconds */
+	uuid_t		uuid;		/* the first UUID of the range */
+};
+
+struct uuidd_ring {
+	uint32_t	magic;
+	uint32_t	nslots;
+	uint32_t	active;		/* zero when uuidd exited */
+	uint32_t	head;		/* next slot to claim */
+	struct uuidd_ring_slot slots[];
+};
+
+#define UUIDD_RING_SIZE(n)	(sizeof(struct uuidd_ring) + \
+				 (n) * sizeof(struct uuidd_ring_slot))
+
 extern int __uuid_generate_time(uuid_t out, int *num);
 extern void __uuid_generate_random(uuid_t out, int *num);
 
@@ -26,6 +26,7 @@
  */
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <sys/fcntl.h>
 #include <time.h>
 #include <stdio.h>
@@ -75,6 +76,7 @@
 #endif
 
 #define UCHUNKSIZE	16384	/* How much we read at once. */
+#define WTMP_ORDER_CHECK 64	/* records checked around bisected boundary */
 
 struct last_control {
 	unsigned int lastb :1,	  /* Is this command 'lastb' */
@@ -97,6 +99,20 @@ struct last_control {
 	unsigned int time_fmt;	/* time format */
 };
 
+/*
+ * The wtmp file is mmapped if possible, otherwise it's read by uread().
+ * The records are read backward from 'next' to 'first'.
+ */
+struct wtmp_file {
+	FILE *fp;
+	const char *filename;
+
+	struct utmp *map;	/* mmapped records */
+	size_t nrecs;		/* number of the mmapped records */
+	size_t first;		/* index of the first record to read */
+	size_t next;		/* index of the last unread record + 1 */
+};
+
 /* Double linked list of struct utmp's */
 struct utmplist {
 	struct utmp ut;
@@ -241,6 +257,109 @@ static int uread(FILE *fp, struct utmp *u,  int *quit, const char *filename)
 	return 1;
 }
 
+/*
+ *	Returns 1 if the records around @idx are in order, it means all the
+ *	records before @idx are older than @limit and the others are not.
+ */
+static int wtmp_is_boundary(const struct wtmp_file *wf, size_t idx, time_t limit)
+{
+	size_t i = idx > WTMP_ORDER_CHECK ? idx - WTMP_ORDER_CHECK : 0;
+	size_t end = idx + WTMP_ORDER_CHECK < wf->nrecs ?
+				idx + WTMP_ORDER_CHECK : wf->nrecs;
+
+	for (; i < end; i++) {
+		if (((time_t) wf->map[i].UL_UT_TIME < limit) != (i < idx))
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ *	Maps the file and finds the records within --since and --until. The
+ *	records are expected in the time order (the file is append only), the
+ *	boundaries are found by binary search. A record out of order (e.g.
+ *	after a clock change) could mislead the search, so the records around
+ *	the boundaries are checked and the whole file is read if they are not
+ *	in order. Returns 0 on success, -1 if the file cannot be mapped.
+ */
+static int wtmp_map(const struct last_control *ctl, struct wtmp_file *wf)
+{
+	struct stat st;
+	void *map;
+	size_t lo, hi;
+
+	if (fstat(fileno(wf->fp), &st) != 0 || !S_ISREG(st.st_mode) ||
+	    st.st_size == 0 || st.st_size % sizeof(struct utmp) != 0)
+		return -1;
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(wf->fp), 0);
+	if (map == MAP_FAILED)
+		return -1;
+
+	wf->map = map;
+	wf->nrecs = st.st_size / sizeof(struct utmp);
+
+	wf->first = 0;
+	wf->next = wf->nrecs;
+
+	/* the first record after --until */
+	if (ctl->until) {
+		lo = 0, hi = wf->nrecs;
+		while (lo < hi) {
+			size_t i = lo + (hi - lo) / 2;
+
+			if (wf->map[i].UL_UT_TIME <= ctl->until)
+				lo = i + 1;
+			else
+				hi = i;
+		}
+		wf->next = lo;
+	}
+
+	/* the first record since --since */
+	if (ctl->since) {
+		lo = 0, hi = wf->next;
+		while (lo < hi) {
+			size_t i = lo + (hi - lo) / 2;
+
+			if (wf->map[i].UL_UT_TIME < ctl->since)
+				lo = i + 1;
+			else
+				hi = i;
+		}
+		wf->first = lo;
+	}
+
+	if ((ctl->until && !wtmp_is_boundary(wf, wf->next, ctl->until + 1)) ||
+	    (ctl->since && !wtmp_is_boundary(wf, wf->first, ctl->since))) {
+		wf->first = 0;
+		wf->next = wf->nrecs;
+	}
+
+	return 0;
+}
+
+static void wtmp_unmap(struct wtmp_file *wf)
+{
+	if (wf->map)
+		munmap(wf->map, wf->nrecs * sizeof(struct utmp));
+	wf->map = NULL;
+}
+
+/*
+ *	Read the previous record, returns 1 on success.
+ */
+static int wtmp_read_prev(struct wtmp_file *wf, struct utmp *u, int *quit)
+{
+	if (!wf->map)
+		return uread(wf->fp, u, quit, wf->filename);
+	if (wf->next == wf->first)
+		return 0;
+
+	memcpy(u, &wf->map[--wf->next], sizeof(*u));
+	return 1;
+}
+
 /*
  *	Print a short date.
  */
@@ -617,6 +736,7 @@ static void process_wtmp_file(const struct last_control *ctl,
 			      const char *filename)
 {
 	FILE *fp;		/* Filepointer of wtmp file */
+	struct wtmp_file wf = { .filename = filename };
 
 	struct utmp ut;		/* Current utmp entry */
 	struct utmplist *ulist = NULL;	/* All entries */
@@ -670,17 +790,19 @@ static void process_wtmp_file(const struct last_control *ctl,
 	}
 
 	/*
-	 * Go to end of file minus one structure
+	 * Map the file, or go to end of file minus one structure
 	 * and/or initialize utmp reading code.
 	 */
-	uread(fp, NULL, NULL, filename);
+	wf.fp = fp;
+	if (quit || wtmp_map(ctl, &wf) != 0)
+		uread(fp, NULL, NULL, filename);
 
 	/*
 	 * Read struct after struct backwards from the file.
 	 */
 	while (!quit) {
 
-		if (uread(fp, &ut, &quit, filename) != 1)
+		if (wtmp_read_prev(&wf, &ut, &quit) != 1)
 			break;
 
 		if (ctl->since && ut.UL_UT_TIME < ctl->since)
@@ -859,6 +981,7 @@ static void process_wtmp_file(const struct last_control *ctl,
 	}
 
 	printf(_("\n%s begins %s"), basename(filename), ctime(&begintime));
+	wtmp_unmap(&wf);
 	fclose(fp);
 
 	for (p = ulist; p; p = next) {
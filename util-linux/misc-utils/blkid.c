@@ -62,7 +62,7 @@ static void usage(int error)
 	fprintf(out,
 		"Usage:\n"
 		" %1$s -L <label> | -U <uuid>\n\n"
-		" %1$s [-c <file>] [-ghlLv] [-o <format>] [-s <tag>] \n"
+		" %1$s [-c <file>] [-ghlLv] [-j <num>] [-o <format>] [-s <tag>] \n"
 		"       [-t <token>] [<dev> ...]\n\n"
 		" %1$s -p [-s <tag>] [-O <offset>] [-S <size>] \n"
 		"       [-o <format>] <dev> ...\n\n"
@@ -73,6 +73,7 @@ static void usage(int error)
 		" -d          don't encode non-printing characters\n"
 		" -h          print this usage message and exit\n"
 		" -g          garbage collect the blkid cache\n"
+		" -j <num>    probe all devices by <num> parallel threads\n"
 		" -o <format> output format; can be one of:\n"
 		"               value, device, export or full; (default: full)\n"
 		" -k          list all known filesystems/RAIDs and exit\n"
@@ -645,6 +646,7 @@ int main(int argc, char **argv)
 	unsigned int i;
 	int output_format = 0;
 	int lookup = 0, gc = 0, lowprobe = 0, eval = 0;
+	unsigned int nthreads = 0;
 	int c;
 	uintmax_t offset = 0, size = 0;
 
@@ -658,7 +660,7 @@ int main(int argc, char **argv)
 	atexit(close_stdout);
 
 	while ((c = getopt (argc, argv,
-			    "c:df:ghilL:n:ko:O:ps:S:t:u:U:w:Vv")) != EOF) {
+			    "c:df:ghij:lL:n:ko:O:ps:S:t:u:U:w:Vv")) != EOF) {
 
 		err_exclusive_options(c, NULL, excl, excl_st);
 
@@ -691,6 +693,9 @@ int main(int argc, char **argv)
 		case 'i':
 			lowprobe |= LOWPROBE_TOPOLOGY;
 			break;
+		case 'j':
+			nthreads = strtou32_or_err(optarg, "invalid number of threads");
+			break;
 		case 'l':
 			lookup++;
 			break;
@@ -793,6 +798,8 @@ int main(int argc, char **argv)
 
 	if (!lowprobe && !eval && blkid_get_cache(&cache, read) < 0)
 		goto exit;
+	if (cache && nthreads)
+		blkid_cache_set_nthreads(cache, nthreads);
 
 	if (gc) {
 		blkid_gc_cache(cache);
@@ -172,6 +172,7 @@ static int flags;
 
 /* poll actions (parsed --poll=<list> */
 #define FINDMNT_NACTIONS	4		/* mount, umount, move, remount */
+#define FINDMNT_POLL_WINDOW_MAX	60000		/* --poll-window limit in ms */
 static int actions[FINDMNT_NACTIONS];
 static int nactions;
 
@@ -717,6 +718,7 @@ static struct libscols_line *add_line(struct libscols_table *table, struct libmn
 		scols_line_refer_data(line, i, get_data(fs, i));
 
 	scols_line_set_userdata(line, fs);
+	mnt_fs_set_userdata(fs, line);
 	return line;
 }
 
@@ -737,25 +739,13 @@ static struct libscols_line *add_tabdiff_line(struct libscols_table *table, stru
 	return line;
 }
 
-static int has_line(struct libscols_table *table, struct libmnt_fs *fs)
+/*
+ * Returns 1 if the @fs is already in the output table, add_line() saves
+ * the output line to the @fs userdata.
+ */
+static inline int has_line(struct libmnt_fs *fs)
 {
-	struct libscols_line *ln;
-	struct libscols_iter *itr;
-	int rc = 0;
-
-	itr = scols_new_iter(SCOLS_ITER_FORWARD);
-	if (!itr)
-		return 0;
-
-	while (scols_table_next_line(table, itr, &ln) == 0) {
-		if ((struct libmnt_fs *) scols_line_get_userdata(ln) == fs) {
-			rc = 1;
-			break;
-		}
-	}
-
-	scols_free_iter(itr);
-	return rc;
+	return mnt_fs_get_userdata(fs) != NULL;
 }
 
 /* reads filesystems from @tb (libmount) and fillin @table (output table) */
@@ -773,7 +763,7 @@ static int create_treenode(struct libscols_table *table, struct libmnt_table *tb
 			goto leave;
 		parent_line = NULL;
 
-	} else if ((flags & FL_SUBMOUNTS) && has_line(table, fs))
+	} else if ((flags & FL_SUBMOUNTS) && has_line(fs))
 		return 0;
 
 	itr = mnt_new_iter(MNT_ITER_FORWARD);
@@ -1084,21 +1074,50 @@ static int poll_match(struct libmnt_fs *fs)
 	return rc;
 }
 
+/*
+ * Waits for the next change of the @tabfile; libmount monitor is used for
+ * the default /proc/self/mountinfo, @f for other files.
+ *
+ * Returns: 1 on change, 0 on timeout, <0 on error.
+ */
+static int poll_wait(struct libmnt_monitor *mn, FILE *f, int timeout)
+{
+	struct pollfd fds[1];
+	int rc;
+
+	if (mn) {
+		rc = mnt_monitor_wait(mn, timeout);
+		if (rc < 0)
+			errno = -rc;
+		return rc;
+	}
+
+	fds[0].fd = fileno(f);
+	fds[0].events = POLLPRI;
+
+	rc = poll(fds, 1, timeout);
+	return rc < 0 ? -errno : rc;
+}
+
+/* drains all pending events, the changes are already in the file */
+static void poll_drain(struct libmnt_monitor *mn, FILE *f)
+{
+	if (mn)
+		mnt_monitor_event_cleanup(mn);
+	else
+		while (poll_wait(NULL, f, 0) > 0)
+			;
+}
+
 static int poll_table(struct libmnt_table *tb, const char *tabfile,
-		  int timeout, struct libscols_table *table, int direction)
+		  int timeout, unsigned int window, struct libscols_table *table,
+		  int direction)
 {
 	FILE *f = NULL;
 	int rc = -1;
 	struct libmnt_iter *itr = NULL;
-	struct libmnt_table *tb_new = NULL;
 	struct libmnt_tabdiff *diff = NULL;
-	struct pollfd fds[1];
-
-	tb_new = mnt_new_table();
-	if (!tb_new) {
-		warn(_("failed to initialize libmount table"));
-		goto done;
-	}
+	struct libmnt_monitor *mn = NULL;
 
 	itr = mnt_new_iter(direction);
 	if (!itr) {
@@ -1114,25 +1133,27 @@ static int poll_table(struct libmnt_table *tb, const char *tabfile,
 
 	/* cache is unnecessary to detect changes */
 	mnt_table_set_cache(tb, NULL);
-	mnt_table_set_cache(tb_new, NULL);
 
-	f = fopen(tabfile, "r");
-	if (!f) {
-		warn(_("cannot open %s"), tabfile);
-		goto done;
+	if (strcmp(tabfile, _PATH_PROC_MOUNTINFO) == 0) {
+		mn = mnt_new_monitor();
+		if (!mn || mnt_monitor_enable_kernel(mn, TRUE) != 0
+		    || mnt_monitor_get_fd(mn) < 0) {
+			warn(_("failed to initialize libmount monitor"));
+			goto done;
+		}
+	} else {
+		f = fopen(tabfile, "r");
+		if (!f) {
+			warn(_("cannot open %s"), tabfile);
+			goto done;
+		}
 	}
 
-	mnt_table_set_parser_errcb(tb_new, parser_errcb);
-
-	fds[0].fd = fileno(f);
-	fds[0].events = POLLPRI;
-
 	while (1) {
-		struct libmnt_table *tmp;
 		struct libmnt_fs *old, *new;
 		int change, count;
 
-		count = poll(fds, 1, timeout);
+		count = poll_wait(mn, f, timeout);
 		if (count == 0)
 			break;	/* timeout */
 		if (count < 0) {
@@ -1140,10 +1161,14 @@ static int poll_table(struct libmnt_table *tb, const char *tabfile,
 			goto done;
 		}
 
-		rewind(f);
-		rc = mnt_table_parse_stream(tb_new, f, tabfile);
-		if (!rc)
-			rc = mnt_diff_tables(diff, tb, tb_new);
+		/* coalesce the changes within the window */
+		if (window > 0)
+			xusleep((useconds_t) window * 1000);
+		poll_drain(mn, f);
+
+		/* only the new and modified lines are parsed, the unchanged
+		 * entries are kept in the table */
+		rc = mnt_diff_refresh_table(diff, tb, tabfile);
 		if (rc < 0)
 			goto done;
 
@@ -1168,15 +1193,10 @@ static int poll_table(struct libmnt_table *tb, const char *tabfile,
 			rc = scols_print_table(table);
 			if (rc)
 				goto done;
+			fflush(stdout);
 		}
 
-		/* swap tables */
-		tmp = tb;
-		tb = tb_new;
-		tb_new = tmp;
-
 		scols_table_remove_lines(table);
-		mnt_reset_table(tb_new);
 
 		if (count && (flags & FL_FIRSTONLY))
 			break;
@@ -1184,7 +1204,7 @@ static int poll_table(struct libmnt_table *tb, const char *tabfile,
 
 	rc = 0;
 done:
-	mnt_unref_table(tb_new);
+	mnt_unref_monitor(mn);
 	mnt_free_tabdiff(diff);
 	mnt_free_iter(itr);
 	if (f)
@@ -1223,6 +1243,7 @@ static void __attribute__((__noreturn__)) usage(FILE *out)
 	fputc('\n', out);
 	fputs(_(" -p, --poll[=<list>]    monitor changes in table of mounted filesystems\n"), out);
 	fputs(_(" -w, --timeout <num>    upper limit in milliseconds that --poll will block\n"), out);
+	fputs(_("     --poll-window <num> collect changes for --poll within <num> milliseconds\n"), out);
 	fputc('\n', out);
 
 	fputs(_(" -A, --all              disable all built-in filters, print all filesystems\n"), out);
@@ -1275,12 +1296,17 @@ int main(int argc, char *argv[])
 	char **tabfiles = NULL;
 	int direction = MNT_ITER_FORWARD;
 	int c, rc = -1, timeout = -1;
+	unsigned int window = 0;
 	int ntabfiles = 0, tabtype = 0;
 	char *outarg = NULL;
 	size_t i;
 
 	struct libscols_table *table = NULL;
 
+	enum {
+		FINDMNT_OPT_POLL_WINDOW = CHAR_MAX + 1
+	};
+
 	static const struct option longopts[] = {
 	    { "all",          0, 0, 'A' },
 	    { "ascii",        0, 0, 'a' },
@@ -1303,6 +1329,7 @@ int main(int argc, char *argv[])
 	    { "options",      1, 0, 'O' },
 	    { "output",       1, 0, 'o' },
 	    { "poll",         2, 0, 'p' },
+	    { "poll-window",  1, 0, FINDMNT_OPT_POLL_WINDOW },
 	    { "pairs",        0, 0, 'P' },
 	    { "raw",          0, 0, 'r' },
 	    { "types",        1, 0, 't' },
@@ -1470,6 +1497,12 @@ int main(int argc, char *argv[])
 		case 'w':
 			timeout = strtos32_or_err(optarg, _("invalid timeout argument"));
 			break;
+		case FINDMNT_OPT_POLL_WINDOW:
+			window = strtou32_or_err(optarg, _("invalid poll window argument"));
+			if (window > FINDMNT_POLL_WINDOW_MAX)
+				errx(EXIT_FAILURE, _("poll window %u is out of range (max %u)"),
+						window, FINDMNT_POLL_WINDOW_MAX);
+			break;
 		case 'V':
 			printf(UTIL_LINUX_VERSION);
 			return EXIT_SUCCESS;
@@ -1615,7 +1648,8 @@ int main(int argc, char *argv[])
 	 */
 	if (flags & FL_POLL) {
 		/* poll mode (accept the first tabfile only) */
-		rc = poll_table(tb, tabfiles ? *tabfiles : _PATH_PROC_MOUNTINFO, timeout, table, direction);
+		rc = poll_table(tb, tabfiles ? *tabfiles : _PATH_PROC_MOUNTINFO,
+				timeout, window, table, direction);
 
 	} else if ((flags & FL_TREE) && !(flags & FL_SUBMOUNTS)) {
 		/* whole tree */
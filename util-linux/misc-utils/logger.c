@@ -46,6 +46,7 @@
 #include <string.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 #include <arpa/inet.h>
 #include <netdb.h>
@@ -53,6 +54,7 @@
 #include <pwd.h>
 #include <sys/types.h>
 #include <signal.h>
+#include <poll.h>
 
 #include "all-io.h"
 #include "c.h"
@@ -63,6 +65,7 @@
 #include "xalloc.h"
 #include "strv.h"
 #include "list.h"
+#include "monotonic.h"
 
 #define	SYSLOG_NAMES
 #include <syslog.h>
@@ -88,6 +91,12 @@ enum {
 	AF_UNIX_ERRORS_AUTO
 };
 
+enum {
+	LOGGER_RECONNECT_NONE = 0,
+	LOGGER_RECONNECT_BLOCK,		/* wait for the server if the queue is full */
+	LOGGER_RECONNECT_DROP		/* drop messages if the queue is full */
+};
+
 enum {
 	OPT_PRIO_PREFIX = CHAR_MAX + 1,
 	OPT_JOURNALD,
@@ -99,7 +108,32 @@ enum {
 	OPT_ID,
 	OPT_STRUCTURED_DATA_ID,
 	OPT_STRUCTURED_DATA_PARAM,
-	OPT_OCTET_COUNT
+	OPT_OCTET_COUNT,
+	OPT_RECONNECT,
+	OPT_QUEUE_SIZE
+};
+
+/* messages read from stdin are sent in batches, see logger_stdin() */
+#define LOGGER_BATCH_MAX	64
+#define LOGGER_STDIN_BUFSIZ	(64 * 1024)
+
+/* --reconnect delay in milliseconds, doubled after every failure */
+#define LOGGER_BACKOFF_MIN	100
+#define LOGGER_BACKOFF_MAX	(10 * 1000)
+/* --reconnect=drop, how long to wait for a stalled server at exit */
+#define LOGGER_STALL_TIMEOUT	1000
+
+/* one message composed by prepare_output() */
+struct logger_msg {
+	struct iovec	iov[4];
+	int		iovlen;
+	char		octet[32];	/* RFC6587 octet count */
+};
+
+/* control message for local socket credentials, see init_message() */
+union logger_cmsg {
+	struct cmsghdr	cmh;
+	char		control[CMSG_SPACE(sizeof(struct ucred))];
 };
 
 /* rfc5424 structured data */
@@ -121,7 +155,21 @@ struct logger_ctl {
 	char *server;
 	char *port;
 	int socket_type;
+	struct sockaddr_storage addr;	/* address of the connected socket */
+	socklen_t addrlen;
 	size_t max_message_size;
+
+	int reconnect;			/* LOGGER_RECONNECT_* */
+	struct logger_msg *queue;	/* messages waiting for reconnect */
+	size_t queue_max;		/* --queue-size */
+	size_t queue_head;
+	size_t queue_len;
+	size_t queue_sent;		/* already sent bytes of the first message */
+	struct timeval next_connect;	/* time of the next reconnect attempt */
+	unsigned int backoff;		/* next reconnect delay in milliseconds */
+	size_t nsent;			/* --reconnect statistic */
+	size_t nqueued;
+	size_t ndropped;
 	struct list_head user_sds;	/* user defined rfc5424 structured data */
 	struct list_head reserved_sds;	/* standard rfc5424 structured data */
 
@@ -259,6 +307,8 @@ static int unix_socket(struct logger_ctl *ctl, const char *path, int *socket_typ
 			close(fd);
 			continue;
 		}
+		memcpy(&ctl->addr, &s_addr, sizeof(s_addr));
+		ctl->addrlen = sizeof(s_addr);
 		break;
 	}
 
@@ -278,7 +328,8 @@ static int unix_socket(struct logger_ctl *ctl, const char *path, int *socket_typ
 	return fd;
 }
 
-static int inet_socket(const char *servername, const char *port, int *socket_type)
+static int inet_socket(struct logger_ctl *ctl, const char *servername,
+		       const char *port, int *socket_type)
 {
 	int fd, errcode, i, type = -1;
 	struct addrinfo hints, *res;
@@ -315,6 +366,8 @@ static int inet_socket(const char *servername, const char *port, int *socket_typ
 			continue;
 		}
 
+		memcpy(&ctl->addr, res->ai_addr, res->ai_addrlen);
+		ctl->addrlen = res->ai_addrlen;
 		freeaddrinfo(res);
 		break;
 	}
@@ -420,79 +473,464 @@ static const char *rfc3164_current_time(void)
 #define iovec_memcmp(ary, idx, str, len)		\
 		memcmp((ary)[(idx) - 1].iov_base, str, len)
 
-/* writes generated buffer to desired destination. For TCP syslog,
+/* composes message for send_output(). For TCP syslog,
  * we use RFC6587 octet-stuffing (unless octet-counting is selected).
  * This is not great, but doing full blown RFC5425 (TLS) looks like
  * it is too much for the logger utility. If octet-counting is
  * selected, we use that.
+ *
+ * The 'msg' does not have to be terminated, but the header is referenced
+ * rather than copied, so it has to be valid until send_output().
  */
-static void write_output(const struct logger_ctl *ctl, const char *const msg)
+static void prepare_output(const struct logger_ctl *ctl, struct logger_msg *m,
+			   const char *msg, size_t len)
 {
-	struct iovec iov[4];
-	int iovlen = 0;
-	char *octet = NULL;
+	m->iovlen = 0;
 
 	/* 1) octen count */
 	if (ctl->octet_count) {
-		size_t len = xasprintf(&octet, "%zu ", strlen(ctl->hdr) + strlen(msg));
-		iovec_add_string(iov, iovlen, octet, len);
+		int n = snprintf(m->octet, sizeof(m->octet), "%zu ",
+				 strlen(ctl->hdr) + len);
+		iovec_add_string(m->iov, m->iovlen, m->octet, n);
 	}
 
 	/* 2) header */
-	iovec_add_string(iov, iovlen, ctl->hdr, 0);
+	iovec_add_string(m->iov, m->iovlen, ctl->hdr, 0);
 
 	/* 3) message */
-	iovec_add_string(iov, iovlen, msg, 0);
+	if (len)
+		iovec_add_string(m->iov, m->iovlen, msg, len);
+	else
+		iovec_add_string(m->iov, m->iovlen, "", 0);
 
-	if (!ctl->noact) {
-		struct msghdr message = { 0 };
-		struct cmsghdr *cmhp;
-		struct ucred *cred;
-		union {
-			struct cmsghdr cmh;
-			char   control[CMSG_SPACE(sizeof(struct ucred))];
-		} cbuf;
-
-		/* 4) add extra \n to make sure message is terminated */
-		if ((ctl->socket_type == TYPE_TCP) && !ctl->octet_count)
-			iovec_add_string(iov, iovlen, "\n", 1);
-
-		message.msg_iov = iov;
-		message.msg_iovlen = iovlen;
-
-		/* syslog/journald may follow local socket credentials rather
-		 * than in the message PID. If we use --id as root than we can
-		 * force kernel to accept another valid PID than the real logger(1)
-		 * PID.
-		 */
-		if (ctl->pid && !ctl->server && ctl->pid != getpid()
-		    && geteuid() == 0 && kill(ctl->pid, 0) == 0) {
-
-			message.msg_control = cbuf.control;
-			message.msg_controllen = CMSG_SPACE(sizeof(struct ucred));
-
-			cmhp = CMSG_FIRSTHDR(&message);
-			cmhp->cmsg_len = CMSG_LEN(sizeof(struct ucred));
-			cmhp->cmsg_level = SOL_SOCKET;
-			cmhp->cmsg_type = SCM_CREDENTIALS;
-			cred = (struct ucred *) CMSG_DATA(cmhp);
-
-			cred->pid = ctl->pid;
+	/* 4) add extra \n to make sure message is terminated */
+	if (!ctl->noact && (ctl->socket_type == TYPE_TCP) && !ctl->octet_count)
+		iovec_add_string(m->iov, m->iovlen, "\n", 1);
+}
+
+/* sends all messages by one sendmsg() to stream socket, the messages are
+ * self-delimiting (see prepare_output()). Returns number of completely
+ * sent messages, on error it's less than 'nmsgs', errno is set and the
+ * number of already sent bytes of the next message is in 'partial'.
+ *
+ * With --reconnect the socket is never blocking, the stalled server is
+ * reported by EAGAIN.
+ */
+static size_t send_stream(const struct logger_ctl *ctl, const struct msghdr *message,
+			  const struct logger_msg *msgs, size_t nmsgs, size_t *partial)
+{
+	struct iovec iov[LOGGER_BATCH_MAX * ARRAY_SIZE(msgs->iov)];
+	struct iovec *v = iov;
+	struct msghdr mh = *message;
+	int flags = ctl->reconnect ? MSG_NOSIGNAL | MSG_DONTWAIT : 0;
+	size_t i, n = 0, total = 0;
+
+	assert(nmsgs <= LOGGER_BATCH_MAX);
+
+	for (i = 0; i < nmsgs; i++) {
+		memcpy(iov + n, msgs[i].iov, msgs[i].iovlen * sizeof(struct iovec));
+		n += msgs[i].iovlen;
+	}
+
+	while (n) {
+		ssize_t sz;
+
+		mh.msg_iov = v;
+		mh.msg_iovlen = n;
+
+		sz = sendmsg(ctl->fd, &mh, flags);
+		if (sz < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		/* partial write, the credentials have been already sent */
+		mh.msg_control = NULL;
+		mh.msg_controllen = 0;
+		total += sz;
+
+		while (n && (size_t) sz >= v->iov_len) {
+			sz -= v->iov_len;
+			v++, n--;
+		}
+		if (n) {
+			v->iov_base = (char *) v->iov_base + sz;
+			v->iov_len -= sz;
 		}
+	}
+
+	if (!n)
+		return nmsgs;
+
+	/* count messages with all iovecs sent */
+	n = v - iov;
+	for (i = 0; i < nmsgs && (size_t) msgs[i].iovlen <= n; i++) {
+		int k;
+
+		n -= msgs[i].iovlen;
+		for (k = 0; k < msgs[i].iovlen; k++)
+			total -= msgs[i].iov[k].iov_len;
+	}
+	if (partial)
+		*partial = total;
+	return i;
+}
+
+/* sends every message as a datagram */
+static void send_dgram(const struct logger_ctl *ctl, struct msghdr *message,
+		       struct logger_msg *msgs, size_t nmsgs)
+{
+#ifdef HAVE_SENDMMSG
+	struct mmsghdr mm[LOGGER_BATCH_MAX];
+	size_t i;
+
+	assert(nmsgs <= ARRAY_SIZE(mm));
+
+	for (i = 0; i < nmsgs; i++) {
+		mm[i].msg_hdr = *message;
+		mm[i].msg_hdr.msg_iov = msgs[i].iov;
+		mm[i].msg_hdr.msg_iovlen = msgs[i].iovlen;
+	}
+	for (i = 0; i < nmsgs; ) {
+		int n = sendmmsg(ctl->fd, mm + i, nmsgs - i, 0);
+
+		if (n <= 0) {
+			warn(_("send message failed"));
+			n = 1;		/* skip the failed message */
+		}
+		i += n;
+	}
+#else
+	size_t i;
+
+	for (i = 0; i < nmsgs; i++) {
+		message->msg_iov = msgs[i].iov;
+		message->msg_iovlen = msgs[i].iovlen;
 
-		if (sendmsg(ctl->fd, &message, 0) < 0)
+		if (sendmsg(ctl->fd, message, 0) < 0)
 			warn(_("send message failed"));
 	}
+#endif
+}
+
+/* syslog/journald may follow local socket credentials rather
+ * than in the message PID. If we use --id as root than we can
+ * force kernel to accept another valid PID than the real logger(1)
+ * PID.
+ */
+static void init_message(const struct logger_ctl *ctl, struct msghdr *message,
+			 union logger_cmsg *cbuf)
+{
+	struct cmsghdr *cmhp;
+	struct ucred *cred;
+
+	memset(message, 0, sizeof(*message));
+
+	if (ctl->pid && !ctl->server && ctl->pid != getpid()
+	    && geteuid() == 0 && kill(ctl->pid, 0) == 0) {
+
+		message->msg_control = cbuf->control;
+		message->msg_controllen = CMSG_SPACE(sizeof(struct ucred));
+
+		cmhp = CMSG_FIRSTHDR(message);
+		cmhp->cmsg_len = CMSG_LEN(sizeof(struct ucred));
+		cmhp->cmsg_level = SOL_SOCKET;
+		cmhp->cmsg_type = SCM_CREDENTIALS;
+		cred = (struct ucred *) CMSG_DATA(cmhp);
+
+		cred->pid = ctl->pid;
+	}
+}
+
+/*
+ * --reconnect
+ *
+ * If the stream connection is lost, the messages are kept in a bounded
+ * queue and logger tries to connect to the same address again; the delay
+ * between attempts grows from LOGGER_BACKOFF_MIN to LOGGER_BACKOFF_MAX.
+ * If the queue is full, logger waits for the server or drops the new
+ * messages (--reconnect=drop).
+ *
+ * The messages are queued also when the server does not read them (the
+ * send would block), the rest of a partially sent message is the first
+ * one in the queue then (see queue_sent).
+ */
+static void schedule_reconnect(struct logger_ctl *ctl)
+{
+	struct timeval now, delay;
+
+	gettime_monotonic(&now);
+	delay.tv_sec = ctl->backoff / 1000;
+	delay.tv_usec = (ctl->backoff % 1000) * 1000;
+	timeradd(&now, &delay, &ctl->next_connect);
+
+	ctl->backoff = ctl->backoff ?
+			min(ctl->backoff * 2, (unsigned int) LOGGER_BACKOFF_MAX) :
+			LOGGER_BACKOFF_MIN;
+}
+
+static void logger_disconnect(struct logger_ctl *ctl)
+{
+	warn(_("send message failed"));
+	close(ctl->fd);
+	ctl->fd = -1;
+	ctl->queue_sent = 0;		/* send the whole message again */
+	schedule_reconnect(ctl);
+}
+
+/* returns 0 if connected; the attempt is done only when the delay expired */
+static int logger_reconnect(struct logger_ctl *ctl)
+{
+	struct timeval now;
+	int fd;
+
+	if (ctl->fd >= 0)
+		return 0;
+
+	gettime_monotonic(&now);
+	if (timercmp(&now, &ctl->next_connect, <))
+		return -1;
+
+	fd = socket(ctl->addr.ss_family, SOCK_STREAM, 0);
+	if (fd >= 0 && connect(fd, (struct sockaddr *) &ctl->addr, ctl->addrlen) == 0) {
+		ctl->fd = fd;
+		return 0;
+	}
+	if (fd >= 0)
+		close(fd);
+	schedule_reconnect(ctl);
+	return -1;
+}
+
+/* returns number of milliseconds to the next reconnect attempt */
+static int reconnect_timeout(const struct logger_ctl *ctl)
+{
+	struct timeval now, diff;
+
+	gettime_monotonic(&now);
+	if (!timercmp(&now, &ctl->next_connect, <))
+		return 0;
+	timersub(&ctl->next_connect, &now, &diff);
+	return diff.tv_sec * 1000 + (diff.tv_usec + 999) / 1000;
+}
+
+/* waits for the stalled server or for the next reconnect attempt, returns
+ * 1 if the server is ready to read more data */
+static int logger_wait(const struct logger_ctl *ctl, int timeout)
+{
+	if (ctl->fd >= 0) {
+		struct pollfd fds[] = {
+			{ .fd = ctl->fd, .events = POLLOUT }
+		};
+
+		return poll(fds, 1, timeout) > 0;
+	}
+	xusleep(reconnect_timeout(ctl) * 1000);
+	return 0;
+}
+
+static inline int is_stalled(void)
+{
+	return errno == EAGAIN || errno == EWOULDBLOCK;
+}
+
+/* copies the message to the queue, returns -1 if the queue is full */
+static int queue_add(struct logger_ctl *ctl, const struct logger_msg *m)
+{
+	struct logger_msg *q;
+	size_t sz = 0;
+	char *p;
+	int i;
+
+	if (ctl->queue_len == ctl->queue_max)
+		return -1;
+	if (!ctl->queue)
+		ctl->queue = xcalloc(ctl->queue_max, sizeof(struct logger_msg));
+
+	for (i = 0; i < m->iovlen; i++)
+		sz += m->iov[i].iov_len;
+
+	q = &ctl->queue[(ctl->queue_head + ctl->queue_len) % ctl->queue_max];
+	q->iovlen = 0;
+	p = xmalloc(sz);
+	iovec_add_string(q->iov, q->iovlen, p, sz);
+
+	for (i = 0; i < m->iovlen; i++) {
+		memcpy(p, m->iov[i].iov_base, m->iov[i].iov_len);
+		p += m->iov[i].iov_len;
+	}
+
+	ctl->queue_len++;
+	ctl->nqueued++;
+	return 0;
+}
+
+/* sends queued messages, returns 0 if the queue is empty */
+static int queue_flush(struct logger_ctl *ctl, const struct msghdr *message)
+{
+	while (ctl->queue_len) {
+		struct logger_msg *q = &ctl->queue[ctl->queue_head];
+		char *first = q->iov[0].iov_base;
+		size_t i, sent, n, partial = 0, skip = ctl->queue_sent;
+		int stalled;
+
+		n = min(ctl->queue_len, ctl->queue_max - ctl->queue_head);
+		n = min(n, (size_t) LOGGER_BATCH_MAX);
+
+		/* the rest of the partially sent message */
+		q->iov[0].iov_base = first + skip;
+		q->iov[0].iov_len -= skip;
+
+		sent = send_stream(ctl, message, q, n, &partial);
+		stalled = sent < n && is_stalled();
+
+		q->iov[0].iov_base = first;
+		q->iov[0].iov_len += skip;
+		if (sent)
+			ctl->queue_sent = 0;
+		ctl->queue_sent += partial;
+
+		for (i = 0; i < sent; i++)
+			free(q[i].iov[0].iov_base);
+
+		ctl->queue_head = (ctl->queue_head + sent) % ctl->queue_max;
+		ctl->queue_len -= sent;
+		ctl->nsent += sent;
+		if (sent)
+			ctl->backoff = 0;
+		if (sent < n) {
+			if (!stalled)
+				logger_disconnect(ctl);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/* reconnects (if necessary) and sends queued messages */
+static int logger_flush_queue(struct logger_ctl *ctl)
+{
+	struct msghdr message;
+	union logger_cmsg cbuf;
+
+	if (!ctl->queue_len)
+		return 0;
+	if (logger_reconnect(ctl) != 0)
+		return -1;
+
+	init_message(ctl, &message, &cbuf);
+	return queue_flush(ctl, &message);
+}
+
+static void send_stream_reconnect(struct logger_ctl *ctl, const struct msghdr *message,
+				  const struct logger_msg *msgs, size_t nmsgs)
+{
+	size_t done = 0;
+
+	while (done < nmsgs) {
+		if (logger_reconnect(ctl) == 0 && queue_flush(ctl, message) == 0) {
+			size_t partial = 0;
+			size_t n = send_stream(ctl, message, msgs + done,
+					       nmsgs - done, &partial);
+
+			ctl->nsent += n;
+			done += n;
+			if (n)
+				ctl->backoff = 0;
+			if (done < nmsgs && is_stalled()) {
+				/* the queue is empty, the rest of the message
+				 * is sent first when the server reads again */
+				queue_add(ctl, &msgs[done++]);
+				ctl->queue_sent = partial;
+			} else if (done < nmsgs)
+				logger_disconnect(ctl);
+			continue;
+		}
+
+		/* disconnected or stalled, keep the messages for later */
+		while (done < nmsgs && queue_add(ctl, &msgs[done]) == 0)
+			done++;
+		if (done == nmsgs)
+			break;
+
+		/* the queue is full */
+		if (ctl->reconnect == LOGGER_RECONNECT_DROP) {
+			ctl->ndropped += nmsgs - done;
+			break;
+		}
+		logger_wait(ctl, -1);
+	}
+}
+
+/* sends the rest of the queue before exit */
+static void logger_drain_queue(struct logger_ctl *ctl)
+{
+	while (logger_flush_queue(ctl) != 0) {
+		if (ctl->reconnect == LOGGER_RECONNECT_DROP) {
+			/* the stalled server is reading again */
+			if (logger_wait(ctl, LOGGER_STALL_TIMEOUT))
+				continue;
+
+			/* one more attempt, then give up */
+			timerclear(&ctl->next_connect);
+			if (logger_flush_queue(ctl) == 0)
+				break;
+
+			ctl->ndropped += ctl->queue_len;
+			while (ctl->queue_len) {
+				free(ctl->queue[ctl->queue_head].iov[0].iov_base);
+				ctl->queue_head = (ctl->queue_head + 1) % ctl->queue_max;
+				ctl->queue_len--;
+			}
+			break;
+		}
+		logger_wait(ctl, -1);
+	}
+}
+
+/* writes messages composed by prepare_output() to desired destination */
+static void send_output(struct logger_ctl *ctl,
+			struct logger_msg *msgs, size_t nmsgs)
+{
+	size_t i;
+
+	if (!nmsgs)
+		return;
+
+	if (!ctl->noact) {
+		struct msghdr message;
+		union logger_cmsg cbuf;
+
+		init_message(ctl, &message, &cbuf);
+
+		if (ctl->socket_type == TYPE_TCP && ctl->reconnect)
+			send_stream_reconnect(ctl, &message, msgs, nmsgs);
+		else if (ctl->socket_type == TYPE_TCP) {
+			if (send_stream(ctl, &message, msgs, nmsgs, NULL) < nmsgs)
+				warn(_("send message failed"));
+		} else
+			send_dgram(ctl, &message, msgs, nmsgs);
+	}
 
 	if (ctl->stderr_printout) {
-		/* make sure it's terminated for stderr */
-		if (iovec_memcmp(iov, iovlen, "\n", 1) != 0)
-			iovec_add_string(iov, iovlen, "\n", 1);
+		for (i = 0; i < nmsgs; i++) {
+			struct logger_msg *m = &msgs[i];
+
+			/* make sure it's terminated for stderr */
+			if (iovec_memcmp(m->iov, m->iovlen, "\n", 1) != 0)
+				iovec_add_string(m->iov, m->iovlen, "\n", 1);
 
-		ignore_result( writev(STDERR_FILENO, iov, iovlen) );
+			ignore_result( writev(STDERR_FILENO, m->iov, m->iovlen) );
+		}
 	}
+}
 
-	free(octet);
+static void write_output(struct logger_ctl *ctl, const char *const msg)
+{
+	struct logger_msg m;
+
+	prepare_output(ctl, &m, msg, strlen(msg));
+	send_output(ctl, &m, 1);
 }
 
 #define NILVALUE "-"
@@ -854,7 +1292,7 @@ static void generate_syslog_header(struct logger_ctl *const ctl)
 static void logger_open(struct logger_ctl *ctl)
 {
 	if (ctl->server) {
-		ctl->fd = inet_socket(ctl->server, ctl->port, &ctl->socket_type);
+		ctl->fd = inet_socket(ctl, ctl->server, ctl->port, &ctl->socket_type);
 		if (!ctl->syslogfp)
 			ctl->syslogfp = syslog_rfc5424_header;
 	} else {
@@ -867,10 +1305,14 @@ static void logger_open(struct logger_ctl *ctl)
 	}
 	if (!ctl->tag)
 		ctl->tag = xgetlogin();
+	if (ctl->reconnect && ctl->fd >= 0 && ctl->socket_type != TYPE_TCP) {
+		warnx(_("--reconnect is supported for stream connections only"));
+		ctl->reconnect = LOGGER_RECONNECT_NONE;
+	}
 	generate_syslog_header(ctl);
 }
 
-static void logger_command_line(const struct logger_ctl *ctl, char **argv)
+static void logger_command_line(struct logger_ctl *ctl, char **argv)
 {
 	/* note: we never re-generate the syslog header here, even if we
 	 * generate multiple messages. If so, we think it is the right thing
@@ -903,63 +1345,125 @@ static void logger_command_line(const struct logger_ctl *ctl, char **argv)
 	free(buf);
 }
 
+/*
+ * Reads stdin by large blocks. The messages are not copied, they are
+ * composed from the input buffer and sent in batches; the batch is sent
+ * before the buffer is reused or the header is regenerated.
+ */
 static void logger_stdin(struct logger_ctl *ctl)
 {
 	int default_priority = ctl->pri;
 	int last_pri = default_priority;
 	size_t max_usrmsg_size = ctl->max_message_size - strlen(ctl->hdr);
-	char *const buf = xmalloc(max_usrmsg_size + 2 + 2);
-	int pri;
-	int c;
-	size_t i;
-
-	c = getchar();
-	while (c != EOF) {
-		i = 0;
-		if (ctl->prio_prefix) {
-			if (c == '<') {
-				pri = 0;
-				buf[i++] = c;
-				while (isdigit(c = getchar()) && pri <= 191) {
-					buf[i++] = c;
-					pri = pri * 10 + c - '0';
-				}
-				if (c != EOF && c != '\n')
-					buf[i++] = c;
-				if (c == '>' && 0 <= pri && pri <= 191) { /* valid RFC PRI values */
-					i = 0;
-					if (pri < 8)
-						pri |= 8; /* kern facility is forbidden */
-					ctl->pri = pri;
-				} else
-					ctl->pri = default_priority;
-
-				if (ctl->pri != last_pri) {
-					generate_syslog_header(ctl);
-					max_usrmsg_size = ctl->max_message_size - strlen(ctl->hdr);
-					last_pri = ctl->pri;
-				}
-				if (c != EOF && c != '\n')
-					c = getchar();
+	/* the longest message with <PRI> prefix and the line terminator */
+	size_t minsz = ctl->max_message_size + 8;
+	size_t bufsz = max(minsz, (size_t) LOGGER_STDIN_BUFSIZ);
+	char *const buf = xmalloc(bufsz);
+	struct logger_msg *msgs = xcalloc(LOGGER_BATCH_MAX, sizeof(*msgs));
+	size_t nmsgs = 0, off = 0, len = 0;
+	int eof = 0;
+
+	while (off < len || !eof) {
+		char *p = buf + off, *end = buf + len, *eol, *msg;
+		size_t i;
+
+		eol = memchr(p, '\n', end - p);
+		if (!eol && !eof && (size_t) (end - p) < minsz) {
+			/* read more data, the messages point to the buffer */
+			ssize_t sz;
+
+			send_output(ctl, msgs, nmsgs);
+			nmsgs = 0;
+
+			memmove(buf, p, end - p);
+			len = end - p;
+			off = 0;
+
+			/* --reconnect: try to send the queue while waiting for input */
+			while (ctl->queue_len) {
+				struct pollfd fds[] = {
+					{ .fd = STDIN_FILENO, .events = POLLIN },
+					{ .fd = ctl->fd, .events = POLLOUT }
+				};
+				int timeout = ctl->fd >= 0 ? -1 : reconnect_timeout(ctl);
+
+				if (poll(fds, ARRAY_SIZE(fds), timeout) < 0
+				    || fds[0].revents)
+					break;
+				logger_flush_queue(ctl);
 			}
+
+			sz = read(STDIN_FILENO, buf + len, bufsz - len);
+			if (sz < 0 && errno == EINTR)
+				continue;
+			if (sz <= 0)
+				eof = 1;
+			else
+				len += sz;
+			continue;
 		}
+		if (!eol)
+			eol = end;
+		msg = p;
+
+		if (ctl->prio_prefix && p < eol && *p == '<') {
+			int pri = 0;
+
+			while (++p < eol && isdigit((unsigned char) *p) && pri <= 191)
+				pri = pri * 10 + *p - '0';
 
-		while (c != EOF && c != '\n' && i < max_usrmsg_size) {
-			buf[i++] = c;
-			c = getchar();
+			if (p < eol && *p == '>' && 0 <= pri && pri <= 191) { /* valid RFC PRI values */
+				msg = p + 1;
+				if (pri < 8)
+					pri |= 8; /* kern facility is forbidden */
+				ctl->pri = pri;
+			} else
+				ctl->pri = default_priority;
+
+			if (ctl->pri != last_pri) {
+				send_output(ctl, msgs, nmsgs);
+				nmsgs = 0;
+				generate_syslog_header(ctl);
+				max_usrmsg_size = ctl->max_message_size - strlen(ctl->hdr);
+				last_pri = ctl->pri;
+			}
+			if (p < eol)
+				p++;
 		}
-		buf[i] = '\0';
 
-		if (i > 0 || !ctl->skip_empty_lines)
-			write_output(ctl, buf);
+		/* the invalid <PRI> prefix is part of the message */
+		i = p - msg;
+		if (i < max_usrmsg_size)
+			p += min((size_t) (eol - p), max_usrmsg_size - i);
+
+		/* the message is terminated by the first zero byte */
+		if (p > msg || !ctl->skip_empty_lines) {
+			prepare_output(ctl, &msgs[nmsgs++], msg, strnlen(msg, p - msg));
+			if (nmsgs == LOGGER_BATCH_MAX) {
+				send_output(ctl, msgs, nmsgs);
+				nmsgs = 0;
+			}
+		}
 
-		if (c == '\n')	/* discard line terminator */
-			c = getchar();
+		if (p < end && *p == '\n')	/* discard line terminator */
+			p++;
+		off = p - buf;
 	}
+
+	send_output(ctl, msgs, nmsgs);
+	free(msgs);
+	free(buf);
 }
 
-static void logger_close(const struct logger_ctl *ctl)
+static void logger_close(struct logger_ctl *ctl)
 {
+	if (ctl->reconnect) {
+		logger_drain_queue(ctl);
+		if (ctl->nqueued)
+			warnx(_("messages sent: %zu, queued: %zu, dropped: %zu"),
+			      ctl->nsent, ctl->nqueued, ctl->ndropped);
+		free(ctl->queue);
+	}
 	if (ctl->fd != -1 && close(ctl->fd) != 0)
 		err(EXIT_FAILURE, _("close failed"));
 	free(ctl->hdr);
@@ -989,6 +1493,9 @@ static void __attribute__ ((__noreturn__)) usage(FILE *out)
 	fputs(_(" -P, --port <number>      use this UDP port\n"), out);
 	fputs(_(" -T, --tcp                use TCP only\n"), out);
 	fputs(_(" -d, --udp                use UDP only\n"), out);
+	fputs(_("     --reconnect[=<block|drop>]\n"
+		"                          reconnect the lost stream connection\n"), out);
+	fputs(_("     --queue-size <num>   messages kept while reconnecting\n"), out);
 	fputs(_("     --rfc3164            use the obsolete BSD syslog protocol\n"), out);
 	fputs(_("     --rfc5424[=<snip>]   use the syslog protocol (the default for remote);\n"
 		"                            <snip> can be notime, or notq, and/or nohost\n"), out);
@@ -1035,7 +1542,8 @@ int main(int argc, char **argv)
 		.rfc5424_time = 1,
 		.rfc5424_tq = 1,
 		.rfc5424_host = 1,
-		.skip_empty_lines = 0
+		.skip_empty_lines = 0,
+		.queue_max = 1000
 	};
 	int ch;
 	int stdout_reopened = 0;
@@ -1067,6 +1575,8 @@ int main(int argc, char **argv)
 		{ "skip-empty",	   no_argument,	      0, 'e'		   },
 		{ "sd-id",         required_argument, 0, OPT_STRUCTURED_DATA_ID          },
 		{ "sd-param",      required_argument, 0, OPT_STRUCTURED_DATA_PARAM       },
+		{ "reconnect",     optional_argument, 0, OPT_RECONNECT     },
+		{ "queue-size",    required_argument, 0, OPT_QUEUE_SIZE    },
 #ifdef HAVE_LIBSYSTEMD
 		{ "journald",	   optional_argument, 0, OPT_JOURNALD	   },
 #endif
@@ -1174,6 +1684,20 @@ int main(int argc, char **argv)
 		case OPT_NOACT:
 			ctl.noact = 1;
 			break;
+		case OPT_RECONNECT:
+			if (!optarg || !strcmp(optarg, "block"))
+				ctl.reconnect = LOGGER_RECONNECT_BLOCK;
+			else if (!strcmp(optarg, "drop"))
+				ctl.reconnect = LOGGER_RECONNECT_DROP;
+			else
+				errx(EXIT_FAILURE, _("unsupported reconnect policy: %s"), optarg);
+			break;
+		case OPT_QUEUE_SIZE:
+			ctl.queue_max = strtou32_or_err(optarg,
+				_("failed to parse queue size"));
+			if (!ctl.queue_max)
+				errx(EXIT_FAILURE, _("invalid queue size"));
+			break;
 		case OPT_STRUCTURED_DATA_ID:
 			if (!valid_structured_data_id(optarg))
 				errx(EXIT_FAILURE, _("invalid structured data ID: '%s'"), optarg);
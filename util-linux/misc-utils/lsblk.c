@@ -247,6 +247,19 @@ static size_t nincludes;
 static struct libmnt_table *mtab, *swaps;
 static struct libmnt_cache *mntcache;
 
+/*
+ * mtab source paths index, see index_mtab()
+ */
+struct mntsrc {
+	const char	*path;		/* source path */
+	struct libmnt_fs *fs;
+	size_t		pos;		/* position in mtab (1..N) */
+	unsigned int	canonical : 1;	/* canonicalized source path */
+};
+
+static struct mntsrc *mntsrcs;
+static size_t nmntsrcs;
+
 #ifdef HAVE_LIBUDEV
 struct udev *udev;
 #endif
@@ -453,6 +466,175 @@ static int is_active_swap(const char *filename)
 	return mnt_table_find_srcpath(swaps, filename, MNT_ITER_BACKWARD) != 0;
 }
 
+static int cmp_mntsrc(const void *a, const void *b)
+{
+	const struct mntsrc *x = (const struct mntsrc *) a,
+			    *y = (const struct mntsrc *) b;
+	int rc = strcmp(x->path, y->path);
+
+	if (rc)
+		return rc;
+	if (x->canonical != y->canonical)
+		return x->canonical ? 1 : -1;
+	return x->pos < y->pos ? -1 : x->pos > y->pos;
+}
+
+/*
+ * Sorts native and canonicalized source paths of all mtab entries, so the
+ * lookups by device path don't have to walk (and canonicalize) the whole
+ * table for every device. The entries remember their mtab position in
+ * the userdata.
+ *
+ * The index is not used for tables with tags (LABEL=, UUID=, ...), these
+ * are possible in a regular /etc/mtab only.
+ */
+static void index_mtab(void)
+{
+	struct libmnt_iter *itr;
+	struct libmnt_fs *fs;
+	size_t pos = 0;
+
+	if (!mntcache || !(itr = mnt_new_iter(MNT_ITER_FORWARD)))
+		return;
+
+	mntsrcs = xcalloc(2 * mnt_table_get_nents(mtab) + 1, sizeof(struct mntsrc));
+
+	while (mnt_table_next_fs(mtab, itr, &fs) == 0) {
+		const char *src = mnt_fs_get_srcpath(fs), *cn;
+
+		if (mnt_fs_get_tag(fs, NULL, NULL) == 0) {
+			free(mntsrcs);
+			mntsrcs = NULL;
+			nmntsrcs = 0;
+			break;
+		}
+		mnt_fs_set_userdata(fs, (void *) (uintptr_t) ++pos);
+		if (!src)
+			continue;
+
+		mntsrcs[nmntsrcs++] = (struct mntsrc) { .path = src, .fs = fs, .pos = pos };
+
+		/* mnt_fs_match_source() does not canonicalize these */
+		if (mnt_fs_is_netfs(fs) || mnt_fs_is_pseudofs(fs))
+			continue;
+		cn = mnt_resolve_path(src, mntcache);
+		if (cn)
+			mntsrcs[nmntsrcs++] = (struct mntsrc) {
+					.path = cn, .fs = fs, .pos = pos, .canonical = 1 };
+	}
+	mnt_free_iter(itr);
+
+	if (mntsrcs)
+		qsort(mntsrcs, nmntsrcs, sizeof(struct mntsrc), cmp_mntsrc);
+
+	DBG(DEV, ul_debug("mtab: %zu entries, %zu indexed paths", pos, nmntsrcs));
+}
+
+/*
+ * Returns the last mtab entry with @path source, the entry has to be
+ * before @maxpos (inclusive) and optionally mounted from the FS root.
+ */
+static struct libmnt_fs *find_mntsrc(const char *path, int canonical,
+				     size_t maxpos, int fsroot)
+{
+	struct mntsrc key = { .path = path, .canonical = canonical };
+	size_t lo = 0, hi = nmntsrcs;
+
+	/* the first entry not less than the key */
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+
+		if (cmp_mntsrc(&mntsrcs[mid], &key) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	/* the end of the entries with the same path */
+	for (hi = lo; hi < nmntsrcs; hi++) {
+		struct mntsrc *m = &mntsrcs[hi];
+
+		if (m->canonical != canonical || strcmp(m->path, path) != 0
+		    || m->pos > maxpos)
+			break;
+	}
+	while (hi-- > lo) {
+		struct libmnt_fs *fs = mntsrcs[hi].fs;
+		const char *root = mnt_fs_get_root(fs);
+
+		if (!fsroot || !root || strcmp(root, "/") == 0)
+			return fs;
+	}
+	return NULL;
+}
+
+static inline size_t mntsrc_pos(struct libmnt_fs *fs)
+{
+	return fs ? (uintptr_t) mnt_fs_get_userdata(fs) : 0;
+}
+
+/* the same as mnt_table_find_srcpath(mtab, path, MNT_ITER_BACKWARD) */
+static struct libmnt_fs *find_mtab_srcpath(const char *path)
+{
+	struct libmnt_fs *fs;
+	const char *cn;
+
+	if (!mntsrcs)
+		return mnt_table_find_srcpath(mtab, path, MNT_ITER_BACKWARD);
+
+	fs = find_mntsrc(path, 0, SIZE_MAX, 0);
+	if (fs || !(cn = mnt_resolve_path(path, mntcache)))
+		return fs;
+
+	fs = find_mntsrc(cn, 0, SIZE_MAX, 0);
+	if (!fs)
+		fs = find_mntsrc(cn, 1, SIZE_MAX, 0);
+	return fs;
+}
+
+/*
+ * Returns the last entry before @fs (inclusive) mounted from the FS root and
+ * mnt_fs_match_source(path) or NULL.
+ */
+static struct libmnt_fs *find_mtab_fsroot(struct libmnt_fs *fs, const char *path)
+{
+	struct libmnt_fs *rfs = NULL, *x;
+	size_t pos = mntsrc_pos(fs);
+	const char *cn;
+
+	if (!mntsrcs) {
+		struct libmnt_iter *itr = mnt_new_iter(MNT_ITER_BACKWARD);
+		const char *fsroot;
+
+		if (!itr)
+			return NULL;
+		mnt_table_set_iter(mtab, itr, fs);
+		while (mnt_table_next_fs(mtab, itr, &x) == 0) {
+			fsroot = mnt_fs_get_root(x);
+			if ((!fsroot || strcmp(fsroot, "/") == 0)
+			    && mnt_fs_match_source(x, path, mntcache)) {
+				rfs = x;
+				break;
+			}
+		}
+		mnt_free_iter(itr);
+		return rfs;
+	}
+
+	rfs = find_mntsrc(path, 0, pos, 1);
+
+	cn = mnt_resolve_path(path, mntcache);
+	if (cn) {
+		x = find_mntsrc(cn, 0, pos, 1);
+		if (x && mntsrc_pos(x) > mntsrc_pos(rfs)
+		    && !mnt_fs_is_netfs(x) && !mnt_fs_is_pseudofs(x))
+			rfs = x;
+		x = find_mntsrc(cn, 1, pos, 1);
+		if (x && mntsrc_pos(x) > mntsrc_pos(rfs))
+			rfs = x;
+	}
+	return rfs;
+}
+
 static char *get_device_mountpoint(struct blkdev_cxt *cxt)
 {
 	struct libmnt_fs *fs;
@@ -471,6 +653,7 @@ static char *get_device_mountpoint(struct blkdev_cxt *cxt)
 		mnt_table_set_parser_errcb(mtab, table_parser_errcb);
 		mnt_table_set_cache(mtab, mntcache);
 		mnt_table_parse_mtab(mtab, NULL);
+		index_mtab();
 	}
 
 	/* Note that maj:min in /proc/self/mouninfo does not have to match with
@@ -478,7 +661,7 @@ static char *get_device_mountpoint(struct blkdev_cxt *cxt)
 	 */
 	fs = mnt_table_find_devno(mtab, makedev(cxt->maj, cxt->min), MNT_ITER_BACKWARD);
 	if (!fs)
-		fs = mnt_table_find_srcpath(mtab, cxt->filename, MNT_ITER_BACKWARD);
+		fs = find_mtab_srcpath(cxt->filename);
 	if (!fs)
 		return is_active_swap(cxt->filename) ? xstrdup("[SWAP]") : NULL;
 
@@ -487,19 +670,10 @@ static char *get_device_mountpoint(struct blkdev_cxt *cxt)
 	if (fsroot && strcmp(fsroot, "/") != 0) {
 		/* hmm.. we found bind mount or btrfs subvolume, let's try to
 		 * get real FS root mountpoint */
-		struct libmnt_fs *rfs;
-		struct libmnt_iter *itr = mnt_new_iter(MNT_ITER_BACKWARD);
+		struct libmnt_fs *rfs = find_mtab_fsroot(fs, cxt->filename);
 
-		mnt_table_set_iter(mtab, itr, fs);
-		while (mnt_table_next_fs(mtab, itr, &rfs) == 0) {
-			fsroot = mnt_fs_get_root(rfs);
-			if ((!fsroot || strcmp(fsroot, "/") == 0)
-			    && mnt_fs_match_source(rfs, cxt->filename, mntcache)) {
-				fs = rfs;
-				break;
-			}
-		}
-		mnt_free_iter(itr);
+		if (rfs)
+			fs = rfs;
 	}
 
 	DBG(DEV, ul_debugobj(cxt, "mountpoint: %s", mnt_fs_get_target(fs)));
@@ -1197,6 +1371,8 @@ static int set_cxt(struct blkdev_cxt *cxt,
 			return -1;
 		}
 	}
+	/* the columns read the same attributes more than once */
+	sysfs_enable_cache(&cxt->sysfs);
 
 	cxt->maj = major(devno);
 	cxt->min = minor(devno);
@@ -1923,6 +2099,7 @@ leave:
 
 	scols_unref_table(lsblk->table);
 
+	free(mntsrcs);
 	mnt_unref_table(mtab);
 	mnt_unref_table(swaps);
 	mnt_unref_cache(mntcache);
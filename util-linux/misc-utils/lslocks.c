@@ -28,6 +28,7 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <dirent.h>
+#include <search.h>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -111,6 +112,26 @@ struct lock {
 	int id;
 };
 
+/* open file descriptor of a process holding a lock */
+struct proc_fd {
+	ino_t inode;
+	off_t size;
+	size_t idx;		/* readdir() order */
+	int fd;
+	char *path;		/* readlink() result */
+	unsigned int resolved :1;
+};
+
+struct proc {
+	pid_t pid;
+	char *cmdname;
+	struct proc_fd *fds;	/* sorted by inode */
+	size_t nfds;
+};
+
+static void *proctree;		/* struct proc by PID */
+static void *locktree;		/* not blocked struct lock by ID */
+
 static void disable_columns_truncate(void)
 {
 	size_t i;
@@ -140,63 +161,168 @@ static char *get_fallback_filename(dev_t dev)
 }
 
 /*
- * Return the absolute path of a file from
- * a given inode number (and its size)
+ * For tests we want to be able to read locks from a file
  */
-static char *get_filename_sz(ino_t inode, pid_t lock_pid, size_t *size)
+#ifdef TEST_LSLOCKS
+static inline const char *lslocks_get_locks_path(void)
+{
+	char *str = getenv("LSLOCKS_TEST_PROC_LOCKS");
+	return str ? str : _PATH_PROC_LOCKS;
+}
+#else
+# define lslocks_get_locks_path()	_PATH_PROC_LOCKS
+#endif
+
+static int cmp_proc(const void *a, const void *b)
+{
+	pid_t x = ((const struct proc *) a)->pid,
+	      y = ((const struct proc *) b)->pid;
+
+	return x < y ? -1 : x > y;
+}
+
+static int cmp_proc_fd(const void *a, const void *b)
+{
+	const struct proc_fd *x = a, *y = b;
+
+	if (x->inode != y->inode)
+		return x->inode < y->inode ? -1 : 1;
+	return x->idx < y->idx ? -1 : x->idx > y->idx;
+}
+
+/*
+ * Read all descriptors of the process, the array is sorted by inode
+ * numbers and for the same inode by the readdir() order.
+ */
+static void read_proc_fds(struct proc *pr)
 {
 	struct stat sb;
 	struct dirent *dp;
 	DIR *dirp;
-	size_t len;
+	size_t nalloc = 0;
 	int fd;
-	char path[PATH_MAX], sym[PATH_MAX], *ret = NULL;
-
-	*size = 0;
-	memset(path, 0, sizeof(path));
-	memset(sym, 0, sizeof(sym));
+	char path[PATH_MAX];
 
 	/*
 	 * We know the pid so we don't have to
 	 * iterate the *entire* filesystem searching
 	 * for the damn file.
 	 */
-	sprintf(path, "/proc/%d/fd/", lock_pid);
+	snprintf(path, sizeof(path), "/proc/%d/fd/", pr->pid);
 	if (!(dirp = opendir(path)))
-		return NULL;
-
-	if ((len = strlen(path)) >= (sizeof(path) - 2))
-		goto out;
+		return;
 
 	if ((fd = dirfd(dirp)) < 0 )
 		goto out;
 
 	while ((dp = readdir(dirp))) {
-		if (!strcmp(dp->d_name, ".") ||
-		    !strcmp(dp->d_name, ".."))
-			continue;
+		struct proc_fd *pf;
+		int num;
 
 		/* care only for numerical descriptors */
-		if (!strtol(dp->d_name, (char **) NULL, 10))
+		num = strtol(dp->d_name, (char **) NULL, 10);
+		if (!num)
 			continue;
 
-		if (!fstat_at(fd, path, dp->d_name, &sb, 0)
-		    && inode != sb.st_ino)
+		if (fstat_at(fd, path, dp->d_name, &sb, 0))
 			continue;
 
-		if ((len = readlink_at(fd, path, dp->d_name,
-				       sym, sizeof(sym) - 1)) < 1)
-			goto out;
-
-		*size = sb.st_size;
-		sym[len] = '\0';
-
-		ret = xstrdup(sym);
-		break;
+		if (pr->nfds == nalloc) {
+			nalloc = nalloc ? nalloc * 2 : 16;
+			pr->fds = xrealloc(pr->fds, nalloc * sizeof(struct proc_fd));
+		}
+		pf = &pr->fds[pr->nfds];
+		memset(pf, 0, sizeof(*pf));
+		pf->inode = sb.st_ino;
+		pf->size = sb.st_size;
+		pf->fd = num;
+		pf->idx = pr->nfds++;
 	}
+
+	if (pr->nfds > 1)
+		qsort(pr->fds, pr->nfds, sizeof(struct proc_fd), cmp_proc_fd);
 out:
 	closedir(dirp);
-	return ret;
+}
+
+/*
+ * Return the process from the cache, /proc/<pid>/{comm,fd} are
+ * read only once for every process.
+ */
+static struct proc *get_proc(pid_t lock_pid)
+{
+	struct proc key = { .pid = lock_pid }, *pr;
+	void **p;
+
+	p = tfind(&key, &proctree, cmp_proc);
+	if (p)
+		return *p;
+
+	pr = xcalloc(1, sizeof(*pr));
+	pr->pid = lock_pid;
+	pr->cmdname = proc_get_command_name(lock_pid);
+	read_proc_fds(pr);
+
+	if (!tsearch(pr, &proctree, cmp_proc))
+		err(EXIT_FAILURE, _("failed to allocate memory"));
+	return pr;
+}
+
+static void free_proc(void *data)
+{
+	struct proc *pr = data;
+	size_t i;
+
+	for (i = 0; i < pr->nfds; i++)
+		free(pr->fds[i].path);
+	free(pr->fds);
+	free(pr->cmdname);
+	free(pr);
+}
+
+/*
+ * Return the absolute path of a file from
+ * a given inode number (and its size)
+ */
+static char *get_filename_sz(ino_t inode, pid_t lock_pid, size_t *size)
+{
+	struct proc *pr = get_proc(lock_pid);
+	struct proc_fd *pf = NULL;
+	size_t lo = 0, hi = pr->nfds;
+
+	*size = 0;
+
+	/* the first descriptor (in readdir() order) with the inode */
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+
+		if (pr->fds[mid].inode < inode)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo < pr->nfds && pr->fds[lo].inode == inode)
+		pf = &pr->fds[lo];
+	if (!pf)
+		return NULL;
+
+	if (!pf->resolved) {
+		char path[PATH_MAX], sym[PATH_MAX];
+		ssize_t len;
+
+		snprintf(path, sizeof(path), "/proc/%d/fd/%d", lock_pid, pf->fd);
+		len = readlink(path, sym, sizeof(sym) - 1);
+		if (len > 0) {
+			sym[len] = '\0';
+			pf->path = xstrdup(sym);
+		}
+		pf->resolved = 1;
+	}
+	if (!pf->path)
+		return NULL;
+
+	*size = pf->size;
+	return xstrdup(pf->path);
 }
 
 /*
@@ -213,17 +339,25 @@ static ino_t get_dev_inode(char *str, dev_t *dev)
 	return inum;
 }
 
+static int cmp_lock_id(const void *a, const void *b)
+{
+	int x = ((const struct lock *) a)->id,
+	    y = ((const struct lock *) b)->id;
+
+	return x < y ? -1 : x > y;
+}
+
 static int get_local_locks(struct list_head *locks)
 {
 	int i;
 	ino_t inode = 0;
 	FILE *fp;
-	char buf[PATH_MAX], *szstr = NULL, *tok = NULL;
+	char buf[PATH_MAX], *tok = NULL, *cmdname;
 	size_t sz;
 	struct lock *l;
 	dev_t dev = 0;
 
-	if (!(fp = fopen(_PATH_PROC_LOCKS, "r")))
+	if (!(fp = fopen(lslocks_get_locks_path(), "r")))
 		return -1;
 
 	while (fgets(buf, sizeof(buf), fp)) {
@@ -264,9 +398,6 @@ static int get_local_locks(struct list_head *locks)
 				 * to the list, no need to worry now.
 				 */
 				l->pid = strtos32_or_err(tok, _("failed to parse pid"));
-				l->cmdname = proc_get_command_name(l->pid);
-				if (!l->cmdname)
-					l->cmdname = xstrdup(_("(unknown)"));
 				break;
 
 			case 5: /* device major:minor and inode number */
@@ -287,19 +418,35 @@ static int get_local_locks(struct list_head *locks)
 			default:
 				break;
 			}
+		}
 
-			l->path = get_filename_sz(inode, l->pid, &sz);
-			if (!l->path)
-				/* probably no permission to peek into l->pid's path */
-				l->path = get_fallback_filename(dev);
+		/*
+		 * The last not blocked lock with the ID is the blocker,
+		 * see get_blocker().
+		 */
+		if (!l->blocked) {
+			void **p = tsearch(l, &locktree, cmp_lock_id);
 
-			/* avoid leaking */
-			szstr = size_to_human_string(SIZE_SUFFIX_1LETTER, sz);
-			l->size = xstrdup(szstr);
-			free(szstr);
+			if (!p)
+				err(EXIT_FAILURE, _("failed to allocate memory"));
+			*p = l;
 		}
 
 		list_add(&l->locks, locks);
+
+		/* filtered out, only ID and PID are necessary for blockers */
+		if (pid && pid != l->pid)
+			continue;
+
+		cmdname = get_proc(l->pid)->cmdname;
+		l->cmdname = xstrdup(cmdname ? cmdname : _("(unknown)"));
+
+		l->path = get_filename_sz(inode, l->pid, &sz);
+		if (!l->path)
+			/* probably no permission to peek into l->pid's path */
+			l->path = get_fallback_filename(dev);
+
+		l->size = size_to_human_string(SIZE_SUFFIX_1LETTER, sz);
 	}
 
 	fclose(fp);
@@ -351,21 +498,19 @@ static void rem_lock(struct lock *lock)
 	free(lock);
 }
 
-static pid_t get_blocker(int id, struct list_head *locks)
+static pid_t get_blocker(int id)
 {
-	struct list_head *p;
-
-	list_for_each(p, locks) {
-		struct lock *l = list_entry(p, struct lock, locks);
+	struct lock key = { .id = id };
+	void **p = tfind(&key, &locktree, cmp_lock_id);
 
-		if (l->id == id && !l->blocked)
-			return l->pid;
-	}
+	return p ? ((struct lock *) *p)->pid : 0;
+}
 
-	return 0;
+static void free_nothing(void *data __attribute__((__unused__)))
+{
 }
 
-static void add_scols_line(struct libscols_table *table, struct lock *l, struct list_head *locks)
+static void add_scols_line(struct libscols_table *table, struct lock *l)
 {
 	size_t i;
 	struct libscols_line *line;
@@ -419,7 +564,7 @@ static void add_scols_line(struct libscols_table *table, struct lock *l, struct
 		case COL_BLOCKER:
 		{
 			pid_t bl = l->blocked && l->id ?
-						get_blocker(l->id, locks) : 0;
+						get_blocker(l->id) : 0;
 			if (bl)
 				xasprintf(&str, "%d", (int) bl);
 		}
@@ -468,7 +613,7 @@ static int show_locks(struct list_head *locks)
 		if (pid && pid != l->pid)
 			continue;
 
-		add_scols_line(table, l, locks);
+		add_scols_line(table, l);
 	}
 
 	/* destroy the list */
@@ -607,5 +752,7 @@ int main(int argc, char *argv[])
 		rc = show_locks(&locks);
 
 	mnt_unref_table(tab);
+	tdestroy(locktree, free_nothing);
+	tdestroy(proctree, free_proc);
 	return rc;
 }
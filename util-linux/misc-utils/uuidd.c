@@ -23,7 +23,9 @@
 #include <string.h>
 #include <getopt.h>
 #include <sys/signalfd.h>
-#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <time.h>
 
 #include "uuid.h"
 #include "uuidd.h"
@@ -34,6 +36,7 @@
 #include "optutils.h"
 #include "monotonic.h"
 #include "timer.h"
+#include "xalloc.h"
 
 #ifdef HAVE_LIBSYSTEMD
 # include <systemd/sd-daemon.h>
@@ -53,15 +56,78 @@
 /* length of binary representation of UUID */
 #define UUID_LEN	(sizeof(uuid_t))
 
+/* max number of UUIDs in one bulk reply */
+#define UUIDD_MAX_BULK		(1024 * 1024)
+
+/* max number of requests served in one batch */
+#define UUIDD_MAX_BATCH		1024
+
+/* random UUIDs of a bulk reply are generated by chunks of this size */
+#define UUIDD_RANDOM_CHUNK	1024
+
+/* don't read more requests from a client with so much unsent output */
+#define UUIDD_CONN_OUTMAX	(64 * 1024)
+
+/* out of descriptors, don't accept new clients for so many milliseconds */
+#define UUIDD_ACCEPT_BACKOFF	100
+
+/* client connection */
+struct uuidd_conn {
+	int		fd;
+	uint32_t	events;		/* registered epoll events */
+
+	char		in[1024];	/* not yet served requests */
+	size_t		inlen;
+
+	char		*out;		/* not yet sent replies */
+	size_t		outpos;
+	size_t		outlen;
+	size_t		outsz;
+
+	int		random_pending;	/* bulk random UUIDs still to generate */
+
+	struct uuidd_conn *next;	/* in the ready list */
+
+	unsigned int	eof : 1,	/* client closed its side */
+			dead : 1,	/* error, close the connection */
+			ready : 1;	/* in the ready list */
+};
+
+/* request parsed from a client */
+struct uuidd_req {
+	struct uuidd_conn	*conn;
+	char			op;
+	int			num;
+};
+
 /* server loop control structure */
 struct uuidd_cxt_t {
 	const char	*cleanup_pidfile;
 	const char	*cleanup_socket;
 	uint32_t	timeout;
+
+	int		epollfd;
+	int		sockfd;		/* listening socket */
+	struct timeval	accept_resume;	/* accept paused until, see accept_conns() */
+	struct uuidd_conn **conns;	/* connections indexed by fd */
+	size_t		nconns;
+	struct uuidd_conn *ready;	/* connections with work to do */
+
+	struct uuidd_req reqs[UUIDD_MAX_BATCH];
+	size_t		nreqs;
+	int		nticks;		/* time UUIDs needed by reqs[] */
+
+	struct uuidd_ring *ring;	/* shared memory ring or NULL */
+	uint32_t	ring_tail;	/* next slot to fill */
+	const char	*ring_path;	/* --ring file or NULL */
+	const char	*cleanup_ring;
+
 	unsigned int	debug: 1,
 			quiet: 1,
 			no_fork: 1,
-			no_sock: 1;
+			no_sock: 1,
+			accept_paused: 1,
+			accept_failed: 1;	/* warned about accept() */
 };
 
 static void __attribute__ ((__noreturn__)) usage(FILE * out)
@@ -81,6 +147,7 @@ static void __attribute__ ((__noreturn__)) usage(FILE * out)
 	fputs(_(" -P, --no-pid            do not create pid file\n"), out);
 	fputs(_(" -F, --no-fork           do not daemonize using double-fork\n"), out);
 	fputs(_(" -S, --socket-activation do not create listening socket\n"), out);
+	fputs(_(" -R, --ring[=<file>]     publish time-based uuids in shared memory\n"), out);
 	fputs(_(" -d, --debug             run in debugging mode\n"), out);
 	fputs(_(" -q, --quiet             turn on quiet mode\n"), out);
 	fputs(USAGE_SEPARATOR, out);
@@ -283,6 +350,10 @@ static void __attribute__((__noreturn__)) all_done(const struct uuidd_cxt_t *uui
 		unlink(uuidd_cxt->cleanup_pidfile);
 	if (uuidd_cxt->cleanup_socket)
 		unlink(uuidd_cxt->cleanup_socket);
+	if (uuidd_cxt->ring)
+		__sync_lock_test_and_set(&uuidd_cxt->ring->active, 0);
+	if (uuidd_cxt->cleanup_ring)
+		unlink(uuidd_cxt->cleanup_ring);
 	exit(ret);
 }
 
@@ -311,26 +382,522 @@ static void timeout_handler(int sig __attribute__((__unused__)),
 		errx(EXIT_FAILURE, _("timed out"));
 }
 
+/*
+ * Add @n clock ticks to the timestamp of the time-based UUID @uu.
+ */
+static void uuid_time_add(uuid_t uu, uint64_t n)
+{
+	uint64_t t;
+
+	t = ((uint64_t) (uu[6] & 0x0F) << 56) | ((uint64_t) uu[7] << 48) |
+	    ((uint64_t) uu[4] << 40) | ((uint64_t) uu[5] << 32) |
+	    ((uint64_t) uu[0] << 24) | ((uint64_t) uu[1] << 16) |
+	    ((uint64_t) uu[2] << 8) | (uint64_t) uu[3];
+	t += n;
+
+	uu[0] = t >> 24;
+	uu[1] = t >> 16;
+	uu[2] = t >> 8;
+	uu[3] = t;
+	uu[4] = t >> 40;
+	uu[5] = t >> 32;
+	uu[6] = (uu[6] & 0xF0) | ((t >> 56) & 0x0F);
+	uu[7] = t >> 48;
+}
+
+static void conn_set_events(struct uuidd_cxt_t *cxt, struct uuidd_conn *c,
+			    uint32_t events)
+{
+	struct epoll_event ev = { .events = events, .data.fd = c->fd };
+
+	if (c->events == events)
+		return;
+	if (epoll_ctl(cxt->epollfd, EPOLL_CTL_MOD, c->fd, &ev) < 0)
+		c->dead = 1;
+	else
+		c->events = events;
+}
+
+static void conn_set_ready(struct uuidd_cxt_t *cxt, struct uuidd_conn *c)
+{
+	if (c->ready)
+		return;
+	c->ready = 1;
+	c->next = cxt->ready;
+	cxt->ready = c;
+}
+
+static void new_conn(struct uuidd_cxt_t *cxt, int fd)
+{
+	struct epoll_event ev = { .events = EPOLLIN, .data.fd = fd };
+	struct uuidd_conn *c;
+
+	if ((size_t) fd >= cxt->nconns) {
+		size_t n = max((size_t) fd + 1, cxt->nconns * 2);
+
+		cxt->conns = xrealloc(cxt->conns, n * sizeof(struct uuidd_conn *));
+		memset(cxt->conns + cxt->nconns, 0,
+		       (n - cxt->nconns) * sizeof(struct uuidd_conn *));
+		cxt->nconns = n;
+	}
+
+	if (epoll_ctl(cxt->epollfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		warn(_("cannot add client to epoll"));
+		close(fd);
+		return;
+	}
+
+	c = xcalloc(1, sizeof(*c));
+	c->fd = fd;
+	c->events = EPOLLIN;
+	cxt->conns[fd] = c;
+}
+
+/*
+ * The listening socket is level-triggered, if accept() fails because of
+ * lack of descriptors or memory, it's removed from the epoll set until a
+ * connection is closed or UUIDD_ACCEPT_BACKOFF expires. Otherwise
+ * epoll_wait() would report it again and again.
+ */
+static void pause_accept(struct uuidd_cxt_t *cxt)
+{
+	struct epoll_event ev = { .events = 0, .data.fd = cxt->sockfd };
+	struct timeval delay = { .tv_usec = UUIDD_ACCEPT_BACKOFF * 1000 };
+	struct timeval now;
+
+	if (epoll_ctl(cxt->epollfd, EPOLL_CTL_MOD, cxt->sockfd, &ev) < 0)
+		err(EXIT_FAILURE, _("cannot modify socket in epoll"));
+	gettime_monotonic(&now);
+	timeradd(&now, &delay, &cxt->accept_resume);
+	cxt->accept_paused = 1;
+}
+
+static void resume_accept(struct uuidd_cxt_t *cxt)
+{
+	struct epoll_event ev = { .events = EPOLLIN, .data.fd = cxt->sockfd };
+
+	if (epoll_ctl(cxt->epollfd, EPOLL_CTL_MOD, cxt->sockfd, &ev) < 0)
+		err(EXIT_FAILURE, _("cannot modify socket in epoll"));
+	cxt->accept_paused = 0;
+}
+
+static void free_conn(struct uuidd_cxt_t *cxt, struct uuidd_conn *c)
+{
+	epoll_ctl(cxt->epollfd, EPOLL_CTL_DEL, c->fd, NULL);
+	cxt->conns[c->fd] = NULL;
+	close(c->fd);
+	free(c->out);
+	free(c);
+
+	if (cxt->accept_paused)
+		resume_accept(cxt);
+}
+
+static void accept_conns(struct uuidd_cxt_t *cxt, int s)
+{
+	int ns;
+
+	while (1) {
+		ns = accept4(s, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (ns >= 0) {
+			new_conn(cxt, ns);
+			cxt->accept_failed = 0;
+			continue;
+		}
+		switch (errno) {
+		case EINTR:
+		case ECONNABORTED:
+			continue;
+		case EAGAIN:
+			return;
+		case EMFILE:
+		case ENFILE:
+		case ENOBUFS:
+		case ENOMEM:
+			if (!cxt->accept_failed)
+				warn("accept");
+			cxt->accept_failed = 1;
+			pause_accept(cxt);
+			return;
+		default:
+			err(EXIT_FAILURE, "accept");
+		}
+	}
+}
+
+static void conn_read(struct uuidd_conn *c)
+{
+	ssize_t len;
+
+	while (!c->eof && c->inlen < sizeof(c->in)) {
+		len = read(c->fd, c->in + c->inlen, sizeof(c->in) - c->inlen);
+		if (len > 0) {
+			c->inlen += len;
+			continue;
+		}
+		if (len == 0)
+			c->eof = 1;
+		else if (errno == EINTR)
+			continue;
+		else if (errno != EAGAIN) {
+			warn(_("read failed"));
+			c->dead = 1;
+		}
+		break;
+	}
+}
+
+/* returns pointer to @sz bytes at the end of the output buffer */
+static char *conn_out_alloc(struct uuidd_conn *c, size_t sz)
+{
+	char *p;
+
+	if (c->outpos && c->outpos == c->outlen)
+		c->outpos = c->outlen = 0;
+
+	if (c->outlen + sz > c->outsz) {
+		if (c->outpos) {
+			memmove(c->out, c->out + c->outpos, c->outlen - c->outpos);
+			c->outlen -= c->outpos;
+			c->outpos = 0;
+		}
+		if (c->outlen + sz > c->outsz) {
+			c->outsz = max(c->outlen + sz, c->outsz * 2);
+			c->out = xrealloc(c->out, c->outsz);
+		}
+	}
+	p = c->out + c->outlen;
+	c->outlen += sz;
+	return p;
+}
+
+/* generate next chunk of the bulk random reply */
+static void conn_fill_random(struct uuidd_cxt_t *cxt, struct uuidd_conn *c)
+{
+	char str[UUID_STR_LEN];
+	unsigned char *cp;
+	int i, num;
+
+	while (c->random_pending > 0 && c->outlen - c->outpos < UUIDD_CONN_OUTMAX) {
+		num = min(c->random_pending, UUIDD_RANDOM_CHUNK);
+		cp = (unsigned char *) conn_out_alloc(c, num * UUID_LEN);
+		__uuid_generate_random(cp, &num);
+		c->random_pending -= num;
+
+		if (cxt->debug) {
+			fprintf(stderr, P_("Generated %d UUID:\n",
+					   "Generated %d UUIDs:\n", num), num);
+			for (i = 0; i < num; i++, cp += UUID_LEN) {
+				uuid_unparse(cp, str);
+				fprintf(stderr, "\t%s\n", str);
+			}
+		}
+	}
+}
+
+static void conn_write(struct uuidd_cxt_t *cxt, struct uuidd_conn *c)
+{
+	ssize_t len;
+
+	while (!c->dead) {
+		conn_fill_random(cxt, c);
+		if (c->outpos == c->outlen)
+			break;
+		len = send(c->fd, c->out + c->outpos, c->outlen - c->outpos,
+			   MSG_NOSIGNAL);
+		if (len > 0) {
+			c->outpos += len;
+			continue;
+		}
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len < 0 && errno != EAGAIN)
+			c->dead = 1;
+		break;
+	}
+}
+
+/* returns size of the request at the begin of @buf or 0 if incomplete */
+static size_t request_size(const char *buf, size_t len)
+{
+	size_t sz = 1;
+
+	if (!len)
+		return 0;
+	if (buf[0] == UUIDD_OP_BULK_TIME_UUID ||
+	    buf[0] == UUIDD_OP_BULK_RANDOM_UUID)
+		sz += sizeof(int);
+	return len >= sz ? sz : 0;
+}
+
+static int conn_can_parse(struct uuidd_conn *c)
+{
+	return !c->dead && !c->random_pending
+		&& c->outlen - c->outpos < UUIDD_CONN_OUTMAX;
+}
+
+/*
+ * Move requests from the client input buffer to the batch. The requests
+ * following a bulk random request wait until its reply is generated.
+ */
+static void conn_parse(struct uuidd_cxt_t *cxt, struct uuidd_conn *c)
+{
+	struct uuidd_req *req;
+	size_t sz, pos = 0;
+	int num;
+
+	if (!conn_can_parse(c))
+		return;
+
+	while (cxt->nreqs < UUIDD_MAX_BATCH) {
+		sz = request_size(c->in + pos, c->inlen - pos);
+		if (!sz)
+			break;
+
+		req = &cxt->reqs[cxt->nreqs];
+		req->conn = c;
+		req->op = c->in[pos];
+		req->num = 1;
+
+		if (sz > 1) {
+			memcpy(&num, c->in + pos + 1, sizeof(num));
+			if (cxt->debug)
+				fprintf(stderr, _("operation %d, incoming num = %d\n"),
+					req->op, num);
+			req->num = min(num, UUIDD_MAX_BULK);
+		} else if (cxt->debug)
+			fprintf(stderr, _("operation %d\n"), req->op);
+
+		if (req->op < 0 || req->op > UUIDD_MAX_OP) {
+			if (cxt->debug)
+				fprintf(stderr, _("Invalid operation %d\n"), req->op);
+			/* send the already queued replies and close */
+			pos = c->inlen;
+			c->eof = 1;
+			break;
+		}
+
+		if (req->op == UUIDD_OP_TIME_UUID ||
+		    req->op == UUIDD_OP_BULK_TIME_UUID)
+			cxt->nticks += max(req->num, 1);
+		cxt->nreqs++;
+		pos += sz;
+
+		if (req->op == UUIDD_OP_BULK_RANDOM_UUID)
+			break;
+	}
+
+	c->inlen -= pos;
+	memmove(c->in, c->in + pos, c->inlen);
+}
+
+/*
+ * Queue reply to @req. The time-based UUIDs are taken from the range
+ * reserved for the batch, @tm is moved behind them.
+ */
+static void serve_request(struct uuidd_cxt_t *cxt, struct uuidd_req *req,
+			  uuid_t tm)
+{
+	struct uuidd_conn *c = req->conn;
+	char str[UUID_STR_LEN], buf[32];
+	int32_t reply_len;
+	uuid_t uu;
+	int num = req->num;
+
+	switch (req->op) {
+	case UUIDD_OP_GETPID:
+	case UUIDD_OP_GET_MAXOP:
+		sprintf(buf, "%d", req->op == UUIDD_OP_GETPID ?
+				   getpid() : UUIDD_MAX_OP);
+		reply_len = strlen(buf) + 1;
+		memcpy(conn_out_alloc(c, sizeof(reply_len)), &reply_len, sizeof(reply_len));
+		memcpy(conn_out_alloc(c, reply_len), buf, reply_len);
+		break;
+	case UUIDD_OP_TIME_UUID:
+	case UUIDD_OP_BULK_TIME_UUID:
+		uuid_copy(uu, tm);
+		uuid_time_add(tm, max(num, 1));
+
+		if (cxt->debug) {
+			uuid_unparse(uu, str);
+			if (req->op == UUIDD_OP_TIME_UUID)
+				fprintf(stderr, _("Generated time UUID: %s\n"), str);
+			else
+				fprintf(stderr, P_("Generated time UUID %s "
+						   "and %d following\n",
+						   "Generated time UUID %s "
+						   "and %d following\n", num - 1),
+					str, num - 1);
+		}
+		reply_len = UUID_LEN;
+		if (req->op == UUIDD_OP_BULK_TIME_UUID)
+			reply_len += sizeof(num);
+		memcpy(conn_out_alloc(c, sizeof(reply_len)), &reply_len, sizeof(reply_len));
+		memcpy(conn_out_alloc(c, UUID_LEN), uu, UUID_LEN);
+		if (req->op == UUIDD_OP_BULK_TIME_UUID)
+			memcpy(conn_out_alloc(c, sizeof(num)), &num, sizeof(num));
+		break;
+	case UUIDD_OP_RANDOM_UUID:
+		__uuid_generate_random(uu, &num);
+		if (cxt->debug) {
+			uuid_unparse(uu, str);
+			fprintf(stderr, _("Generated random UUID: %s\n"), str);
+		}
+		reply_len = UUID_LEN;
+		memcpy(conn_out_alloc(c, sizeof(reply_len)), &reply_len, sizeof(reply_len));
+		memcpy(conn_out_alloc(c, UUID_LEN), uu, UUID_LEN);
+		break;
+	case UUIDD_OP_BULK_RANDOM_UUID:
+		if (num < 0)
+			num = 1;
+		/* the UUIDs are streamed by conn_write() */
+		reply_len = (num * UUID_LEN) + sizeof(num);
+		memcpy(conn_out_alloc(c, sizeof(reply_len)), &reply_len, sizeof(reply_len));
+		memcpy(conn_out_alloc(c, sizeof(num)), &num, sizeof(num));
+		c->random_pending = num;
+		break;
+	}
+}
+
+/*
+ * Serve all requests from the ready clients as one batch. The time-based
+ * UUIDs for the whole batch are reserved by one __uuid_generate_time() call.
+ */
+static void serve_ready(struct uuidd_cxt_t *cxt)
+{
+	struct uuidd_conn *c, *next, *list = cxt->ready;
+	uuid_t tm;
+	size_t i;
+
+	cxt->ready = NULL;
+	cxt->nreqs = 0;
+	cxt->nticks = 0;
+
+	for (c = list; c; c = c->next)
+		conn_parse(cxt, c);
+
+	if (cxt->nticks)
+		__uuid_generate_time(tm, &cxt->nticks);
+
+	for (i = 0; i < cxt->nreqs; i++)
+		serve_request(cxt, &cxt->reqs[i], tm);
+
+	for (c = list; c; c = next) {
+		uint32_t events = 0;
+
+		next = c->next;
+		c->next = NULL;
+		c->ready = 0;
+
+		conn_write(cxt, c);
+
+		if (!c->eof && c->inlen < sizeof(c->in))
+			events |= EPOLLIN;
+		if (c->outpos < c->outlen || c->random_pending)
+			events |= EPOLLOUT;
+		if (!c->dead)
+			conn_set_events(cxt, c, events);
+
+		if (!c->dead && request_size(c->in, c->inlen)) {
+			if (conn_can_parse(c))
+				conn_set_ready(cxt, c);
+		} else if (!c->dead && c->eof && !events)
+			c->dead = 1;	/* all done */
+
+		if (c->dead)
+			free_conn(cxt, c);
+	}
+}
+
+/*
+ * Fill the free slots of the shared memory ring. The time-based UUIDs for
+ * all the slots are reserved by one __uuid_generate_time() call.
+ */
+static void fill_ring(struct uuidd_cxt_t *cxt)
+{
+	struct uuidd_ring *r = cxt->ring;
+	struct uuidd_ring_slot *slot;
+	uint32_t i, n = 0;
+	time_t now;
+	uuid_t tm;
+	int num;
+
+	if (!r)
+		return;
+
+	while (n < UUIDD_RING_SLOTS) {
+		slot = &r->slots[(cxt->ring_tail + n) % UUIDD_RING_SLOTS];
+		if (__sync_fetch_and_add(&slot->seq, 0) != cxt->ring_tail + n)
+			break;		/* not claimed yet */
+		n++;
+	}
+	if (!n)
+		return;
+
+	num = n * UUIDD_RING_RANGE;
+	__uuid_generate_time(tm, &num);
+	now = time(NULL);
+
+	if (cxt->debug)
+		fprintf(stderr, _("Reserved %d time UUIDs for the ring\n"), num);
+
+	for (i = 0; i < n; i++, cxt->ring_tail++) {
+		slot = &r->slots[cxt->ring_tail % UUIDD_RING_SLOTS];
+		memcpy(slot->uuid, tm, sizeof(uuid_t));
+		slot->num = UUIDD_RING_RANGE;
+		slot->time = now;
+		uuid_time_add(tm, UUIDD_RING_RANGE);
+
+		/* publish the slot */
+		__sync_val_compare_and_swap(&slot->seq, cxt->ring_tail,
+					    cxt->ring_tail + 1);
+	}
+}
+
+static void create_ring(struct uuidd_cxt_t *cxt, const char *ring_path)
+{
+	const size_t sz = UUIDD_RING_SIZE(UUIDD_RING_SLOTS);
+	struct uuidd_ring *r;
+	mode_t save_umask;
+	uint32_t i;
+	int fd;
+
+	unlink(ring_path);
+	save_umask = umask(0);
+	fd = open(ring_path, O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0660);
+	umask(save_umask);
+	if (fd < 0)
+		err(EXIT_FAILURE, _("cannot open %s"), ring_path);
+	cxt->cleanup_ring = ring_path;
+
+	if (ftruncate(fd, sz) != 0)
+		err(EXIT_FAILURE, _("could not truncate file: %s"), ring_path);
+	r = mmap(NULL, sz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (r == MAP_FAILED)
+		err(EXIT_FAILURE, _("cannot map %s"), ring_path);
+	close(fd);
+
+	r->magic = UUIDD_RING_MAGIC;
+	r->nslots = UUIDD_RING_SLOTS;
+	for (i = 0; i < UUIDD_RING_SLOTS; i++)
+		r->slots[i].seq = i;
+
+	cxt->ring = r;
+	fill_ring(cxt);
+	__sync_lock_test_and_set(&r->active, 1);
+}
+
 static void server_loop(const char *socket_path, const char *pidfile_path,
 			struct uuidd_cxt_t *uuidd_cxt)
 {
-	struct sockaddr_un	from_addr;
-	socklen_t		fromlen;
-	int32_t			reply_len = 0;
-	uuid_t			uu;
-	char			reply_buf[1024], *cp;
-	char			op, str[UUID_STR_LEN];
-	int			i, ns, len, num;
+	char			reply_buf[1024];
+	int			i, nev, fd;
 	int			s = 0;
 	int			fd_pidfile = -1;
 	int			ret;
-	struct pollfd		pfd[2];
+	struct epoll_event	ev, events[64];
 	sigset_t		sigmask;
 	int			sigfd;
-	enum {
-				POLLFD_SIGNAL = 0,
-				POLLFD_SOCKET
-	};
 
 #ifdef HAVE_LIBSYSTEMD
 	if (!uuidd_cxt->no_sock)	/* no_sock implies no_fork and no_pid */
@@ -407,131 +974,66 @@ static void server_loop(const char *socket_path, const char *pidfile_path,
 	if ((sigfd = signalfd(-1, &sigmask, 0)) < 0)
 		err(EXIT_FAILURE, _("cannot set signal handler"));
 
-	pfd[POLLFD_SIGNAL].fd = sigfd;
-	pfd[POLLFD_SOCKET].fd = s;
-	pfd[POLLFD_SIGNAL].events = pfd[POLLFD_SOCKET].events = POLLIN | POLLERR | POLLHUP;
+	if (fcntl(s, F_SETFL, fcntl(s, F_GETFL) | O_NONBLOCK) < 0)
+		err(EXIT_FAILURE, "fcntl");
+
+	if (uuidd_cxt->ring_path)
+		create_ring(uuidd_cxt, uuidd_cxt->ring_path);
+
+	uuidd_cxt->epollfd = epoll_create1(EPOLL_CLOEXEC);
+	if (uuidd_cxt->epollfd < 0)
+		err(EXIT_FAILURE, _("cannot create epoll"));
+
+	ev.events = EPOLLIN;
+	ev.data.fd = sigfd;
+	if (epoll_ctl(uuidd_cxt->epollfd, EPOLL_CTL_ADD, sigfd, &ev) < 0)
+		err(EXIT_FAILURE, _("cannot add signal fd to epoll"));
+	ev.data.fd = s;
+	if (epoll_ctl(uuidd_cxt->epollfd, EPOLL_CTL_ADD, s, &ev) < 0)
+		err(EXIT_FAILURE, _("cannot add socket to epoll"));
+	uuidd_cxt->sockfd = s;
 
 	while (1) {
-		ret = poll(pfd, ARRAY_SIZE(pfd),
+		nev = epoll_wait(uuidd_cxt->epollfd, events, ARRAY_SIZE(events),
+				uuidd_cxt->ready ? 0 :
+				uuidd_cxt->accept_paused ? UUIDD_ACCEPT_BACKOFF :
 				uuidd_cxt->timeout ?
 					(int) uuidd_cxt->timeout * 1000 : -1);
-		if (ret < 0) {
-			if (errno == EAGAIN)
+		if (nev < 0) {
+			if (errno == EINTR)
 				continue;
-			warn(_("poll failed"));
-				all_done(uuidd_cxt, EXIT_FAILURE);
+			warn(_("epoll_wait failed"));
+			all_done(uuidd_cxt, EXIT_FAILURE);
 		}
-		if (ret == 0) {		/* truen when poll() times out */
+		if (nev == 0 && !uuidd_cxt->ready	/* true when timed out */
+		    && !uuidd_cxt->accept_paused) {
 			if (uuidd_cxt->debug)
 				fprintf(stderr, _("timeout [%d sec]\n"), uuidd_cxt->timeout),
 			all_done(uuidd_cxt, EXIT_SUCCESS);
 		}
-		if (pfd[POLLFD_SIGNAL].revents != 0)
-			handle_signal(uuidd_cxt, sigfd);
-		if (pfd[POLLFD_SOCKET].revents == 0)
-			continue;
-		fromlen = sizeof(from_addr);
-		ns = accept(s, (struct sockaddr *) &from_addr, &fromlen);
-		if (ns < 0) {
-			if ((errno == EAGAIN) || (errno == EINTR))
-				continue;
-			else
-				err(EXIT_FAILURE, "accept");
-		}
-		len = read(ns, &op, 1);
-		if (len != 1) {
-			if (len < 0)
-				warn(_("read failed"));
-			else
-				warnx(_("error reading from client, len = %d"),
-						len);
-			goto shutdown_socket;
+		if (uuidd_cxt->accept_paused) {
+			struct timeval now;
+
+			gettime_monotonic(&now);
+			if (!timercmp(&now, &uuidd_cxt->accept_resume, <))
+				resume_accept(uuidd_cxt);
 		}
-		if ((op == UUIDD_OP_BULK_TIME_UUID) ||
-		    (op == UUIDD_OP_BULK_RANDOM_UUID)) {
-			if (read_all(ns, (char *) &num, sizeof(num)) != 4)
-				goto shutdown_socket;
-			if (uuidd_cxt->debug)
-				fprintf(stderr, _("operation %d, incoming num = %d\n"),
-				       op, num);
-		} else if (uuidd_cxt->debug)
-			fprintf(stderr, _("operation %d\n"), op);
-
-		switch (op) {
-		case UUIDD_OP_GETPID:
-			sprintf(reply_buf, "%d", getpid());
-			reply_len = strlen(reply_buf) + 1;
-			break;
-		case UUIDD_OP_GET_MAXOP:
-			sprintf(reply_buf, "%d", UUIDD_MAX_OP);
-			reply_len = strlen(reply_buf) + 1;
-			break;
-		case UUIDD_OP_TIME_UUID:
-			num = 1;
-			__uuid_generate_time(uu, &num);
-			if (uuidd_cxt->debug) {
-				uuid_unparse(uu, str);
-				fprintf(stderr, _("Generated time UUID: %s\n"), str);
-			}
-			memcpy(reply_buf, uu, sizeof(uu));
-			reply_len = sizeof(uu);
-			break;
-		case UUIDD_OP_RANDOM_UUID:
-			num = 1;
-			__uuid_generate_random(uu, &num);
-			if (uuidd_cxt->debug) {
-				uuid_unparse(uu, str);
-				fprintf(stderr, _("Generated random UUID: %s\n"), str);
-			}
-			memcpy(reply_buf, uu, sizeof(uu));
-			reply_len = sizeof(uu);
-			break;
-		case UUIDD_OP_BULK_TIME_UUID:
-			__uuid_generate_time(uu, &num);
-			if (uuidd_cxt->debug) {
-				uuid_unparse(uu, str);
-				fprintf(stderr, P_("Generated time UUID %s "
-						   "and %d following\n",
-						   "Generated time UUID %s "
-						   "and %d following\n", num - 1),
-				       str, num - 1);
-			}
-			memcpy(reply_buf, uu, sizeof(uu));
-			reply_len = sizeof(uu);
-			memcpy(reply_buf + reply_len, &num, sizeof(num));
-			reply_len += sizeof(num);
-			break;
-		case UUIDD_OP_BULK_RANDOM_UUID:
-			if (num < 0)
-				num = 1;
-			if (num > 1000)
-				num = 1000;
-			if (num * UUID_LEN > (int) (sizeof(reply_buf) - sizeof(num)))
-				num = (sizeof(reply_buf) - sizeof(num)) / UUID_LEN;
-			__uuid_generate_random((unsigned char *) reply_buf +
-					      sizeof(num), &num);
-			if (uuidd_cxt->debug) {
-				fprintf(stderr, P_("Generated %d UUID:\n",
-						   "Generated %d UUIDs:\n", num), num);
-				for (i = 0, cp = reply_buf + sizeof(num);
-				     i < num;
-				     i++, cp += UUID_LEN) {
-					uuid_unparse((unsigned char *)cp, str);
-					fprintf(stderr, "\t%s\n", str);
-				}
+		for (i = 0; i < nev; i++) {
+			struct uuidd_conn *c;
+
+			fd = events[i].data.fd;
+			if (fd == sigfd)
+				handle_signal(uuidd_cxt, sigfd);
+			else if (fd == s)
+				accept_conns(uuidd_cxt, s);
+			else if ((c = uuidd_cxt->conns[fd])) {
+				if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+					conn_read(c);
+				conn_set_ready(uuidd_cxt, c);
 			}
-			reply_len = (num * UUID_LEN) + sizeof(num);
-			memcpy(reply_buf, &num, sizeof(num));
-			break;
-		default:
-			if (uuidd_cxt->debug)
-				fprintf(stderr, _("Invalid operation %d\n"), op);
-			goto shutdown_socket;
 		}
-		write_all(ns, (char *) &reply_len, sizeof(reply_len));
-		write_all(ns, reply_buf, reply_len);
-	shutdown_socket:
-		close(ns);
+		serve_ready(uuidd_cxt);
+		fill_ring(uuidd_cxt);
 	}
 }
 
@@ -567,6 +1069,7 @@ int main(int argc, char **argv)
 		{"no-pid", no_argument, NULL, 'P'},
 		{"no-fork", no_argument, NULL, 'F'},
 		{"socket-activation", no_argument, NULL, 'S'},
+		{"ring", optional_argument, NULL, 'R'},
 		{"debug", no_argument, NULL, 'd'},
 		{"quiet", no_argument, NULL, 'q'},
 		{"version", no_argument, NULL, 'V'},
@@ -587,7 +1090,7 @@ int main(int argc, char **argv)
 	atexit(close_stdout);
 
 	while ((c =
-		getopt_long(argc, argv, "p:s:T:krtn:PFSdqVh", longopts,
+		getopt_long(argc, argv, "p:s:T:krtn:PFSR::dqVh", longopts,
 			    NULL)) != -1) {
 		err_exclusive_options(c, longopts, excl, excl_st);
 		switch (c) {
@@ -623,6 +1126,9 @@ int main(int argc, char **argv)
 		case 'q':
 			uuidd_cxt.quiet = 1;
 			break;
+		case 'R':
+			uuidd_cxt.ring_path = optarg ? optarg : UUIDD_RING_PATH;
+			break;
 		case 'r':
 			do_type = UUIDD_OP_RANDOM_UUID;
 			break;
@@ -17,6 +17,10 @@
 #include "nls.h"
 #include "c.h"
 #include "closestream.h"
+#include "strutils.h"
+
+/* number of UUIDs generated by one uuid_generate_random_n() call */
+#define UUIDGEN_CHUNK	1024
 
 static void __attribute__ ((__noreturn__)) usage(FILE * out)
 {
@@ -28,10 +32,11 @@ static void __attribute__ ((__noreturn__)) usage(FILE * out)
 	fputs(_("Create a new UUID value.\n"), out);
 
 	fputs(USAGE_OPTIONS, out);
-	fputs(_(" -r, --random     generate random-based uuid\n"
-		" -t, --time       generate time-based uuid\n"
-		" -V, --version    output version information and exit\n"
-		" -h, --help       display this help and exit\n\n"), out);
+	fputs(_(" -r, --random        generate random-based uuid\n"
+		" -t, --time          generate time-based uuid\n"
+		" -C, --count <num>   generate <num> uuids\n"
+		" -V, --version       output version information and exit\n"
+		" -h, --help          display this help and exit\n\n"), out);
 
 	fprintf(out, USAGE_MAN_TAIL("uuidgen(1)"));
 	exit(out == stderr ? EXIT_FAILURE : EXIT_SUCCESS);
@@ -43,11 +48,13 @@ main (int argc, char *argv[])
 	int    c;
 	int    do_type = 0;
 	char   str[37];
-	uuid_t uu;
+	uuid_t uu[UUIDGEN_CHUNK];
+	size_t i, n, count = 1;
 
 	static const struct option longopts[] = {
 		{"random", no_argument, NULL, 'r'},
 		{"time", no_argument, NULL, 't'},
+		{"count", required_argument, NULL, 'C'},
 		{"version", no_argument, NULL, 'V'},
 		{"help", no_argument, NULL, 'h'},
 		{NULL, 0, NULL, 0}
@@ -58,7 +65,7 @@ main (int argc, char *argv[])
 	textdomain(PACKAGE);
 	atexit(close_stdout);
 
-	while ((c = getopt_long(argc, argv, "rtVh", longopts, NULL)) != -1)
+	while ((c = getopt_long(argc, argv, "rtC:Vh", longopts, NULL)) != -1)
 		switch (c) {
 		case 't':
 			do_type = UUID_TYPE_DCE_TIME;
@@ -66,6 +73,11 @@ main (int argc, char *argv[])
 		case 'r':
 			do_type = UUID_TYPE_DCE_RANDOM;
 			break;
+		case 'C':
+			count = strtou32_or_err(optarg, _("invalid count argument"));
+			if (!count)
+				errx(EXIT_FAILURE, _("invalid count argument"));
+			break;
 		case 'V':
 			printf(UTIL_LINUX_VERSION);
 			return EXIT_SUCCESS;
@@ -75,21 +87,29 @@ main (int argc, char *argv[])
 			usage(stderr);
 		}
 
-	switch (do_type) {
-	case UUID_TYPE_DCE_TIME:
-		uuid_generate_time(uu);
-		break;
-	case UUID_TYPE_DCE_RANDOM:
-		uuid_generate_random(uu);
-		break;
-	default:
-		uuid_generate(uu);
-		break;
-	}
+	while (count > 0) {
+		n = min(count, (size_t) UUIDGEN_CHUNK);
 
-	uuid_unparse(uu, str);
+		switch (do_type) {
+		case UUID_TYPE_DCE_TIME:
+			for (i = 0; i < n; i++)
+				uuid_generate_time(uu[i]);
+			break;
+		case UUID_TYPE_DCE_RANDOM:
+			uuid_generate_random_n(uu, n);
+			break;
+		default:
+			for (i = 0; i < n; i++)
+				uuid_generate(uu[i]);
+			break;
+		}
 
-	printf("%s\n", str);
+		for (i = 0; i < n; i++) {
+			uuid_unparse(uu[i], str);
+			printf("%s\n", str);
+		}
+		count -= n;
+	}
 
 	return EXIT_SUCCESS;
 }
@@ -21,6 +21,8 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <inttypes.h>
 
 #include "c.h"
 #include "colors.h"
@@ -150,6 +152,9 @@ enum {
 	DMESG_METHOD_MMAP	/* mmap file with records (see --file) */
 };
 
+/* stdout buffer size in --follow mode */
+#define DMESG_FOLLOW_BUFSIZ	(64 * 1024)
+
 enum {
 	DMESG_TIMEFTM_NONE = 0,
 	DMESG_TIMEFTM_CTIME,		/* [ctime] */
@@ -179,6 +184,7 @@ struct dmesg_control {
 	int		kmsg;		/* /dev/kmsg file descriptor */
 	ssize_t		kmsg_first_read;/* initial read() return code */
 	char		kmsg_buf[BUFSIZ];/* buffer to read kmsg data */
+	uint64_t	kmsg_seq;	/* expected sequence number of the next record */
 
 	/*
 	 * For the --file option we mmap whole file. The unnecessary (already
@@ -188,15 +194,20 @@ struct dmesg_control {
 	char		*filename;
 	char		*mmap_buff;
 	size_t		pagesize;
+	char		*indexname;	/* --index sidecar file */
 	unsigned int	time_fmt;	/* time format */
 
+	usec_t		since;		/* --since time or zero */
+	usec_t		until;		/* --until time or zero */
+
 	unsigned int	follow:1,	/* wait for new messages */
 			raw:1,		/* raw mode */
 			fltr_lev:1,	/* filter out by levels[] */
 			fltr_fac:1,	/* filter out by facilities[] */
 			decode:1,	/* use "facility: level: " prefix */
 			pager:1,	/* pipe output into a pager */
-			color:1;	/* colorize messages */
+			color:1,	/* colorize messages */
+			kmsg_seq_valid:1; /* kmsg_seq is initialized */
 	int		indent;		/* due to timestamps if newline */
 };
 
@@ -207,6 +218,7 @@ struct dmesg_record {
 	int		level;
 	int		facility;
 	struct timeval  tv;
+	uint64_t	seq;		/* /dev/kmsg sequence number */
 
 	const char	*next;		/* buffer with next unparsed record */
 	size_t		next_size;	/* size of the next buffer */
@@ -219,6 +231,7 @@ struct dmesg_record {
 		(_r)->level = -1; \
 		(_r)->tv.tv_sec = 0; \
 		(_r)->tv.tv_usec = 0; \
+		(_r)->seq = 0; \
 	} while (0)
 
 static int read_kmsg(struct dmesg_control *ctl);
@@ -272,6 +285,8 @@ static void __attribute__((__noreturn__)) usage(FILE *out)
 	fputs(_(" -D, --console-off           disable printing messages to console\n"), out);
 	fputs(_(" -E, --console-on            enable printing messages to console\n"), out);
 	fputs(_(" -F, --file <file>           use the file instead of the kernel log buffer\n"), out);
+	fputs(_("     --index <file>          use (or create) index of the --file records\n"), out);
+	fputs(_("     --boot-time <time>      boot time of the --file messages\n"), out);
 	fputs(_(" -f, --facility <list>       restrict output to defined facilities\n"), out);
 	fputs(_(" -H, --human                 human readable output\n"), out);
 	fputs(_(" -k, --kernel                display kernel messages\n"), out);
@@ -284,6 +299,8 @@ static void __attribute__((__noreturn__)) usage(FILE *out)
 	fputs(_(" -r, --raw                   print the raw message buffer\n"), out);
 	fputs(_(" -S, --syslog                force to use syslog(2) rather than /dev/kmsg\n"), out);
 	fputs(_(" -s, --buffer-size <size>    buffer size to query the kernel ring buffer\n"), out);
+	fputs(_("     --since <time>          display the messages since the specified time\n"), out);
+	fputs(_("     --until <time>          display the messages until the specified time\n"), out);
 	fputs(_(" -u, --userspace             display userspace messages\n"), out);
 	fputs(_(" -w, --follow                wait for new messages\n"), out);
 	fputs(_(" -x, --decode                decode facility and level to readable string\n"), out);
@@ -672,52 +689,105 @@ static const char *skip_item(const char *begin, const char *end, const char *sep
 	return begin;
 }
 
+static int accept_record(struct dmesg_control *ctl, struct dmesg_record *rec)
+{
+	if (ctl->fltr_lev && (rec->facility < 0 ||
+			      !isset(ctl->levels, rec->level)))
+		return 0;
+
+	if (ctl->fltr_fac && (rec->facility < 0 ||
+			      !isset(ctl->facilities, rec->facility)))
+		return 0;
+
+	return 1;
+}
+
+static inline int64_t timeval_to_usec(const struct timeval *tv)
+{
+	return (int64_t) tv->tv_sec * USEC_PER_SEC + tv->tv_usec;
+}
+
+/*
+ * Returns 1 if the record time (boot time + record timestamp) is within
+ * --since and --until.
+ */
+static int accept_record_time(struct dmesg_control *ctl, struct dmesg_record *rec)
+{
+	int64_t t;
+
+	if (!ctl->since && !ctl->until)
+		return 1;
+
+	t = timeval_to_usec(&ctl->boot_time) + timeval_to_usec(&rec->tv);
+
+	if (ctl->since && t < (int64_t) ctl->since)
+		return 0;
+	if (ctl->until && t > (int64_t) ctl->until)
+		return 0;
+	return 1;
+}
+
+/*
+ * Returns end of the record which starts at 'begin'. The records are
+ * separated by "\n<", the last record ends at the end of the buffer.
+ */
+static const char *find_syslog_record_end(const char *begin, const char *bufend)
+{
+	const char *p = begin + 1;
+
+	while (p < bufend && (p = memchr(p, '\n', bufend - p))) {
+		if (p + 1 < bufend && *(p + 1) == '<')
+			return p;
+		p++;
+	}
+	return bufend;
+}
+
 /*
  * Parses one record from syslog(2) buffer
+ *
+ * The records filtered out by --level or --facility are skipped here,
+ * before the timestamp is parsed. The records out of --since and --until
+ * and the records without timestamp are skipped after that.
  */
 static int get_next_syslog_record(struct dmesg_control *ctl,
 				  struct dmesg_record *rec)
 {
-	size_t i;
-	const char *begin = NULL;
-
 	if (ctl->method != DMESG_METHOD_MMAP &&
 	    ctl->method != DMESG_METHOD_SYSLOG)
 		return -1;
 
-	if (!rec->next || !rec->next_size)
-		return 1;
+	while (rec->next && rec->next_size) {
+		const char *begin = rec->next;
+		const char *bufend = rec->next + rec->next_size;
+		const char *end;
 
-	INIT_DMESG_RECORD(rec);
+		INIT_DMESG_RECORD(rec);
 
-	/*
-	 * Unmap already printed file data from memory
-	 */
-	if (ctl->mmap_buff && (size_t) (rec->next - ctl->mmap_buff) > ctl->pagesize) {
-		void *x = ctl->mmap_buff;
+		/*
+		 * Unmap already printed (or skipped, see --index) file data
+		 * from memory
+		 */
+		if (ctl->mmap_buff && (size_t) (begin - ctl->mmap_buff) > ctl->pagesize) {
+			size_t sz = (begin - ctl->mmap_buff - 1) / ctl->pagesize
+					* ctl->pagesize;
 
-		ctl->mmap_buff += ctl->pagesize;
-		munmap(x, ctl->pagesize);
-	}
+			munmap(ctl->mmap_buff, sz);
+			ctl->mmap_buff += sz;
+		}
 
-	for (i = 0; i < rec->next_size; i++) {
-		const char *p = rec->next + i;
-		const char *end = NULL;
-
-		if (!begin)
-			begin = p;
-		if (i + 1 == rec->next_size) {
-			end = p + 1;
-			i++;
-		} else if (*p == '\n' && *(p + 1) == '<')
-			end = p;
-
-		if (begin && !*begin)
-			begin = NULL;	/* zero(s) at the end of the buffer? */
-		if (!begin || !end)
-			continue;
-		if (end <= begin)
-			continue;	/* error or empty line? */
+		/* zero(s) at the end of the buffer? */
+		while (begin < bufend && !*begin)
+			begin++;
+		if (begin == bufend)
+			break;
+
+		end = find_syslog_record_end(begin, bufend);
+
+		rec->next_size -= end - rec->next;
+		rec->next = rec->next_size > 0 ? end + 1 : NULL;
+		if (rec->next_size > 0)
+			rec->next_size--;
 
 		if (*begin == '<') {
 			if (ctl->fltr_lev || ctl->fltr_fac || ctl->decode || ctl->color)
@@ -727,45 +797,34 @@ static int get_next_syslog_record(struct dmesg_control *ctl,
 				begin = skip_item(begin, end, ">");
 		}
 
+		if (!accept_record(ctl, rec))
+			continue;
+
 		if (*begin == '[' && (*(begin + 1) == ' ' ||
 				      isdigit(*(begin + 1)))) {
 
-			if (!is_timefmt(ctl, NONE))
+			if (!is_timefmt(ctl, NONE) || ctl->since || ctl->until)
 				begin = parse_syslog_timestamp(begin + 1, &rec->tv);
 			else
 				begin = skip_item(begin, end, "]");
 
 			if (begin < end && *begin == ' ')
 				begin++;
-		}
+		} else if (ctl->since || ctl->until)
+			continue;	/* no time to compare */
+
+		if (!accept_record_time(ctl, rec))
+			continue;
 
 		rec->mesg = begin;
 		rec->mesg_size = end - begin;
 
-		rec->next_size -= end - rec->next;
-		rec->next = rec->next_size > 0 ? end + 1 : NULL;
-		if (rec->next_size > 0)
-			rec->next_size--;
-
 		return 0;
 	}
 
 	return 1;
 }
 
-static int accept_record(struct dmesg_control *ctl, struct dmesg_record *rec)
-{
-	if (ctl->fltr_lev && (rec->facility < 0 ||
-			      !isset(ctl->levels, rec->level)))
-		return 0;
-
-	if (ctl->fltr_fac && (rec->facility < 0 ||
-			      !isset(ctl->facilities, rec->facility)))
-		return 0;
-
-	return 1;
-}
-
 static void raw_print(struct dmesg_control *ctl, const char *buf, size_t size)
 {
 	int lastc = '\n';
@@ -994,6 +1053,316 @@ mesg:
 		putchar('\n');
 }
 
+/*
+ * Flushes stdout; used in --follow mode where stdout is fully buffered.
+ */
+static void flush_output(void)
+{
+	if (fflush(stdout) != 0) {
+		if (errno != EPIPE)
+			err(EXIT_FAILURE, _("write failed"));
+		exit(EXIT_SUCCESS);
+	}
+}
+
+/*
+ * Sidecar index of the --file records (see --index). The file is split to
+ * blocks of whole records; the index keeps the range of the timestamps and
+ * the levels and facilities used in every block, so the blocks without
+ * wanted records are not read at all. If the timestamps never go backward
+ * (one boot in the file) the --since and --until range of blocks is found by
+ * binary search.
+ *
+ * The index is a cache in the native byte order, it's rebuilt when it does
+ * not match the size and mtime of the file.
+ */
+#define DMESG_INDEX_MAGIC	"DMESGIX1"
+#define DMESG_INDEX_BLOCKSIZ	(64 * 1024)
+
+struct dmesg_index_header {
+	char		magic[8];	/* DMESG_INDEX_MAGIC */
+	uint64_t	size;		/* size of the indexed file */
+	int64_t		mtime_sec;	/* mtime of the indexed file */
+	int64_t		mtime_nsec;
+	uint64_t	nblocks;	/* number of the blocks */
+	uint64_t	sorted;		/* timestamps never go backward */
+};
+
+struct dmesg_index_block {
+	uint64_t	offset;		/* the first record */
+	uint64_t	size;		/* without separator after the last record */
+	int64_t		min_usec;	/* record timestamps */
+	int64_t		max_usec;
+	uint32_t	levels;		/* bitmasks of the record levels */
+	uint32_t	facilities;	/* ... and facilities */
+};
+
+struct dmesg_index {
+	struct dmesg_index_header	hdr;
+	struct dmesg_index_block	*blocks;
+};
+
+static void index_add_timestamp(struct dmesg_index *idx,
+				struct dmesg_index_block *blk,
+				const char *p, int64_t *last)
+{
+	struct timeval tv = { 0 };
+	int64_t usec;
+
+	/* see get_next_syslog_record(), the records without timestamp are
+	 * never accepted by --since and --until */
+	if (*p != '[' || (*(p + 1) != ' ' && !isdigit(*(p + 1))))
+		return;
+
+	parse_syslog_timestamp(p + 1, &tv);
+	usec = timeval_to_usec(&tv);
+	if (usec < blk->min_usec)
+		blk->min_usec = usec;
+	if (usec > blk->max_usec)
+		blk->max_usec = usec;
+	if (usec < *last)
+		idx->hdr.sorted = 0;
+	*last = usec;
+}
+
+/*
+ * A block without timestamps gets the previous timestamp to keep the blocks
+ * of a sorted file sorted for the binary search.
+ */
+static void index_close_block(struct dmesg_index_block *blk, int64_t last)
+{
+	if (blk && blk->min_usec > blk->max_usec)
+		blk->min_usec = blk->max_usec = last;
+}
+
+/*
+ * Reads all the records in the same way as get_next_syslog_record().
+ */
+static void build_index(struct dmesg_index *idx, const char *buf, size_t size)
+{
+	const char *next = buf, *bufend = buf + size;
+	struct dmesg_index_block *blk = NULL;
+	size_t nalloc = 0;
+	int64_t last = 0;
+
+	idx->hdr.nblocks = 0;
+	idx->hdr.sorted = 1;
+
+	while (next < bufend) {
+		const char *begin = next, *end;
+		int fac = -1, lev = -1;
+
+		if (!blk || begin - buf - blk->offset >= DMESG_INDEX_BLOCKSIZ) {
+			index_close_block(blk, last);
+			if (idx->hdr.nblocks == nalloc) {
+				nalloc = nalloc ? nalloc * 2 : 64;
+				idx->blocks = xrealloc(idx->blocks,
+						nalloc * sizeof(*blk));
+			}
+			blk = &idx->blocks[idx->hdr.nblocks++];
+			memset(blk, 0, sizeof(*blk));
+			blk->offset = begin - buf;
+			blk->min_usec = INT64_MAX;
+			blk->max_usec = INT64_MIN;
+		}
+
+		while (begin < bufend && !*begin)
+			begin++;
+		if (begin == bufend)
+			break;
+
+		end = find_syslog_record_end(begin, bufend);
+		blk->size = end - buf - blk->offset;
+		next = end + 1;
+
+		if (*begin == '<') {
+			const char *p = parse_faclev(begin + 1, &fac, &lev);
+
+			if (fac >= 0 && lev >= 0) {
+				blk->levels |= 1 << lev;
+				blk->facilities |= 1 << fac;
+			}
+			/* the position depends on filters, index both */
+			index_add_timestamp(idx, blk, p, &last);
+			begin = skip_item(begin, end, ">");
+			if (begin == p)
+				continue;
+		}
+		index_add_timestamp(idx, blk, begin, &last);
+	}
+
+	index_close_block(blk, last);
+}
+
+static int read_index(const char *name, struct dmesg_index *idx,
+		      const struct stat *st)
+{
+	struct stat ist;
+	uint64_t i, end = 0;
+	size_t sz;
+	int fd;
+
+	fd = open(name, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+
+	if (fstat(fd, &ist) != 0
+	    || read_all(fd, (char *) &idx->hdr, sizeof(idx->hdr)) != sizeof(idx->hdr)
+	    || memcmp(idx->hdr.magic, DMESG_INDEX_MAGIC, sizeof(idx->hdr.magic)) != 0
+	    || idx->hdr.size != (uint64_t) st->st_size
+	    || idx->hdr.mtime_sec != (int64_t) st->st_mtim.tv_sec
+	    || idx->hdr.mtime_nsec != (int64_t) st->st_mtim.tv_nsec
+	    || idx->hdr.nblocks > (uint64_t) ist.st_size / sizeof(*idx->blocks))
+		goto fail;
+
+	sz = idx->hdr.nblocks * sizeof(*idx->blocks);
+	if ((size_t) ist.st_size != sizeof(idx->hdr) + sz)
+		goto fail;
+
+	idx->blocks = xmalloc(sz);
+	if (read_all(fd, (char *) idx->blocks, sz) != (ssize_t) sz)
+		goto fail;
+
+	for (i = 0; i < idx->hdr.nblocks; i++) {
+		struct dmesg_index_block *blk = &idx->blocks[i];
+
+		if (blk->offset < end || blk->offset > idx->hdr.size
+		    || blk->size > idx->hdr.size - blk->offset
+		    || blk->min_usec > blk->max_usec)
+			goto fail;
+		end = blk->offset + blk->size;
+	}
+
+	close(fd);
+	return 0;
+fail:
+	close(fd);
+	free(idx->blocks);
+	idx->blocks = NULL;
+	return -1;
+}
+
+static void write_index(const char *name, struct dmesg_index *idx)
+{
+	char *tmp;
+	int fd, rc;
+
+	xasprintf(&tmp, "%s.XXXXXX", name);
+
+	fd = mkstemp(tmp);
+	if (fd < 0) {
+		warn(_("cannot create index %s"), name);
+		free(tmp);
+		return;
+	}
+
+	rc = write_all(fd, &idx->hdr, sizeof(idx->hdr));
+	if (!rc)
+		rc = write_all(fd, idx->blocks,
+				idx->hdr.nblocks * sizeof(*idx->blocks));
+	if (close(fd) != 0)
+		rc = -1;
+	if (!rc)
+		rc = rename(tmp, name);
+	if (rc) {
+		warn(_("cannot write index %s"), name);
+		unlink(tmp);
+	}
+	free(tmp);
+}
+
+static int index_block_wanted(struct dmesg_control *ctl,
+			      struct dmesg_index_block *blk,
+			      uint32_t levels, uint32_t facilities)
+{
+	int64_t boot = timeval_to_usec(&ctl->boot_time);
+
+	if (ctl->fltr_lev && !(blk->levels & levels))
+		return 0;
+	if (ctl->fltr_fac && !(blk->facilities & facilities))
+		return 0;
+	if (ctl->since && boot + blk->max_usec < (int64_t) ctl->since)
+		return 0;
+	if (ctl->until && boot + blk->min_usec > (int64_t) ctl->until)
+		return 0;
+	return 1;
+}
+
+/*
+ * Prints the --file buffer, only the blocks with wanted records are read.
+ */
+static void print_indexed_buffer(struct dmesg_control *ctl,
+				 const char *buf, size_t size)
+{
+	struct dmesg_index idx = { .blocks = NULL };
+	struct dmesg_record rec;
+	struct stat st;
+	int64_t boot = timeval_to_usec(&ctl->boot_time);
+	uint32_t levels = 0, facilities = 0;
+	size_t i, first = 0, last, lo, hi;
+
+	if (stat(ctl->filename, &st) != 0)
+		err(EXIT_FAILURE, _("stat of %s failed"), ctl->filename);
+
+	if (read_index(ctl->indexname, &idx, &st) != 0) {
+		memset(&idx.hdr, 0, sizeof(idx.hdr));
+		memcpy(idx.hdr.magic, DMESG_INDEX_MAGIC, sizeof(idx.hdr.magic));
+		idx.hdr.size = st.st_size;
+		idx.hdr.mtime_sec = st.st_mtim.tv_sec;
+		idx.hdr.mtime_nsec = st.st_mtim.tv_nsec;
+
+		build_index(&idx, buf, size);
+		write_index(ctl->indexname, &idx);
+	}
+
+	for (i = 0; i < ARRAY_SIZE(level_names); i++)
+		if (isset(ctl->levels, i))
+			levels |= 1 << i;
+	for (i = 0; i < ARRAY_SIZE(facility_names); i++)
+		if (isset(ctl->facilities, i))
+			facilities |= 1 << i;
+
+	last = idx.hdr.nblocks;
+
+	if (idx.hdr.sorted && ctl->since) {
+		for (lo = 0, hi = last; lo < hi; ) {
+			size_t x = lo + (hi - lo) / 2;
+
+			if (boot + idx.blocks[x].max_usec < (int64_t) ctl->since)
+				lo = x + 1;
+			else
+				hi = x;
+		}
+		first = lo;
+	}
+	if (idx.hdr.sorted && ctl->until) {
+		for (lo = first, hi = last; lo < hi; ) {
+			size_t x = lo + (hi - lo) / 2;
+
+			if (boot + idx.blocks[x].min_usec <= (int64_t) ctl->until)
+				lo = x + 1;
+			else
+				hi = x;
+		}
+		last = lo;
+	}
+
+	for (i = first; i < last; i++) {
+		struct dmesg_index_block *blk = &idx.blocks[i];
+
+		if (!index_block_wanted(ctl, blk, levels, facilities))
+			continue;
+
+		rec.next = buf + blk->offset;
+		rec.next_size = blk->size;
+
+		while (get_next_syslog_record(ctl, &rec) == 0)
+			print_record(ctl, &rec);
+	}
+
+	free(idx.blocks);
+}
+
 /*
  * Prints the 'buf' kernel ring buffer; the messages are filtered out according
  * to 'levels' and 'facilities' bitarrays.
@@ -1008,15 +1377,56 @@ static void print_buffer(struct dmesg_control *ctl,
 		return;
 	}
 
+	if (ctl->indexname && ctl->mmap_buff) {
+		print_indexed_buffer(ctl, buf, size);
+		return;
+	}
+
 	while (get_next_syslog_record(ctl, &rec) == 0)
 		print_record(ctl, &rec);
 }
 
+#ifdef TEST_DMESG
+/*
+ * The tests read the records from $DMESG_TEST_KMSG, one record per line
+ * like read() from /dev/kmsg returns them.
+ */
+static inline const char *dmesg_kmsg_path(void)
+{
+	char *str = getenv("DMESG_TEST_KMSG");
+
+	return str ? str : "/dev/kmsg";
+}
+
+static ssize_t read_test_kmsg_one(struct dmesg_control *ctl)
+{
+	ssize_t size = 0;
+
+	while ((size_t) size < sizeof(ctl->kmsg_buf) - 1) {
+		if (read(ctl->kmsg, ctl->kmsg_buf + size, 1) != 1)
+			break;
+		if (ctl->kmsg_buf[size++] == '\n')
+			break;
+	}
+	return size;
+}
+#else
+# define dmesg_kmsg_path()	"/dev/kmsg"
+#endif
+
 static ssize_t read_kmsg_one(struct dmesg_control *ctl)
 {
 	ssize_t size;
 
-	/* kmsg returns EPIPE if record was modified while reading */
+#ifdef TEST_DMESG
+	if (getenv("DMESG_TEST_KMSG"))
+		return read_test_kmsg_one(ctl);
+#endif
+	/*
+	 * kmsg returns EPIPE if record was overwritten before we read it;
+	 * the next read() returns the oldest available record, the lost
+	 * records are reported by check_kmsg_seq().
+	 */
 	do {
 		size = read(ctl->kmsg, ctl->kmsg_buf,
 			    sizeof(ctl->kmsg_buf) - 1);
@@ -1027,14 +1437,16 @@ static ssize_t read_kmsg_one(struct dmesg_control *ctl)
 
 static int init_kmsg(struct dmesg_control *ctl)
 {
-	int mode = O_RDONLY;
-
-	if (!ctl->follow)
-		mode |= O_NONBLOCK;
-	else
-		setlinebuf(stdout);
+	/*
+	 * The descriptor is non-blocking also in --follow mode, read_kmsg()
+	 * drains all available records and then waits by poll(). The output
+	 * is flushed only when the buffer is drained, so we don't call
+	 * write(2) for each record when the kernel is flooding the log.
+	 */
+	if (ctl->follow)
+		setvbuf(stdout, NULL, _IOFBF, DMESG_FOLLOW_BUFSIZ);
 
-	ctl->kmsg = open("/dev/kmsg", mode);
+	ctl->kmsg = open(dmesg_kmsg_path(), O_RDONLY | O_NONBLOCK);
 	if (ctl->kmsg < 0)
 		return -1;
 
@@ -1054,6 +1466,8 @@ static int init_kmsg(struct dmesg_control *ctl)
 	 * read_kmsg().
 	 */
 	ctl->kmsg_first_read = read_kmsg_one(ctl);
+	if (ctl->kmsg_first_read < 0 && ctl->follow && errno == EAGAIN)
+		ctl->kmsg_first_read = 0;	/* empty (cleared) buffer */
 	if (ctl->kmsg_first_read < 0) {
 		close(ctl->kmsg);
 		ctl->kmsg = -1;
@@ -1102,12 +1516,13 @@ static int parse_kmsg_record(struct dmesg_control *ctl,
 		goto mesg;
 
 	/* B) sequence number */
+	rec->seq = strtoumax(p, NULL, 10);
 	p = skip_item(p, end, ",;");
 	if (LAST_KMSG_FIELD(p))
 		goto mesg;
 
 	/* C) timestamp */
-	if (is_timefmt(ctl, NONE))
+	if (is_timefmt(ctl, NONE) && !ctl->since && !ctl->until)
 		p = skip_item(p, end, ",;");
 	else
 		p = parse_kmsg_timestamp(p, &rec->tv);
@@ -1141,6 +1556,48 @@ mesg:
 	return 0;
 }
 
+/*
+ * Reports records overwritten in the ring buffer before we had a chance to
+ * read them. The kernel silently skips them (see EPIPE in read_kmsg_one()),
+ * the only trace is a gap in the sequence numbers. The report is aligned
+ * with the messages and it is not part of the --raw output. The gaps before
+ * records out of --since and --until are not reported.
+ */
+static void check_kmsg_seq(struct dmesg_control *ctl, struct dmesg_record *rec)
+{
+	if (ctl->kmsg_seq_valid && rec->seq > ctl->kmsg_seq && !ctl->raw
+	    && accept_record_time(ctl, rec)) {
+		uint64_t lost = rec->seq - ctl->kmsg_seq;
+
+		printf("%*s", ctl->indent, "");
+		if (ctl->color)
+			dmesg_enable_color(DMESG_COLOR_WARN);
+		printf(P_("-- %ju message lost --",
+			  "-- %ju messages lost --", lost), (uintmax_t) lost);
+		if (ctl->color)
+			color_disable();
+		putchar('\n');
+	}
+	ctl->kmsg_seq = rec->seq + 1;
+	ctl->kmsg_seq_valid = 1;
+}
+
+/*
+ * Waits for new records in --follow mode. Returns 0 on success, -1 on error.
+ */
+static int wait_kmsg(struct dmesg_control *ctl)
+{
+	struct pollfd fds[] = {
+		{ .fd = ctl->kmsg, .events = POLLIN }
+	};
+
+	while (poll(fds, 1, -1) < 0) {
+		if (errno != EINTR)
+			return -1;
+	}
+	return 0;
+}
+
 /*
  * Note that each read() call for /dev/kmsg returns always one record. It means
  * that we don't have to read whole message buffer before the records parsing.
@@ -1165,15 +1622,29 @@ static int read_kmsg(struct dmesg_control *ctl)
 	 */
 	sz = ctl->kmsg_first_read;
 
-	while (sz > 0) {
-		*(ctl->kmsg_buf + sz) = '\0';	/* for debug messages */
-
-		if (parse_kmsg_record(ctl, &rec,
-				      ctl->kmsg_buf, (size_t) sz) == 0)
-			print_record(ctl, &rec);
+	do {
+		while (sz > 0) {
+			*(ctl->kmsg_buf + sz) = '\0';	/* for debug messages */
+
+			if (parse_kmsg_record(ctl, &rec,
+					      ctl->kmsg_buf, (size_t) sz) == 0) {
+				check_kmsg_seq(ctl, &rec);
+				if (accept_record_time(ctl, &rec))
+					print_record(ctl, &rec);
+			} else if (ctl->kmsg_seq_valid)
+				/* unparsable, but not lost */
+				ctl->kmsg_seq++;
+			sz = read_kmsg_one(ctl);
+		}
+		if (!ctl->follow || (sz < 0 && errno != EAGAIN))
+			break;
 
+		/* all available records read, wait for more */
+		flush_output();
+		if (wait_kmsg(ctl) != 0)
+			break;
 		sz = read_kmsg_one(ctl);
-	}
+	} while (1);
 
 	return 0;
 }
@@ -1227,10 +1698,15 @@ int main(int argc, char *argv[])
 		.time_fmt = DMESG_TIMEFTM_TIME,
 		.indent = 0,
 	};
-	int colormode = UL_COLORMODE_UNDEF;
+	int colormode = UL_COLORMODE_UNDEF, boot_time_set = 0;
 	enum {
 		OPT_TIME_FORMAT = CHAR_MAX + 1,
+		OPT_INDEX,
+		OPT_BOOT_TIME,
+		OPT_SINCE,
+		OPT_UNTIL
 	};
+	usec_t usec;
 
 	static const struct option longopts[] = {
 		{ "buffer-size",   required_argument, NULL, 's' },
@@ -1258,6 +1734,10 @@ int main(int argc, char *argv[])
 		{ "userspace",     no_argument,       NULL, 'u' },
 		{ "version",       no_argument,	      NULL, 'V' },
 		{ "time-format",   required_argument, NULL, OPT_TIME_FORMAT },
+		{ "index",         required_argument, NULL, OPT_INDEX },
+		{ "boot-time",     required_argument, NULL, OPT_BOOT_TIME },
+		{ "since",         required_argument, NULL, OPT_SINCE },
+		{ "until",         required_argument, NULL, OPT_UNTIL },
 		{ NULL,	           0, NULL, 0 }
 	};
 
@@ -1381,6 +1861,26 @@ int main(int argc, char *argv[])
 		case OPT_TIME_FORMAT:
 			ctl.time_fmt = which_time_format(optarg);
 			break;
+		case OPT_INDEX:
+			ctl.indexname = optarg;
+			break;
+		case OPT_BOOT_TIME:
+			if (parse_timestamp(optarg, &usec) < 0)
+				errx(EXIT_FAILURE, _("invalid time value \"%s\""), optarg);
+			ctl.boot_time.tv_sec = usec / USEC_PER_SEC;
+			ctl.boot_time.tv_usec = usec % USEC_PER_SEC;
+			boot_time_set = 1;
+			break;
+		case OPT_SINCE:
+			if (parse_timestamp(optarg, &usec) < 0)
+				errx(EXIT_FAILURE, _("invalid time value \"%s\""), optarg);
+			ctl.since = usec;
+			break;
+		case OPT_UNTIL:
+			if (parse_timestamp(optarg, &usec) < 0)
+				errx(EXIT_FAILURE, _("invalid time value \"%s\""), optarg);
+			ctl.until = usec;
+			break;
 		case '?':
 		default:
 			usage(stderr);
@@ -1392,7 +1892,26 @@ int main(int argc, char *argv[])
 	if (argc > 1)
 		usage(stderr);
 
-	if (is_timefmt(&ctl, RELTIME) ||
+	if (ctl.indexname && ctl.method != DMESG_METHOD_MMAP)
+		errx(EXIT_FAILURE, _("--index can be used only together with --file"));
+	if (boot_time_set && ctl.method != DMESG_METHOD_MMAP)
+		errx(EXIT_FAILURE, _("--boot-time can be used only together with --file"));
+
+	/*
+	 * The timestamps in the --file are relative to the boot of the system
+	 * which wrote the file, the current boot time is not usable for them.
+	 */
+	if (ctl.method == DMESG_METHOD_MMAP && (ctl.since || ctl.until)
+	    && !boot_time_set)
+		errx(EXIT_FAILURE, _("--since and --until require --boot-time "
+				     "when used together with --file"));
+
+	if (boot_time_set)
+		;	/* used also by --ctime, --reltime and iso time format */
+	else if (ctl.since || ctl.until) {
+		if (dmesg_get_boot_time(&ctl.boot_time) != 0)
+			errx(EXIT_FAILURE, _("cannot get system boot time"));
+	} else if (is_timefmt(&ctl, RELTIME) ||
 	    is_timefmt(&ctl, CTIME) ||
 	    is_timefmt(&ctl, ISO8601)) {
 		if (dmesg_get_boot_time(&ctl.boot_time) != 0)
@@ -1433,6 +1952,11 @@ int main(int argc, char *argv[])
 		    && (ctl.fltr_lev || ctl.fltr_fac))
 			    errx(EXIT_FAILURE, _("--raw can be used together with --level or "
 				 "--facility only when reading messages from /dev/kmsg"));
+		if (ctl.raw
+		    && ctl.method != DMESG_METHOD_KMSG
+		    && (ctl.since || ctl.until))
+			    errx(EXIT_FAILURE, _("--raw can be used together with --since or "
+				 "--until only when reading messages from /dev/kmsg"));
 		if (ctl.pager)
 			setup_pager();
 		n = read_buffer(&ctl, &buf);
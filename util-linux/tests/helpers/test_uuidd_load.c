@@ -0,0 +1,247 @@
+/*
+ * Load generator for uuidd(8).
+ *
+ * Starts <clients> threads, every thread sends <requests> requests to the
+ * daemon and measures the time between sending the request and reading
+ * the whole reply. With -d the requests are pipelined, with -1 every
+ * request uses a new connection (the way libuuid talks to uuidd).
+ *
+ * For example:
+ *
+ *	uuidd --no-fork --no-pid --socket /tmp/uuidd.sock &
+ *	test_uuidd_load -s /tmp/uuidd.sock -c 256 -n 2000 -d 8
+ *
+ * This file may be redistributed under the terms of the GNU Public
+ * License.
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "uuid.h"
+#include "uuidd.h"
+#include "c.h"
+#include "xalloc.h"
+#include "all-io.h"
+#include "strutils.h"
+
+static const char *socket_path = UUIDD_SOCKET_PATH;
+static size_t nclients = 16;
+static size_t nrequests = 10000;
+static size_t depth = 1;
+static int bulk;
+static int op = UUIDD_OP_TIME_UUID;
+static int reconnect;
+
+struct client {
+	pthread_t	tid;
+	uint64_t	*lat;		/* latencies in nanoseconds */
+	size_t		ndone;
+	size_t		nuuids;
+};
+
+static void __attribute__((__noreturn__)) usage(FILE *out)
+{
+	fprintf(out, "\n %s [options]\n", program_invocation_short_name);
+
+	fprintf(out, "  -s <path>    uuidd socket (default:%s)\n", socket_path);
+	fprintf(out, "  -c <num>     number of clients (default:%zu)\n", nclients);
+	fprintf(out, "  -n <num>     number of requests per client (default:%zu)\n", nrequests);
+	fprintf(out, "  -d <num>     number of pipelined requests (default:%zu)\n", depth);
+	fprintf(out, "  -b <num>     request <num> UUIDs by bulk requests\n");
+	fprintf(out, "  -r           request random-based UUIDs\n");
+	fprintf(out, "  -1           use new connection for every request\n");
+	fprintf(out, "  -h           display help\n");
+
+	exit(out == stderr ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int connect_uuidd(void)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	int fd;
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		err(EXIT_FAILURE, "socket");
+
+	xstrncpy(addr.sun_path, socket_path, sizeof(addr.sun_path));
+	if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0)
+		err(EXIT_FAILURE, "connect %s", socket_path);
+	return fd;
+}
+
+/* returns number of UUIDs in the reply */
+static size_t read_reply(int fd)
+{
+	int32_t len;
+	char buf[64 * 1024];
+	size_t n, total;
+
+	if (read_all(fd, (char *) &len, sizeof(len)) != sizeof(len) || len < 0)
+		errx(EXIT_FAILURE, "cannot read reply length");
+
+	for (total = len; total > 0; total -= n) {
+		n = min(total, sizeof(buf));
+		if (read_all(fd, buf, n) != (ssize_t) n)
+			errx(EXIT_FAILURE, "cannot read reply");
+	}
+
+	switch (op) {
+	case UUIDD_OP_BULK_TIME_UUID:
+		memcpy(&len, buf + sizeof(uuid_t), sizeof(len));
+		return len;
+	case UUIDD_OP_BULK_RANDOM_UUID:
+		return (len - sizeof(int)) / sizeof(uuid_t);
+	}
+	return 1;
+}
+
+static void *client_body(void *data)
+{
+	struct client *cl = (struct client *) data;
+	char req[1 + sizeof(int)];
+	size_t reqsz = 1, nsent = 0;
+	uint64_t *sent;
+	int fd = -1;
+
+	req[0] = op;
+	if (bulk) {
+		memcpy(req + 1, &bulk, sizeof(bulk));
+		reqsz += sizeof(bulk);
+	}
+	sent = xcalloc(nrequests, sizeof(uint64_t));
+
+	if (!reconnect)
+		fd = connect_uuidd();
+
+	while (cl->ndone < nrequests) {
+		if (reconnect) {
+			sent[nsent] = now_ns();
+			fd = connect_uuidd();
+			if (write_all(fd, req, reqsz))
+				err(EXIT_FAILURE, "write");
+			nsent++;
+		}
+
+		/* keep <depth> requests in flight */
+		while (!reconnect && nsent < nrequests && nsent - cl->ndone < depth) {
+			sent[nsent] = now_ns();
+			if (write_all(fd, req, reqsz))
+				err(EXIT_FAILURE, "write");
+			nsent++;
+		}
+
+		cl->nuuids += read_reply(fd);
+		cl->lat[cl->ndone] = now_ns() - sent[cl->ndone];
+		cl->ndone++;
+
+		if (reconnect)
+			close(fd);
+	}
+
+	if (!reconnect)
+		close(fd);
+	free(sent);
+	return NULL;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+int main(int argc, char *argv[])
+{
+	struct client *clients;
+	uint64_t *lat, start, elapsed;
+	size_t i, total = 0, nuuids = 0;
+	int c, rc;
+
+	while ((c = getopt(argc, argv, "s:c:n:d:b:r1h")) != -1) {
+		switch (c) {
+		case 's':
+			socket_path = optarg;
+			break;
+		case 'c':
+			nclients = strtou32_or_err(optarg, "invalid number of clients");
+			break;
+		case 'n':
+			nrequests = strtou32_or_err(optarg, "invalid number of requests");
+			break;
+		case 'd':
+			depth = strtou32_or_err(optarg, "invalid pipeline depth");
+			break;
+		case 'b':
+			bulk = strtou32_or_err(optarg, "invalid bulk size");
+			break;
+		case 'r':
+			op = UUIDD_OP_RANDOM_UUID;
+			break;
+		case '1':
+			reconnect = 1;
+			break;
+		case 'h':
+			usage(stdout);
+			break;
+		default:
+			usage(stderr);
+			break;
+		}
+	}
+	if (optind != argc || !nclients || !nrequests || !depth)
+		usage(stderr);
+	if (bulk)
+		op += 2;	/* UUIDD_OP_BULK_{TIME,RANDOM}_UUID */
+
+	clients = xcalloc(nclients, sizeof(struct client));
+	for (i = 0; i < nclients; i++)
+		clients[i].lat = xcalloc(nrequests, sizeof(uint64_t));
+
+	start = now_ns();
+	for (i = 0; i < nclients; i++) {
+		rc = pthread_create(&clients[i].tid, NULL, client_body, &clients[i]);
+		if (rc)
+			errx(EXIT_FAILURE, "pthread_create failed: %s", strerror(rc));
+	}
+	for (i = 0; i < nclients; i++)
+		pthread_join(clients[i].tid, NULL);
+	elapsed = now_ns() - start;
+
+	lat = xcalloc(nclients * nrequests, sizeof(uint64_t));
+	for (i = 0; i < nclients; i++) {
+		memcpy(lat + total, clients[i].lat, clients[i].ndone * sizeof(uint64_t));
+		total += clients[i].ndone;
+		nuuids += clients[i].nuuids;
+		free(clients[i].lat);
+	}
+	qsort(lat, total, sizeof(uint64_t), cmp_u64);
+
+	printf("clients:     %zu\n", nclients);
+	printf("requests:    %zu\n", total);
+	printf("time:        %.3f s\n", elapsed / 1E9);
+	printf("throughput:  %.0f requests/s, %.0f UUIDs/s\n",
+			total / (elapsed / 1E9), nuuids / (elapsed / 1E9));
+	printf("latency p50: %.1f us\n", lat[total / 2] / 1E3);
+	printf("latency p99: %.1f us\n", lat[total * 99 / 100] / 1E3);
+	printf("latency max: %.1f us\n", lat[total - 1] / 1E3);
+
+	free(lat);
+	free(clients);
+	return EXIT_SUCCESS;
+}
@@ -40,6 +40,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
 #include "hexdump.h"
 #include "xalloc.h"
 #include "c.h"
@@ -48,11 +51,284 @@
 
 static void doskip(const char *, int, struct hexdump *);
 static u_char *get(struct hexdump *);
+static ssize_t read_input(struct hexdump *, u_char *, ssize_t);
 
 enum _vflag vflag = FIRST;
 
 static off_t address;			/* address/offset in stream */
 static off_t eaddress;			/* end address */
+static u_char *curp, *savp;		/* current and previous block */
+static char **_argv;
+
+/*
+ * Compiled print units.
+ *
+ * The usual formats (-b, -C, -d, -o, -x and the default one) consist of
+ * text, addresses, %_p and fixed-width unsigned conversions only. These
+ * units are converted by lookup tables into a private output buffer
+ * instead of calling printf() for every unit. All other units fall back
+ * to print(), which flushes the buffer first.
+ */
+enum {
+	C_NONE = 0,		/* use print() */
+	C_TEXT,
+	C_P,
+	C_OCT,
+	C_DEC,
+	C_HEX,
+	C_HEXUP
+};
+
+#define C_MAXTEXT	1024	/* longer text is printed by print() */
+#define C_MAXWIDTH	256	/* max width or precision of compiled units */
+
+static char outbuf[BUFSIZ * 8];
+static size_t outpos;
+static int outtty;		/* flush after every block */
+
+static char ptab[256];		/* %_p characters */
+static char oct2[64][2];	/* two octal digits */
+static char dec2[100][2];	/* two decimal digits */
+static char hex2[256][2];	/* two hex digits */
+static char hexup2[256][2];	/* two upper-case hex digits */
+
+static void out_flush(void)
+{
+	if (outpos)
+		fwrite(outbuf, 1, outpos, stdout);
+	outpos = 0;
+}
+
+static inline char *out_reserve(size_t n)
+{
+	if (outpos + n > sizeof(outbuf))
+		out_flush();
+	return outbuf + outpos;
+}
+
+static inline void out_text(const char *str, size_t len)
+{
+	char *o = out_reserve(len);
+
+	outpos += len;
+	while (len--)
+		*o++ = *str++;
+}
+
+static void init_tables(void)
+{
+	static const char digits[] = "0123456789abcdef";
+	static const char updigits[] = "0123456789ABCDEF";
+	int i;
+
+	for (i = 0; i < 256; i++) {
+		ptab[i] = isprint(i) ? i : '.';
+		hex2[i][0] = digits[i >> 4];
+		hex2[i][1] = digits[i & 0xf];
+		hexup2[i][0] = updigits[i >> 4];
+		hexup2[i][1] = updigits[i & 0xf];
+	}
+	for (i = 0; i < 100; i++) {
+		dec2[i][0] = '0' + i / 10;
+		dec2[i][1] = '0' + i % 10;
+	}
+	for (i = 0; i < 64; i++) {
+		oct2[i][0] = '0' + (i >> 3);
+		oct2[i][1] = '0' + (i & 7);
+	}
+}
+
+/*
+ * Decides whether the print unit could be compiled. The format string is
+ * "<text>%[0][width][.prec]<conversion>" as created by rewrite_rules().
+ */
+static void compile_pr(struct hexdump_pr *pr)
+{
+	char *p;
+	int dot = 0;
+
+	pr->cconv = C_NONE;
+	if (pr->colorlist)
+		return;
+	if (pr->flags == F_TEXT) {
+		pr->textlen = strlen(pr->fmt);
+		if (pr->textlen <= C_MAXTEXT)
+			pr->cconv = C_TEXT;
+		return;
+	}
+	if (!(pr->flags & (F_ADDRESS | F_P | F_UINT)) || pr->nospace)
+		return;
+
+	p = strchr(pr->fmt, '%');
+	pr->textlen = p - pr->fmt;
+	pr->pad = ' ';
+	pr->prec = 1;
+	if (*++p == '0') {
+		pr->pad = '0';
+		p++;
+	}
+	for (pr->width = 0; isdigit(*p) && pr->width <= C_MAXWIDTH; p++)
+		pr->width = pr->width * 10 + *p - '0';
+	if (*p == '.') {
+		dot = 1;
+		pr->pad = ' ';		/* '0' flag is ignored with precision */
+		for (pr->prec = 0, p++; isdigit(*p) && pr->prec <= C_MAXWIDTH; p++)
+			pr->prec = pr->prec * 10 + *p - '0';
+	}
+	if (p != pr->cchar || pr->textlen > C_MAXTEXT
+	    || pr->width > C_MAXWIDTH || pr->prec > C_MAXWIDTH)
+		return;
+
+	if (pr->flags == F_P) {
+		if (*p == 'c' && !dot && pr->pad == ' ')
+			pr->cconv = C_P;
+		return;
+	}
+	if (pr->prec == 0)
+		return;
+
+	/* F_ADDRESS and F_UINT, the conversion is "ll[doux]" */
+	switch (p[2]) {
+	case 'o':
+		pr->cconv = C_OCT;
+		break;
+	case 'd':
+	case 'u':
+		pr->cconv = C_DEC;
+		break;
+	case 'x':
+		pr->cconv = C_HEX;
+		break;
+	case 'X':
+		pr->cconv = C_HEXUP;
+		break;
+	}
+}
+
+/* upper limit of the print_compiled() output */
+static inline size_t compiled_size(struct hexdump_pr *pr)
+{
+	switch (pr->cconv) {
+	case C_TEXT:
+		return pr->textlen;
+	case C_P:
+		return pr->textlen + max(pr->width, 1);
+	}
+	return pr->textlen + max(max(pr->width, pr->prec), 22);
+}
+
+static inline char *
+print_number(struct hexdump_pr *pr, unsigned long long val, char *o)
+{
+	char digits[24], *end = digits + sizeof(digits), *p = end;
+	const char (*tab)[2];
+	int ndig, nzero, nspace;
+
+	switch (pr->cconv) {
+	case C_OCT:
+		do {
+			p -= 2;
+			memcpy(p, oct2[val & 077], 2);
+			val >>= 6;
+		} while (val);
+		break;
+	case C_DEC:
+		while (val >= 100) {
+			p -= 2;
+			memcpy(p, dec2[val % 100], 2);
+			val /= 100;
+		}
+		p -= 2;
+		memcpy(p, dec2[val], 2);
+		break;
+	default:
+		tab = pr->cconv == C_HEX ? hex2 : hexup2;
+		do {
+			p -= 2;
+			memcpy(p, tab[val & 0xff], 2);
+			val >>= 8;
+		} while (val);
+		break;
+	}
+	/* the digits are generated in pairs, only the first one may be '0' */
+	if (*p == '0' && p + 1 < end)
+		p++;
+
+	ndig = end - p;
+	nzero = pr->prec > ndig ? pr->prec - ndig : 0;
+	nspace = pr->width > ndig + nzero ? pr->width - ndig - nzero : 0;
+	if (pr->pad == '0') {
+		nzero += nspace;
+		nspace = 0;
+	}
+
+	/* the fields are short, plain loops are faster than mem*() calls */
+	if (pr->textlen) {
+		memcpy(o, pr->fmt, pr->textlen);
+		o += pr->textlen;
+	}
+	while (nspace--)
+		*o++ = ' ';
+	while (nzero--)
+		*o++ = '0';
+	while (p < end)
+		*o++ = *p++;
+	return o;
+}
+
+/*
+ * Writes the print unit to @o, there has to be at least compiled_size()
+ * bytes. Returns the end of the output.
+ */
+static inline char *
+print_compiled(struct hexdump_pr *pr, unsigned char *bp, int nospace,
+	       off_t addr, char *o)
+{
+	unsigned short sval;
+	unsigned int ival;
+	unsigned long long Lval;
+	const char *p, *end;
+	int n;
+
+	switch (pr->cconv) {
+	case C_TEXT:
+		end = nospace ? pr->nospace : pr->fmt + pr->textlen;
+		for (p = pr->fmt; p < end; p++)
+			*o++ = *p;
+		return o;
+	case C_P:
+		if (pr->textlen) {
+			memcpy(o, pr->fmt, pr->textlen);
+			o += pr->textlen;
+		}
+		for (n = 1; n < pr->width; n++)
+			*o++ = ' ';
+		*o++ = ptab[*bp];
+		return o;
+	}
+
+	if (pr->flags == F_ADDRESS)
+		return print_number(pr, addr, o);
+
+	switch (pr->bcnt) {
+	case 1:
+		o = print_number(pr, *bp, o);
+		break;
+	case 2:
+		memcpy(&sval, bp, sizeof(sval));
+		o = print_number(pr, sval, o);
+		break;
+	case 4:
+		memcpy(&ival, bp, sizeof(ival));
+		o = print_number(pr, ival, o);
+		break;
+	case 8:
+		memcpy(&Lval, bp, sizeof(Lval));
+		o = print_number(pr, Lval, o);
+		break;
+	}
+	return o;
+}
 
 static const char *color_cond(struct hexdump_pr *pr, unsigned char *bp, int bcnt)
 {
@@ -112,6 +388,8 @@ print(struct hexdump_pr *pr, unsigned char *bp) {
 
 	const char *color = NULL;
 
+	out_flush();
+
 	if (pr->colorlist && (color = color_cond(pr, bp, pr->bcnt)))
 		color_enable(color);
 
@@ -221,6 +499,7 @@ static void bpad(struct hexdump_pr *pr)
 	 * with %s, and it's not useful here.
 	 */
 	pr->flags = F_BPAD;
+	pr->cconv = C_NONE;
 	pr->cchar[0] = 's';
 	pr->cchar[1] = 0;
 
@@ -236,6 +515,237 @@ static void bpad(struct hexdump_pr *pr)
 		;
 }
 
+/*
+ * Chunked display of regular files.
+ *
+ * If all print units are compiled, the output of a block depends only on
+ * the block, its address and the previous two blocks (duplicate lines
+ * squeezing). The input is read in large chunks, the full blocks are
+ * rendered by more threads to private buffers and the buffers are written
+ * in order. The last partial block is returned to display(), it needs
+ * bpad() and so print().
+ */
+#define CHUNK_SIZE	(64 * 1024)	/* input bytes rendered by one thread */
+#define CHUNK_NTHREADS	8		/* max number of threads */
+
+struct hexdump_chunk {
+	struct hexdump	*hex;
+	unsigned char	*data;		/* the first block */
+	size_t		nblocks;	/* number of blocks */
+	size_t		nprev;		/* valid blocks before data, max 2 */
+	off_t		address;	/* address of the first block */
+	char		*out;		/* rendered output */
+	size_t		outlen;
+};
+
+/* regular files only, don't wait for a chunk of data from pipes or ttys */
+static int input_is_regular(void)
+{
+	struct stat st;
+	char **argv = _argv;
+
+	if (!*argv)
+		return fstat(STDIN_FILENO, &st) == 0 && S_ISREG(st.st_mode);
+	for (; *argv; argv++) {
+		if (stat(*argv, &st) != 0 || !S_ISREG(st.st_mode))
+			return 0;
+	}
+	return 1;
+}
+
+/* returns max size of the output for one block, or 0 if print() is required */
+static size_t block_out_size(struct hexdump *hex)
+{
+	struct list_head *p, *q, *r;
+	struct hexdump_fs *fss;
+	struct hexdump_fu *fu;
+	struct hexdump_pr *pr;
+	size_t sz = 0;
+
+	list_for_each(p, &hex->fshead) {
+		fss = list_entry(p, struct hexdump_fs, fslist);
+		list_for_each(q, &fss->fulist) {
+			fu = list_entry(q, struct hexdump_fu, fulist);
+			if (fu->flags & F_IGNORE)
+				break;
+			list_for_each(r, &fu->prlist) {
+				pr = list_entry(r, struct hexdump_pr, prlist);
+				if (!pr->cconv)
+					return 0;
+				sz += fu->reps * compiled_size(pr);
+			}
+		}
+	}
+	return sz;
+}
+
+static char *render_block(struct hexdump *hex, unsigned char *bp,
+			  off_t addr, char *o)
+{
+	struct list_head *p, *q, *r;
+	struct hexdump_fs *fss;
+	struct hexdump_fu *fu;
+	struct hexdump_pr *pr;
+
+	list_for_each(p, &hex->fshead) {
+		unsigned char *b = bp;
+		off_t a = addr;
+		int cnt;
+
+		fss = list_entry(p, struct hexdump_fs, fslist);
+		list_for_each(q, &fss->fulist) {
+			fu = list_entry(q, struct hexdump_fu, fulist);
+			if (fu->flags & F_IGNORE)
+				break;
+			for (cnt = fu->reps; cnt; cnt--) {
+				list_for_each(r, &fu->prlist) {
+					pr = list_entry(r, struct hexdump_pr, prlist);
+					o = print_compiled(pr, b, cnt == 1 && pr->nospace, a, o);
+					a += pr->bcnt;
+					b += pr->bcnt;
+				}
+			}
+		}
+	}
+	return o;
+}
+
+static void *render_chunk(void *data)
+{
+	struct hexdump_chunk *ch = (struct hexdump_chunk *) data;
+	size_t bs = ch->hex->blocksize, i;
+	unsigned char *bp = ch->data;
+	off_t addr = ch->address;
+	char *o = ch->out;
+	int dup, prevdup = 0;
+
+	if (vflag != ALL && ch->nprev > 1)
+		prevdup = !memcmp(bp - bs, bp - 2 * bs, bs);
+
+	for (i = 0; i < ch->nblocks; i++, bp += bs, addr += bs) {
+		dup = vflag != ALL && (i || ch->nprev) && !memcmp(bp, bp - bs, bs);
+		if (!dup)
+			o = render_block(ch->hex, bp, addr, o);
+		else if (!prevdup) {
+			*o++ = '*';
+			*o++ = '\n';
+		}
+		prevdup = dup;
+	}
+	ch->outlen = o - ch->out;
+	return NULL;
+}
+
+/*
+ * Displays all full blocks. Returns the last partial block (in curp) or
+ * NULL. The get() state is updated as if it has read all the blocks.
+ */
+static unsigned char *display_chunks(struct hexdump *hex, size_t blockmax)
+{
+	struct hexdump_chunk *chunks;
+	size_t bs = hex->blocksize, per, nblocks = 0, nprev = 0, nchunks, i;
+	unsigned int nthreads = 1;
+	unsigned char *buf, *data, *ret = NULL;
+	ssize_t want, n, tail = 0;
+	off_t base = 0;
+#ifdef HAVE_LIBPTHREAD
+	pthread_t threads[CHUNK_NTHREADS];
+	long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t nrunning;
+
+	if (ncpus > 1)
+		nthreads = min(ncpus, (long) CHUNK_NTHREADS);
+#endif
+	per = max(CHUNK_SIZE / bs, (size_t) 1);
+	want = nthreads * per * bs;
+
+	/* two blocks of history before the data */
+	buf = xmalloc(2 * bs + want);
+	data = buf + 2 * bs;
+
+	chunks = xcalloc(nthreads, sizeof(struct hexdump_chunk));
+	for (i = 0; i < nthreads; i++) {
+		chunks[i].hex = hex;
+		chunks[i].out = xmalloc(per * (blockmax + 2));
+	}
+
+	while ((n = read_input(hex, data, want)) > 0) {
+		if (!nprev)
+			base = address;		/* after --skip */
+
+		nblocks = n / bs;
+		tail = n - nblocks * bs;
+		nchunks = (nblocks + per - 1) / per;
+
+		for (i = 0; i < nchunks; i++) {
+			struct hexdump_chunk *ch = &chunks[i];
+
+			ch->data = data + i * per * bs;
+			ch->nblocks = min(per, nblocks - i * per);
+			ch->nprev = min(nprev + i * per, (size_t) 2);
+			ch->address = base + i * per * bs;
+		}
+#ifdef HAVE_LIBPTHREAD
+		/* the current thread renders the first chunk */
+		for (nrunning = 1; nrunning < nchunks; nrunning++) {
+			if (pthread_create(&threads[nrunning], NULL,
+					   render_chunk, &chunks[nrunning]))
+				break;
+		}
+		render_chunk(&chunks[0]);
+		for (i = nrunning; i < nchunks; i++)
+			render_chunk(&chunks[i]);
+		for (i = 1; i < nrunning; i++)
+			pthread_join(threads[i], NULL);
+#else
+		for (i = 0; i < nchunks; i++)
+			render_chunk(&chunks[i]);
+#endif
+		out_flush();
+		for (i = 0; i < nchunks; i++)
+			fwrite(chunks[i].out, 1, chunks[i].outlen, stdout);
+
+		if (nblocks) {
+			unsigned char *lastbp = data + (nblocks - 1) * bs;
+
+			/* the same state as get() would have */
+			if (vflag != ALL) {
+				if (nprev + nblocks > 1 && !memcmp(lastbp, lastbp - bs, bs))
+					vflag = DUP;
+				else
+					vflag = WAIT;
+			}
+			memmove(buf, lastbp - bs, 2 * bs);
+			nprev = min(nprev + nblocks, (size_t) 2);
+			base += nblocks * bs;
+		}
+		if (n < want)
+			break;
+	}
+
+	if (nprev || tail) {
+		curp = xcalloc(1, bs);
+		savp = xcalloc(1, bs);
+		if (tail) {
+			/* the last partial block, see get() */
+			memcpy(curp, data + nblocks * bs, tail);
+			address = base;
+			eaddress = base + tail;
+			ret = curp;
+		} else {
+			/* the last full block, get() continues after it */
+			memcpy(curp, buf + bs, bs);
+			address = base - bs;
+		}
+	}
+
+	for (i = 0; i < nthreads; i++)
+		free(chunks[i].out);
+	free(chunks);
+	free(buf);
+	return ret;
+}
+
 void display(struct hexdump *hex)
 {
 	register struct list_head *fs;
@@ -243,12 +753,31 @@ void display(struct hexdump *hex)
 	register struct hexdump_fu *fu;
 	register struct hexdump_pr *pr;
 	register int cnt;
-	register unsigned char *bp;
+	register unsigned char *bp = NULL;
 	off_t saveaddress;
 	unsigned char savech = 0, *savebp;
 	struct list_head *p, *q, *r;
+	size_t blockmax;
+
+	init_tables();
+	outtty = isatty(STDOUT_FILENO);
+
+	list_for_each(p, &hex->fshead) {
+		fss = list_entry(p, struct hexdump_fs, fslist);
+		list_for_each(q, &fss->fulist) {
+			fu = list_entry(q, struct hexdump_fu, fulist);
+			list_for_each(r, &fu->prlist)
+				compile_pr(list_entry(r, struct hexdump_pr, prlist));
+		}
+	}
+
+	if (!outtty && hex->blocksize > 0 && input_is_regular()
+	    && (blockmax = block_out_size(hex)))
+		bp = display_chunks(hex, blockmax);
+	if (!bp)
+		bp = get(hex);
 
-	while ((bp = get(hex)) != NULL) {
+	for (; bp; bp = get(hex)) {
 		fs = &hex->fshead; savebp = bp; saveaddress = address;
 
 		list_for_each(p, fs) {
@@ -270,7 +799,13 @@ void display(struct hexdump *hex)
 						    && !(pr->flags&(F_TEXT|F_BPAD)))
 							bpad(pr);
 
-						if (cnt == 1 && pr->nospace) {
+						if (pr->cconv) {
+							char *o = out_reserve(compiled_size(pr));
+
+							o = print_compiled(pr, bp, cnt == 1 && pr->nospace,
+									   address, o);
+							outpos = o - outbuf;
+						} else if (cnt == 1 && pr->nospace) {
 							savech = *pr->nospace;
 							*pr->nospace = '\0';
 							print(pr, bp);
@@ -287,7 +822,11 @@ void display(struct hexdump *hex)
 			bp = savebp;
 			address = saveaddress;
 		}
+		if (outtty)
+			out_flush();
 	}
+	out_flush();
+
 	if (endfu) {
 		/*
 		 * if eaddress not set, error or file size was multiple of
@@ -321,14 +860,43 @@ void display(struct hexdump *hex)
 	}
 }
 
-static char **_argv;
+/*
+ * Reads up to @need bytes from the input files. Returns less than @need
+ * only at the end of the input, or -1 if all the files failed.
+ */
+static ssize_t read_input(struct hexdump *hex, u_char *buf, ssize_t need)
+{
+	static int ateof = 1;
+	ssize_t n, nread = 0;
+
+	while (nread < need) {
+		if (!hex->length || (ateof && !next(NULL, hex)))
+			break;
+		if (fileno(stdin) == -1) {
+			warnx(_("all input file arguments failed"));
+			return -1;
+		}
+		n = fread((char *)buf + nread, sizeof(unsigned char),
+		    hex->length == -1 ? need - nread : min(hex->length, need - nread),
+		    stdin);
+		if (!n) {
+			if (ferror(stdin))
+				warn("%s", _argv[-1]);
+			ateof = 1;
+			continue;
+		}
+		ateof = 0;
+		if (hex->length != -1)
+			hex->length -= n;
+		nread += n;
+	}
+	return nread;
+}
 
 static u_char *
 get(struct hexdump *hex)
 {
-	static int ateof = 1;
-	static u_char *curp, *savp;
-	ssize_t n, need, nread;
+	ssize_t nread;
 	u_char *tmpp;
 
 	if (!curp) {
@@ -340,62 +908,34 @@ get(struct hexdump *hex)
 		savp = tmpp;
 		address += hex->blocksize;
 	}
-	need = hex->blocksize, nread = 0;
 	while (TRUE) {
+		nread = read_input(hex, curp, hex->blocksize);
+		if (nread <= 0)
+			goto retnul;
 		/*
-		 * if read the right number of bytes, or at EOF for one file,
-		 * and no other files are available, zero-pad the rest of the
-		 * block and set the end flag.
+		 * at the end of the input zero-pad the rest of the block
+		 * and set the end flag.
 		 */
-		if (!hex->length || (ateof && !next(NULL, hex))) {
-			if (need == hex->blocksize)
-				goto retnul;
-			if (!need && vflag != ALL &&
-			    !memcmp(curp, savp, nread)) {
-				if (vflag != DUP)
-					printf("*\n");
-				goto retnul;
-			}
-			if (need > 0)
-				memset((char *)curp + nread, 0, need);
+		if (nread < hex->blocksize) {
+			memset((char *)curp + nread, 0, hex->blocksize - nread);
 			eaddress = address + nread;
 			return(curp);
 		}
-		if (fileno(stdin) == -1) {
-			warnx(_("all input file arguments failed"));
-			goto retnul;
-		}
-		n = fread((char *)curp + nread, sizeof(unsigned char),
-		    hex->length == -1 ? need : min(hex->length, need), stdin);
-		if (!n) {
-			if (ferror(stdin))
-				warn("%s", _argv[-1]);
-			ateof = 1;
-			continue;
-		}
-		ateof = 0;
-		if (hex->length != -1)
-			hex->length -= n;
-		if (!(need -= n)) {
-			if (vflag == ALL || vflag == FIRST ||
-			    memcmp(curp, savp, hex->blocksize)) {
-				if (vflag == DUP || vflag == FIRST)
-					vflag = WAIT;
-				return(curp);
-			}
-			if (vflag == WAIT)
-				printf("*\n");
-			vflag = DUP;
-			address += hex->blocksize;
-			need = hex->blocksize;
-			nread = 0;
+		if (vflag == ALL || vflag == FIRST ||
+		    memcmp(curp, savp, hex->blocksize)) {
+			if (vflag == DUP || vflag == FIRST)
+				vflag = WAIT;
+			return(curp);
 		}
-		else
-			nread += n;
+		if (vflag == WAIT)
+			out_text("*\n", 2);
+		vflag = DUP;
+		address += hex->blocksize;
 	}
 retnul:
 	free (curp);
 	free (savp);
+	curp = savp = NULL;
 	return NULL;
 }
 
@@ -408,6 +948,7 @@ int next(char **argv, struct hexdump *hex)
 		_argv = argv;
 		return(1);
 	}
+	out_flush();		/* before any warning or error */
 	while (TRUE) {
 		if (*_argv) {
 			if (!(freopen(*_argv, "r", stdin))) {
@@ -64,6 +64,11 @@ struct hexdump_pr {
 	struct list_head *colorlist;	/* color settings */
 	char *fmt;			/* printf format */
 	char *nospace;			/* no whitespace version */
+	int cconv;			/* compiled conversion, 0 for printf */
+	int textlen;			/* text length before the conversion */
+	int width;			/* field width */
+	int prec;			/* minimal number of digits */
+	char pad;			/* ' ' or '0' */
 };
 
 struct hexdump_fu {